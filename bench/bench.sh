@@ -0,0 +1,101 @@
+#!/bin/sh
+# runs flexc over generated corpora of increasing size and writes throughput and peak RSS per phase to
+# <out dir>/results.json, one result object per line. with a baseline given, fails if any phase got slower or
+# bigger than the baseline by more than BENCH_TOLERANCE.
+# BENCH_PERF=1 adds the hardware counters of each phase to its result, where perf_event_open is allowed.
+# BENCH_LAZY=1 runs flexc with --lazy-bodies.
+# usage: bench.sh <flexc> <flexgen> <out dir> [baseline.json]
+
+FLEXC=$1
+FLEXGEN=$2
+OUT=$3
+BASELINE=$4
+SIZES=${BENCH_SIZES:-"1000 10000 100000 1000000"}
+TOLERANCE=${BENCH_TOLERANCE:-0.20}
+THREADS=${BENCH_THREADS:-1}
+# phases shorter than this in the baseline are too noisy to compare
+MIN_WALL_NS=${BENCH_MIN_WALL_NS:-5000000}
+PERF=
+if [ -n "$BENCH_PERF" ] && [ "$BENCH_PERF" != 0 ]; then
+    PERF=--perf-counters
+fi
+LAZY=
+if [ -n "$BENCH_LAZY" ] && [ "$BENCH_LAZY" != 0 ]; then
+    LAZY=--lazy-bodies
+fi
+
+if [ -z "$FLEXC" ] || [ -z "$FLEXGEN" ] || [ -z "$OUT" ]; then
+    echo "usage: bench.sh <flexc> <flexgen> <out dir> [baseline.json]" >&2
+    exit 1
+fi
+mkdir -p "$OUT" || exit 1
+RESULTS="$OUT/results.json"
+
+printf '{"tolerance":%s,"threads":%s,"results":[\n' "$TOLERANCE" "$THREADS" > "$RESULTS.tmp"
+first=1
+for lines in $SIZES; do
+    corpus="$OUT/corpus-$lines"
+    rm -rf "$corpus"
+    "$FLEXGEN" -o "$corpus" --lines "$lines" --files $((lines / 20000 + 1)) > /dev/null || exit 1
+    report="$OUT/report-$lines.json"
+    if ! "$FLEXC" -oir "$OUT/bench.ir" --check-all -j "$THREADS" --time-report=json --time-report-out "$report" $PERF $LAZY "$corpus"/*.flex > "$OUT/flexc-$lines.log" 2>&1; then
+        echo "flexc failed on the $lines line corpus, see $OUT/flexc-$lines.log" >&2
+        exit 1
+    fi
+    # the report is a single line of json written by flexc, so its layout is fixed
+    total_lines=$(grep -o '"lines":[0-9]*' "$report" | awk -F: '{ sum += $2 } END { print sum }')
+    tokens=$(grep -o '"counters":{"tokens":[0-9]*' "$report" | awk -F: '{ print $3 }')
+    grep -Eo '\{"name":"[^"]*","wall_ns":[0-9]*,"cpu_ns":[0-9]*,"count":[0-9]*,"peak_rss_kb":[0-9]*(,"perf":\{[^}]*\})?\}' "$report" | \
+        awk -F'[:,"{}]+' -v lines="$total_lines" -v tokens="$tokens" -v size="$lines" -v first="$first" '
+        function rate(n, ns) { return ns == 0 ? 0 : n * 1000000000 / ns }
+        $9 > 0 {
+            wall += $5
+            if ($11 > rss) rss = $11
+            perf = match($0, /,"perf":\{[^}]*\}/) ? substr($0, RSTART, RLENGTH) : ""
+            printf "%s{\"size\":%s,\"phase\":\"%s\",\"lines\":%s,\"tokens\":%s,\"wall_ns\":%s,\"cpu_ns\":%s,\"lines_per_s\":%.0f,\"tokens_per_s\":%.0f,\"peak_rss_kb\":%s%s}\n", first ? "" : ",", size, $3, lines, tokens, $5, $7, rate(lines, $5), rate(tokens, $5), $11, perf
+            first = 0
+        }
+        END {
+            printf ",{\"size\":%s,\"phase\":\"total\",\"lines\":%s,\"tokens\":%s,\"wall_ns\":%s,\"cpu_ns\":0,\"lines_per_s\":%.0f,\"tokens_per_s\":%.0f,\"peak_rss_kb\":%s}\n", size, lines, tokens, wall, rate(lines, wall), rate(tokens, wall), rss
+        }' >> "$RESULTS.tmp"
+    first=0
+done
+echo ']}' >> "$RESULTS.tmp"
+mv "$RESULTS.tmp" "$RESULTS" || exit 1
+
+# size, phase, lines/s and peak RSS of every result line
+summarize() {
+    grep '"phase"' "$1" | awk -F'[:,"{}]+' '{ gsub(/ /, "_", $5); print $3, $5, $11, $15, $19 }'
+}
+
+summarize "$RESULTS" | awk '
+    BEGIN { printf "%10s %-20s %14s %14s %12s\n", "lines", "phase", "wall ms", "lines/s", "peak rss kb" }
+    { printf "%10s %-20s %14.3f %14s %12s\n", $1, $2, $3 / 1000000, $4, $5 }'
+echo "results written to $RESULTS"
+
+if [ -z "$BASELINE" ]; then
+    exit 0
+fi
+if [ ! -f "$BASELINE" ]; then
+    echo "no baseline at $BASELINE" >&2
+    exit 1
+fi
+{ summarize "$BASELINE" | sed 's/^/base /'; summarize "$RESULTS" | sed 's/^/new /'; } | \
+    awk -v tolerance="$TOLERANCE" -v min_wall="$MIN_WALL_NS" '
+    $1 == "base" { wall[$2 " " $3] = $4; speed[$2 " " $3] = $5; rss[$2 " " $3] = $6; next }
+    {
+        key = $2 " " $3
+        if (!(key in speed)) next
+        if (wall[key] >= min_wall && $5 < speed[key] * (1 - tolerance)) {
+            printf "regression: %s lines %s: %s lines/s, baseline %s\n", $2, $3, $5, speed[key]
+            failed = 1
+        }
+        if ($6 > rss[key] * (1 + tolerance)) {
+            printf "regression: %s lines %s: %s kb peak rss, baseline %s\n", $2, $3, $6, rss[key]
+            failed = 1
+        }
+    }
+    END {
+        if (failed) exit 1
+        printf "within %s of the baseline\n", tolerance
+    }'
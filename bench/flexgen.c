@@ -0,0 +1,202 @@
+// generates synthetic Flex projects for benchmarking flexc. the same options and seed always give the same files.
+// flexgen -o <dir> [--lines n] [--files n] [--modules n] [--depth n] [--classes n] [--generics n] [--imports n]
+//         [--funcs n] [--lambdas n] [--expr-depth n] [--seed n]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+struct gen_options {
+    char* out_dir;
+    uint64_t lines; // keeps adding modules until this many lines are written, 0 for exactly modules
+    uint64_t files;
+    uint64_t modules;
+    uint64_t depth; // of nested submodules in each module
+    uint64_t classes; // per module and submodule
+    uint64_t generics; // generic classes per module, each instantiated once per class
+    uint64_t imports; // of earlier modules, per module
+    uint64_t funcs; // per module and submodule
+    uint64_t lambdas; // per function
+    uint64_t expr_depth;
+    uint64_t seed;
+};
+
+struct gen_state {
+    struct gen_options* opts;
+    FILE* out;
+    uint64_t lines;
+    uint64_t rand;
+};
+
+uint64_t _gen_rand(struct gen_state* gen) {
+    // xorshift64*
+    gen->rand ^= gen->rand >> 12;
+    gen->rand ^= gen->rand << 25;
+    gen->rand ^= gen->rand >> 27;
+    return gen->rand * 0x2545F4914F6CDD1DULL;
+}
+
+void _gen_line(struct gen_state* gen, uint64_t indent, const char* fmt, ...) {
+    for (uint64_t i = 0; i < indent; i++) fputs("    ", gen->out);
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(gen->out, fmt, args);
+    va_end(args);
+    fputc('\n', gen->out);
+    gen->lines++;
+}
+
+const char* gen_ops[] = {"+", "-", "*", "/", "%", "&", "|", "^"};
+
+// an expression over arg of the given nesting depth, on one line. the leftmost leaf is always arg, flexc does not
+// type operations on literals alone as uint32.
+void _gen_expr(struct gen_state* gen, uint64_t depth, uint8_t leftmost) {
+    if (depth == 0) {
+        if (leftmost || _gen_rand(gen) % 2 == 0) fputs("arg", gen->out);
+        else fprintf(gen->out, "%lu", 1 + _gen_rand(gen) % 97);
+        return;
+    }
+    fputc('(', gen->out);
+    _gen_expr(gen, depth - 1, 1);
+    const char* op = gen_ops[_gen_rand(gen) % (sizeof(gen_ops) / sizeof(char*))];
+    fprintf(gen->out, " %s ", op);
+    // multiplying two uint32s widens the result, which the enclosing operation would reject
+    if (op[0] == '*') fprintf(gen->out, "%lu", 1 + _gen_rand(gen) % 97);
+    else _gen_expr(gen, _gen_rand(gen) % depth, 0);
+    fputc(')', gen->out);
+}
+
+void _gen_func(struct gen_state* gen, uint64_t indent, const char* name) {
+    struct gen_options* opts = gen->opts;
+    _gen_line(gen, indent, "pub func uint32 %s(uint32 arg) {", name);
+    for (uint64_t i = 0; i < indent + 1; i++) fputs("    ", gen->out);
+    fputs("uint32 local = ", gen->out);
+    _gen_expr(gen, opts->expr_depth, 1);
+    fputs(";\n", gen->out);
+    gen->lines++;
+    for (uint64_t i = 0; i < opts->lambdas; i++) {
+        _gen_line(gen, indent + 1, "<uint32 v%lu> uint32 => v%lu * %lu;", i, i, i + 2);
+    }
+    _gen_line(gen, indent + 1, "if (arg > %lu) arg + arg else arg", _gen_rand(gen) % 100);
+    _gen_line(gen, indent, "}");
+}
+
+// the body of a module or submodule named prefix
+void _gen_body(struct gen_state* gen, uint64_t indent, const char* prefix, uint64_t depth) {
+    struct gen_options* opts = gen->opts;
+    char name[256];
+    for (uint64_t i = 0; i < opts->classes; i++) {
+        _gen_line(gen, indent, "pub class %s_C%lu {", prefix, i);
+        _gen_line(gen, indent + 1, "uint32 field = %lu;", i);
+        _gen_func(gen, indent + 1, "get");
+        _gen_line(gen, indent, "}");
+    }
+    for (uint64_t i = 0; i < opts->funcs; i++) {
+        snprintf(name, sizeof(name), "%s_f%lu", prefix, i);
+        _gen_func(gen, indent, name);
+    }
+    if (depth > 0) {
+        _gen_line(gen, indent, "pub module sub%lu {", depth);
+        snprintf(name, sizeof(name), "%s_s%lu", prefix, depth);
+        _gen_body(gen, indent + 1, name, depth - 1);
+        _gen_line(gen, indent, "}");
+    }
+}
+
+void _gen_module(struct gen_state* gen, uint64_t index) {
+    struct gen_options* opts = gen->opts;
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "m%lu", index);
+    _gen_line(gen, 0, "pub module %s {", prefix);
+    for (uint64_t i = 0; i < opts->imports && i < index; i++) {
+        _gen_line(gen, 1, "import m%lu", _gen_rand(gen) % index);
+    }
+    for (uint64_t i = 0; i < opts->generics; i++) {
+        _gen_line(gen, 1, "pub class %s_G%lu<A, B> {", prefix, i);
+        _gen_line(gen, 2, "A first;");
+        _gen_line(gen, 2, "B second;");
+        _gen_line(gen, 1, "}");
+        for (uint64_t j = 0; j < opts->classes; j++) {
+            _gen_line(gen, 1, "%s_G%lu<%s_C%lu, %s_C%lu> box%lu_%lu;", prefix, i, prefix, j, prefix, (j + 1) % opts->classes, i, j);
+        }
+    }
+    _gen_body(gen, 1, prefix, opts->depth);
+    _gen_line(gen, 0, "}");
+    _gen_line(gen, 0, "");
+}
+
+int _gen_number(char* arg, uint64_t* value) {
+    char* end = NULL;
+    errno = 0;
+    *value = strtoull(arg, &end, 10);
+    return errno != 0 || end == arg || *end != 0;
+}
+
+int _gen_usage() {
+    fprintf(stderr, "Usage: flexgen -o <dir> [--lines n] [--files n] [--modules n] [--depth n] [--classes n] [--generics n] [--imports n] [--funcs n] [--lambdas n] [--expr-depth n] [--seed n]\n");
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    struct gen_options opts = {NULL, 0, 1, 16, 1, 4, 1, 2, 4, 1, 4, 1};
+    for (int i = 1; i < argc; i++) {
+        uint64_t* value = NULL;
+        if (strcmp(argv[i], "-o") == 0) {
+            if (i >= argc - 1) return _gen_usage();
+            opts.out_dir = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--lines") == 0) value = &opts.lines;
+        else if (strcmp(argv[i], "--files") == 0) value = &opts.files;
+        else if (strcmp(argv[i], "--modules") == 0) value = &opts.modules;
+        else if (strcmp(argv[i], "--depth") == 0) value = &opts.depth;
+        else if (strcmp(argv[i], "--classes") == 0) value = &opts.classes;
+        else if (strcmp(argv[i], "--generics") == 0) value = &opts.generics;
+        else if (strcmp(argv[i], "--imports") == 0) value = &opts.imports;
+        else if (strcmp(argv[i], "--funcs") == 0) value = &opts.funcs;
+        else if (strcmp(argv[i], "--lambdas") == 0) value = &opts.lambdas;
+        else if (strcmp(argv[i], "--expr-depth") == 0) value = &opts.expr_depth;
+        else if (strcmp(argv[i], "--seed") == 0) value = &opts.seed;
+        if (value == NULL || i >= argc - 1 || _gen_number(argv[++i], value) != 0) return _gen_usage();
+    }
+    if (opts.out_dir == NULL || opts.files == 0 || opts.classes == 0) return _gen_usage();
+    if (mkdir(opts.out_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "IO Error: '%s' '%s'\n", strerror(errno), opts.out_dir);
+        return 1;
+    }
+    struct gen_state gen;
+    gen.opts = &opts;
+    gen.lines = 0;
+    gen.rand = opts.seed * 0x9E3779B97F4A7C15ULL + 1;
+    FILE* files[opts.files];
+    for (uint64_t i = 0; i < opts.files; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/gen%lu.flex", opts.out_dir, i);
+        files[i] = fopen(path, "w");
+        if (files[i] == NULL) {
+            fprintf(stderr, "IO Error: '%s' '%s'\n", strerror(errno), path);
+            return 1;
+        }
+    }
+    uint64_t modules = 0;
+    // modules are dealt out to files round robin, so imports mostly cross files
+    while (opts.lines > 0 ? gen.lines < opts.lines : modules < opts.modules) {
+        gen.out = files[modules % opts.files];
+        _gen_module(&gen, modules);
+        modules++;
+    }
+    int status = 0;
+    for (uint64_t i = 0; i < opts.files; i++) {
+        if (fclose(files[i]) != 0) status = 1;
+    }
+    if (status != 0) {
+        fprintf(stderr, "IO Error: '%s' '%s'\n", strerror(errno), opts.out_dir);
+        return 1;
+    }
+    printf("%lu lines, %lu modules, %lu files\n", gen.lines, modules, opts.files);
+    return 0;
+}
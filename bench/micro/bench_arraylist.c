@@ -0,0 +1,77 @@
+// arraylist_add, arraylist_get and arraylist_indexptr over lists of growing size
+#include "micro.h"
+#include "../../src/arraylist.h"
+#include "../../src/smem.h"
+#include <stdio.h>
+
+struct list_ctx {
+    struct arraylist* list;
+    uint64_t size;
+};
+
+void _bench_add(uint64_t ops, void* ctx) {
+    struct arraylist* list = arraylist_new(16, sizeof(uint64_t));
+    for (uint64_t i = 0; i < ops; i++) {
+        arraylist_add(list, i);
+    }
+    micro_sink += list->entry_count;
+    arraylist_free(list);
+}
+
+void _bench_get(uint64_t ops, void* ctx) {
+    struct list_ctx* lc = ctx;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        sum += *arraylist_get(lc->list, i % lc->size);
+    }
+    micro_sink += sum;
+}
+
+void _bench_get_random(uint64_t ops, void* ctx) {
+    struct list_ctx* lc = ctx;
+    uint64_t rand = 1;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        sum += *arraylist_get(lc->list, micro_rand(&rand) % lc->size);
+    }
+    micro_sink += sum;
+}
+
+// every op searches for an entry at an even spread of positions, so on average half the list is scanned
+void _bench_indexptr(uint64_t ops, void* ctx) {
+    struct list_ctx* lc = ctx;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        sum += arraylist_indexptr(lc->list, (void*) (uintptr_t) ((i * 7919) % lc->size + 1));
+    }
+    micro_sink += sum;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t sizes[] = {16, 1024, 65536, 1048576};
+    char name[64];
+    micro_header("arraylist");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(uint64_t); s++) {
+        uint64_t size = sizes[s];
+        snprintf(name, sizeof(name), "add/%lu", size);
+        micro_run(name, size, 0, _bench_add, NULL);
+    }
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(uint64_t); s++) {
+        struct list_ctx lc;
+        lc.size = sizes[s];
+        lc.list = arraylist_new(16, sizeof(void*));
+        for (uint64_t i = 0; i < lc.size; i++) {
+            arraylist_addptr(lc.list, (void*) (uintptr_t) (i + 1));
+        }
+        snprintf(name, sizeof(name), "get/%lu", lc.size);
+        micro_run(name, 1048576, 0, _bench_get, &lc);
+        snprintf(name, sizeof(name), "get random/%lu", lc.size);
+        micro_run(name, 1048576, 0, _bench_get_random, &lc);
+        if (lc.size <= 65536) {
+            snprintf(name, sizeof(name), "indexptr/%lu", lc.size);
+            micro_run(name, 1 + 4194304 / lc.size, 0, _bench_indexptr, &lc);
+        }
+        arraylist_free(lc.list);
+    }
+    return 0;
+}
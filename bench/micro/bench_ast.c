@@ -0,0 +1,104 @@
+// visit_node over deep and wide synthetic trees, next to the plain recursion it replaced
+#include "micro.h"
+#include "../../src/ast.h"
+#include "../../src/arraylist.h"
+#include "../../src/smem.h"
+#include <stdio.h>
+
+struct ast_node* _new_node(uint8_t type) {
+    struct ast_node* node = scalloc(sizeof(struct ast_node));
+    node->type = type;
+    return node;
+}
+
+// a left leaning chain of binary nodes, depth nodes deep, like a long run of a + b + c
+struct ast_node* _gen_deep(uint64_t depth) {
+    struct ast_node* root = _new_node(AST_NODE_IDENTIFIER);
+    for (uint64_t i = 0; i < depth; i++) {
+        struct ast_node* binary = _new_node(AST_NODE_BINARY);
+        binary->data.binary.left = root;
+        binary->data.binary.right = _new_node(AST_NODE_IDENTIFIER);
+        root = binary;
+    }
+    return root;
+}
+
+// a body of width children, each a small binary expression
+struct ast_node* _gen_wide(uint64_t width) {
+    struct ast_node* root = _new_node(AST_NODE_BODY);
+    root->data.body.children = arraylist_new(width, sizeof(struct ast_node*));
+    for (uint64_t i = 0; i < width; i++) {
+        struct ast_node* binary = _new_node(AST_NODE_BINARY);
+        binary->data.binary.left = _new_node(AST_NODE_IDENTIFIER);
+        binary->data.binary.right = _new_node(AST_NODE_IDENTIFIER);
+        arraylist_addptr(root->data.body.children, binary);
+    }
+    return root;
+}
+
+int _count_enter(struct ast_node* node, void* arg) {
+    (*(uint64_t*) arg)++;
+    return AST_VISIT_CONTINUE;
+}
+
+// the shape of the old traverse_node, for the node types these trees use
+void _walk_recursive(struct ast_node* node, int (*enter)(struct ast_node*, void*), void* arg) {
+    enter(node, arg);
+    if (node->type == AST_NODE_BINARY) {
+        _walk_recursive(node->data.binary.left, enter, arg);
+        _walk_recursive(node->data.binary.right, enter, arg);
+    } else if (node->type == AST_NODE_BODY) {
+        for (size_t i = 0; i < node->data.body.children->entry_count; i++) {
+            _walk_recursive(arraylist_getptr(node->data.body.children, i), enter, arg);
+        }
+    }
+}
+
+struct walk_ctx {
+    struct ast_node* root;
+    uint64_t nodes;
+};
+
+// ops is a multiple of the nodes in the tree, each walk counts as that many
+void _bench_visit(uint64_t ops, void* ctx) {
+    struct walk_ctx* wc = ctx;
+    uint64_t count = 0;
+    struct ast_visitor visitor = {_count_enter, NULL, &count};
+    for (uint64_t i = 0; i < ops / wc->nodes; i++) {
+        visit_node(wc->root, &visitor);
+    }
+    micro_sink += count;
+}
+
+void _bench_recursive(uint64_t ops, void* ctx) {
+    struct walk_ctx* wc = ctx;
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < ops / wc->nodes; i++) {
+        _walk_recursive(wc->root, _count_enter, &count);
+    }
+    micro_sink += count;
+}
+
+int main(int argc, char* argv[]) {
+    // 1M nodes per sample at every size
+    uint64_t sizes[] = {1000, 100000};
+    char name[64];
+    micro_header("ast walks, ops are nodes");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(uint64_t); i++) {
+        struct walk_ctx deep = {_gen_deep(sizes[i]), 2 * sizes[i] + 1};
+        uint64_t ops = deep.nodes * (1000000 / deep.nodes + 1);
+        snprintf(name, sizeof(name), "visit/deep %lu", sizes[i]);
+        micro_run(name, ops, 0, _bench_visit, &deep);
+        snprintf(name, sizeof(name), "recursive/deep %lu", sizes[i]);
+        micro_run(name, ops, 0, _bench_recursive, &deep);
+        free_ast_node(deep.root);
+        struct walk_ctx wide = {_gen_wide(sizes[i]), 3 * sizes[i] + 1};
+        ops = wide.nodes * (1000000 / wide.nodes + 1);
+        snprintf(name, sizeof(name), "visit/wide %lu", sizes[i]);
+        micro_run(name, ops, 0, _bench_visit, &wide);
+        snprintf(name, sizeof(name), "recursive/wide %lu", sizes[i]);
+        micro_run(name, ops, 0, _bench_recursive, &wide);
+        free_ast_node(wide.root);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+// hashmap_hash throughput over keys of growing length
+#include "micro.h"
+#include "../../src/hash.h"
+#include "../../src/smem.h"
+#include <stdio.h>
+#include <string.h>
+
+struct hash_ctx {
+    char* keys[64]; // a few distinct keys, so the loop isn't hashing one cached line
+    size_t len;
+};
+
+void _bench_hash(uint64_t ops, void* ctx) {
+    struct hash_ctx* hc = ctx;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        sum += hashmap_hash(hc->keys[i % 64]);
+    }
+    micro_sink += sum;
+}
+
+int main(int argc, char* argv[]) {
+    size_t lens[] = {4, 8, 16, 32, 128, 1024};
+    char name[64];
+    micro_header("hashmap_hash");
+    for (size_t l = 0; l < sizeof(lens) / sizeof(size_t); l++) {
+        struct hash_ctx hc;
+        hc.len = lens[l];
+        uint64_t rand = 1;
+        for (int i = 0; i < 64; i++) {
+            hc.keys[i] = smalloc(hc.len + 1);
+            for (size_t j = 0; j < hc.len; j++) {
+                hc.keys[i][j] = 'a' + micro_rand(&rand) % 26;
+            }
+            hc.keys[i][hc.len] = 0;
+        }
+        snprintf(name, sizeof(name), "hash/%lu bytes", hc.len);
+        uint64_t ops = 1048576;
+        micro_run(name, ops, ops * hc.len, _bench_hash, &hc);
+        for (int i = 0; i < 64; i++) {
+            free(hc.keys[i]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+// hashmap_put and hashmap_get with identifier-like keys, hashmap_putptr and hashmap_getptr with pointer keys
+#include "micro.h"
+#include "../../src/hash.h"
+#include "../../src/smem.h"
+#include <stdio.h>
+
+struct map_ctx {
+    struct hashmap* map;
+    char** names; // identifiers shaped like the ones flexc resolves, module prefixed
+    void** ptrs; // separate allocations, so they have the alignment of real ast nodes and types
+    uint64_t size;
+};
+
+void _bench_put(uint64_t ops, void* ctx) {
+    struct map_ctx* mc = ctx;
+    struct hashmap* map = new_hashmap(16);
+    for (uint64_t i = 0; i < ops; i++) {
+        hashmap_put(map, mc->names[i % mc->size], mc->names[i % mc->size]);
+    }
+    micro_sink += map->entry_count;
+    free_hashmap(map);
+}
+
+void _bench_get(uint64_t ops, void* ctx) {
+    struct map_ctx* mc = ctx;
+    uint64_t rand = 1;
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        found += hashmap_get(mc->map, mc->names[micro_rand(&rand) % mc->size]) != NULL;
+    }
+    micro_sink += found;
+}
+
+void _bench_get_miss(uint64_t ops, void* ctx) {
+    struct map_ctx* mc = ctx;
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        found += hashmap_get(mc->map, "missing_identifier") != NULL;
+    }
+    micro_sink += found;
+}
+
+void _bench_putptr(uint64_t ops, void* ctx) {
+    struct map_ctx* mc = ctx;
+    struct hashmap* map = new_hashmap(16);
+    for (uint64_t i = 0; i < ops; i++) {
+        hashmap_putptr(map, mc->ptrs[i % mc->size], mc->ptrs[i % mc->size]);
+    }
+    micro_sink += map->entry_count;
+    free_hashmap(map);
+}
+
+void _bench_getptr(uint64_t ops, void* ctx) {
+    struct map_ctx* mc = ctx;
+    uint64_t rand = 1;
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        found += hashmap_getptr(mc->map, mc->ptrs[micro_rand(&rand) % mc->size]) != NULL;
+    }
+    micro_sink += found;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t sizes[] = {16, 1024, 65536, 262144};
+    char name[64];
+    micro_header("hashmap");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(uint64_t); s++) {
+        struct map_ctx mc;
+        mc.size = sizes[s];
+        mc.names = smalloc(mc.size * sizeof(char*));
+        mc.ptrs = smalloc(mc.size * sizeof(void*));
+        for (uint64_t i = 0; i < mc.size; i++) {
+            mc.names[i] = smalloc(32);
+            snprintf(mc.names[i], 32, "m%lu_C%lu_field", i / 16, i % 16);
+            mc.ptrs[i] = smalloc(48);
+        }
+        snprintf(name, sizeof(name), "put/%lu", mc.size);
+        micro_run(name, mc.size, 0, _bench_put, &mc);
+        mc.map = new_hashmap(16);
+        for (uint64_t i = 0; i < mc.size; i++) {
+            hashmap_put(mc.map, mc.names[i], mc.names[i]);
+        }
+        snprintf(name, sizeof(name), "get/%lu", mc.size);
+        micro_run(name, 1048576, 0, _bench_get, &mc);
+        snprintf(name, sizeof(name), "get miss/%lu", mc.size);
+        micro_run(name, 1048576, 0, _bench_get_miss, &mc);
+        free_hashmap(mc.map);
+        snprintf(name, sizeof(name), "putptr/%lu", mc.size);
+        micro_run(name, mc.size, 0, _bench_putptr, &mc);
+        mc.map = new_hashmap(16);
+        for (uint64_t i = 0; i < mc.size; i++) {
+            hashmap_putptr(mc.map, mc.ptrs[i], mc.ptrs[i]);
+        }
+        snprintf(name, sizeof(name), "getptr/%lu", mc.size);
+        micro_run(name, 1048576, 0, _bench_getptr, &mc);
+        free_hashmap(mc.map);
+        for (uint64_t i = 0; i < mc.size; i++) {
+            free(mc.names[i]);
+            free(mc.ptrs[i]);
+        }
+        free(mc.names);
+        free(mc.ptrs);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+// tokenize over generated sources dominated by keywords, identifiers or literals
+#include "micro.h"
+#include "../../src/lexer.h"
+#include "../../src/arraylist.h"
+#include "../../src/smem.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SOURCE_SIZE (256 * 1024)
+
+struct lex_ctx {
+    char* source;
+    size_t len;
+};
+
+void _bench_tokenize(uint64_t ops, void* ctx) {
+    struct lex_ctx* lc = ctx;
+    for (uint64_t i = 0; i < ops; i++) {
+        struct arraylist* tokens = arraylist_new(128, sizeof(struct token*));
+        tokenize(lc->source, lc->len, tokens);
+        micro_sink += tokens->entry_count;
+        for (size_t j = 0; j < tokens->entry_count; j++) {
+            struct token* token = arraylist_getptr(tokens, j);
+            free(token->value);
+            free(token);
+        }
+        arraylist_free(tokens);
+    }
+}
+
+// fills about SOURCE_SIZE bytes with lines picked from words
+char* _gen_source(const char** words, size_t word_count, size_t* len) {
+    char* source = smalloc(SOURCE_SIZE + 256);
+    size_t at = 0;
+    uint64_t rand = 1;
+    while (at < SOURCE_SIZE) {
+        for (int i = 0; i < 8; i++) {
+            at += sprintf(source + at, "%s ", words[micro_rand(&rand) % word_count]);
+        }
+        source[at++] = '\n';
+    }
+    source[at] = 0;
+    *len = at;
+    return source;
+}
+
+int main(int argc, char* argv[]) {
+    const char* keywords[] = {"pub", "func", "class", "module", "import", "if", "else", "return", "const", "uint32", "for", "while", "new", "static", "pure"};
+    const char* identifiers[] = {"first_value", "resolver", "m12_C3", "scope_depth", "VisibleTypes", "arg", "local_index", "x", "prog_state", "token_count"};
+    const char* literals[] = {"12345", "0x7fff", "3.25", "\"a string literal\"", "'c'", "1e9", "\"escaped \\\" quote\"", "42"};
+    const char* mixed[] = {"pub", "func", "uint32", "arg", "(", ")", "{", "}", "+", "==", ";", "local", "17", "\"s\""};
+    struct {
+        const char* name;
+        const char** words;
+        size_t count;
+    } inputs[] = {
+        {"keyword dense", keywords, sizeof(keywords) / sizeof(char*)},
+        {"identifier dense", identifiers, sizeof(identifiers) / sizeof(char*)},
+        {"literal dense", literals, sizeof(literals) / sizeof(char*)},
+        {"mixed", mixed, sizeof(mixed) / sizeof(char*)},
+    };
+    char name[64];
+    micro_header("tokenize, ops are whole inputs");
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        struct lex_ctx lc;
+        lc.source = _gen_source(inputs[i].words, inputs[i].count, &lc.len);
+        snprintf(name, sizeof(name), "tokenize/%s", inputs[i].name);
+        micro_run(name, 4, 4 * lc.len, _bench_tokenize, &lc);
+        free(lc.source);
+    }
+    return 0;
+}
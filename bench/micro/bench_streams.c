@@ -0,0 +1,54 @@
+// readUntilEnd from a temporary file of growing size
+#include "micro.h"
+#include "../../src/streams.h"
+#include "../../src/smem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+struct read_ctx {
+    int fd;
+    size_t size;
+};
+
+void _bench_read(uint64_t ops, void* ctx) {
+    struct read_ctx* rc = ctx;
+    for (uint64_t i = 0; i < ops; i++) {
+        lseek(rc->fd, 0, SEEK_SET);
+        void* buf = NULL;
+        micro_sink += readUntilEnd(rc->fd, &buf);
+        free(buf);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t sizes[] = {1024, 65536, 1048576, 16777216};
+    char name[64];
+    char path[] = "/tmp/flexc-micro-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    unlink(path);
+    char* data = smalloc(sizes[sizeof(sizes) / sizeof(size_t) - 1]);
+    memset(data, 'x', sizes[sizeof(sizes) / sizeof(size_t) - 1]);
+    micro_header("readUntilEnd, from the page cache");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(size_t); s++) {
+        struct read_ctx rc;
+        rc.fd = fd;
+        rc.size = sizes[s];
+        if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0 || writeFully(fd, data, rc.size) != (ssize_t) rc.size) {
+            perror("write");
+            return 1;
+        }
+        uint64_t ops = 1 + 67108864 / rc.size;
+        snprintf(name, sizeof(name), "readUntilEnd/%lu bytes", rc.size);
+        micro_run(name, ops, ops * rc.size, _bench_read, &rc);
+    }
+    free(data);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "micro.h"
+#include "../../src/perf_counters.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+volatile uint64_t micro_sink = 0;
+
+// 0 until the first benchmark, then 1 if counters opened or 2 if they are off or unavailable
+int micro_perf = 0;
+
+uint64_t _micro_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t _micro_samples() {
+    char* env = getenv("MICRO_SAMPLES");
+    if (env == NULL) return 10;
+    uint64_t samples = strtoull(env, NULL, 10);
+    return samples < 2 ? 2 : samples;
+}
+
+int _micro_perf_enabled() {
+    if (micro_perf == 0) {
+        char* env = getenv("MICRO_PERF");
+        micro_perf = 2;
+        if (env != NULL && strcmp(env, "0") != 0) {
+            if (perf_counters_open() > 0) micro_perf = 1;
+            else fprintf(stderr, "Warning: hardware counters are unavailable: %s\n", strerror(errno));
+        }
+    }
+    return micro_perf == 1;
+}
+
+void micro_header(const char* title) {
+    printf("%s\n%-40s %10s %12s %12s %12s %10s\n", title, "benchmark", "ops", "ns/op", "stddev", "min", "MB/s");
+}
+
+void micro_run(const char* name, uint64_t ops, uint64_t bytes, micro_fn fn, void* ctx) {
+    uint64_t samples = _micro_samples();
+    double per_op[samples];
+    fn(ops, ctx);
+    double mean = 0;
+    double min = 0;
+    uint64_t perf_start[PERF_COUNTER_COUNT];
+    uint64_t perf_end[PERF_COUNTER_COUNT];
+    uint8_t perf = _micro_perf_enabled();
+    if (perf) perf_counters_read(perf_start);
+    for (uint64_t i = 0; i < samples; i++) {
+        uint64_t start = _micro_now_ns();
+        fn(ops, ctx);
+        per_op[i] = (double) (_micro_now_ns() - start) / ops;
+        mean += per_op[i];
+        if (i == 0 || per_op[i] < min) min = per_op[i];
+    }
+    if (perf) perf_counters_read(perf_end);
+    mean /= samples;
+    double variance = 0;
+    for (uint64_t i = 0; i < samples; i++) {
+        variance += (per_op[i] - mean) * (per_op[i] - mean);
+    }
+    double stddev = sqrt(variance / (samples - 1));
+    if (bytes > 0) {
+        printf("%-40s %10lu %12.2f %12.2f %12.2f %10.1f\n", name, ops, mean, stddev, min, bytes / (mean * ops) * 1000.0);
+    } else {
+        printf("%-40s %10lu %12.2f %12.2f %12.2f %10s\n", name, ops, mean, stddev, min, "-");
+    }
+    if (perf) {
+        printf("%-40s", "  per op");
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+            if (perf_counter_available(i)) printf(" %s %.2f", PERF_COUNTER_NAMES[i], (double) (perf_end[i] - perf_start[i]) / (samples * ops));
+        }
+        printf("\n");
+    }
+}
+
+uint64_t micro_rand(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
@@ -0,0 +1,22 @@
+#ifndef __MICRO_H__
+#define __MICRO_H__
+
+#include <stdint.h>
+
+// each benchmark runs fn once to warm up, then MICRO_SAMPLES (default 10) timed times, and prints the mean, standard
+// deviation and minimum in ns per op. bytes per sample > 0 also prints MB/s of the mean. MICRO_PERF=1 adds a line of
+// hardware counters per op over all samples, where perf_event_open is allowed.
+
+typedef void (*micro_fn)(uint64_t ops, void* ctx);
+
+// stores results where the compiler can't drop the work that made them
+extern volatile uint64_t micro_sink;
+
+void micro_header(const char* title);
+
+void micro_run(const char* name, uint64_t ops, uint64_t bytes, micro_fn fn, void* ctx);
+
+// xorshift64*, the same sequence every run
+uint64_t micro_rand(uint64_t* state);
+
+#endif
@@ -6,9 +6,9 @@
 
 
 struct arraylist* arraylist_new(size_t initial_capacity, size_t entry_size) {
-    struct arraylist* list = scalloc(sizeof(struct arraylist));
-    list->entries = smalloc(sizeof(void*));
-    list->entries[0] = scalloc(entry_size * initial_capacity);
+    struct arraylist* list = scallocTag(sizeof(struct arraylist), SMEM_TAG_ARRAYLIST);
+    list->entries = smallocTag(sizeof(void*), SMEM_TAG_ARRAYLIST);
+    list->entries[0] = scallocTag(entry_size * initial_capacity, SMEM_TAG_ARRAYLIST);
     list->entry_size = entry_size;
     list->capacity = initial_capacity;
     list->initial_capacity = initial_capacity;
@@ -26,7 +26,7 @@ void arraylist_free(struct arraylist* list) {
 }
 
 size_t arraylist_arrayify(struct arraylist* list, void** array) {
-    *array = scalloc(list->entry_size * list->entry_count);
+    *array = scallocTag(list->entry_size * list->entry_count, SMEM_TAG_ARRAYLIST);
     size_t ai = 0;
     uint8_t* arr = *array;
     size_t ccap = list->initial_capacity;
@@ -103,8 +103,8 @@ void arraylist_ensurecap(struct arraylist* list, size_t cap) {
         size_t ls = list->capacity;
         list->capacity *= 2;
         list->list_entry_count++;
-        list->entries = srealloc(list->entries, list->list_entry_count * sizeof(void*));
-        list->entries[list->list_entry_count - 1] = scalloc(ls * list->entry_size);
+        list->entries = sreallocTag(list->entries, list->list_entry_count * sizeof(void*), SMEM_TAG_ARRAYLIST);
+        list->entries[list->list_entry_count - 1] = scallocTag(ls * list->entry_size, SMEM_TAG_ARRAYLIST);
     }
 }
 
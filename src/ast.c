@@ -10,9 +10,9 @@
 
 #define PARSE_ERROR_UNEXPECTED_TOKEN(token, expecting) {struct parse_error* perr = smalloc(sizeof(struct parse_error)); size_t bs = strlen((token)->value) + strlen(expecting) + 128; perr->message = smalloc(bs); snprintf(perr->message, bs, "Unexpected token: '%s' @ %lu:%lu. Expecting " expecting ".\n", (token)->value, (token)->line, (token)->start_col); perr->line = (token)->line; perr->col = (token)->start_col; perr->type = PARSE_ERROR_TYPE_UNEXPECTED_TOKEN; arraylist_addptr(ctx->parse_errors, perr);free_ast_node(node);return NULL;}
 #define INIT_PARSE_FUNC() struct token* ttok = NULL;
-#define ALLOC_NODE(typex) struct ast_node* node = scalloc(sizeof(struct ast_node)); node->type = typex;
+#define ALLOC_NODE(typex) struct ast_node* node = scallocTag(sizeof(struct ast_node), SMEM_TAG_AST_NODE); node->type = typex;
 #define DUMMY_NODE() struct ast_node* node = NULL; struct ast_node dummy_node; struct ast_node* dummy_node_ptr = &dummy_node;
-#define ALLOC_NODE_DUMMY(typex) node = scalloc(sizeof(struct ast_node)); node->type = typex;
+#define ALLOC_NODE_DUMMY(typex) node = scallocTag(sizeof(struct ast_node), SMEM_TAG_AST_NODE); node->type = typex;
 #define START_NODE(nodex) if( nodex != NULL && *token_count > 0) { nodex->start_line = nodex->end_line = (*tokens)[0]->line; nodex->start_col = (*tokens)[0]->start_col; nodex->end_col = (*tokens)[0]->start_col; }
 #define END_NODE(nodex) if ( nodex != NULL){ nodex->end_line = (*tokens)[-1]->line; nodex->end_col = (*tokens)[-1]->end_col; }
 #define START_DUMMY_NODE() START_NODE(dummy_node_ptr)
@@ -28,7 +28,7 @@
 #define STORE_TOKEN_STATE(state) struct token** tokensState_##state = *tokens; size_t token_count_##state = *token_count; size_t error_entry_count_##state = ctx->parse_errors->entry_count;
 #define RESTORE_TOKEN_STATE(state) *tokens = tokensState_##state; *token_count = token_count_##state; ctx->parse_errors->entry_count = error_entry_count_##state;
 
-const char* AST_TYPE_NAMES[] = {"BODY", "FILE", "MODULE", "CLASS", "FUNC", "UNARY_POSTFIX", "UNARY", "CALL", "CALC_MEMBER", "CAST", "BINARY", "VAR_DECL", "TYPE", "INTEGER_LIT", "DECIMAL_LIT", "STRING_LIT", "CHAR_LIT", "IDENTIFIER", "TERNARY", "IF", "FOR", "WHILE", "FOR_EACH", "SWITCH", "CASE", "DEFAULT_CASE", "GOTO", "RET", "CONTINUE", "BREAK", "TRY", "THROW", "NEW", "LABEL", "EMPTY", "IMPORT", "IMP_NEW", "NULL"};
+const char* AST_TYPE_NAMES[] = {"BODY", "FILE", "MODULE", "CLASS", "FUNC", "UNARY_POSTFIX", "UNARY", "CALL", "CALC_MEMBER", "CAST", "BINARY", "VAR_DECL", "TYPE", "INTEGER_LIT", "DECIMAL_LIT", "STRING_LIT", "CHAR_LIT", "IDENTIFIER", "TERNARY", "IF", "FOR", "WHILE", "FOR_EACH", "SWITCH", "CASE", "DEFAULT_CASE", "GOTO", "RET", "CONTINUE", "BREAK", "TRY", "THROW", "NEW", "LABEL", "EMPTY", "IMPORT", "IMP_NEW", "NULL", "LAZY_BODY"};
 const char* UNARY_OP_NAMES[] = {"++", "--", "+", "-", "!", "~", "*", "&"};
 const char* BINARY_OP_NAMES[] = {".", "*", "/", "%", "+", "-", "<<", ">>", "<", "<=", ">", ">=", "inst", "==", "!=", "&", "^", "|", "&&", "||", "=", "*=", "/=", "%=", "+=", "-=", "<<=", ">>=", "===", "!==", "&=", "^=", "|=", "&&=", "||=", "*== ", "/==", "%==", "+==", "-==", "<<==", ">>==", "&==", "^==", "|==", "&&==", "||==", ","};
 const char* PROT_STRING[] = {"NONE", "PRIV", "PROT", "PUB"};
@@ -74,129 +74,211 @@ uint8_t maybe_protection(struct token*** tokens, size_t* token_count) {
     }
 }
 
-#define TRAVERSE(item) item = traverse_node(item, traverser, arg, pre);
-#define TRAVERSE_ARRAYLIST(list) if (list != NULL) { for (size_t i = 0; i < list->entry_count; i++) { struct ast_node* node = arraylist_getptr(list, i); struct ast_node* new_node = traverse_node(node, traverser, arg, pre); if (new_node != node) { arraylist_setptr(list, i, new_node); } } }
+// children are pushed last to first, so they pop in source order, list entries included
+#define VISIT_PUSH(item) if ((item) != NULL) _visit_push(stack, item);
+#define VISIT_PUSH_ARRAYLIST(list) if ((list) != NULL) _visit_push_list(stack, list);
 
-struct ast_node* traverse_node(struct ast_node* root, struct ast_node* (traverser)(struct ast_node*, void*), void* arg, int pre) {
-    if (root == NULL) return NULL;
-    if (pre) root = traverser(root, arg);
-    if (root == NULL) return NULL;
+struct _visit_frame {
+    struct ast_node* node;
+    uint8_t entered;
+};
+
+// one per thread, reused by every walk on it. a walk started from a visitor's callback stacks on top of the one that
+// called it and only pops its own frames.
+struct _visit_stack {
+    struct _visit_frame* frames; // local unless a walk outgrew it, then on the heap until the outermost walk ends
+    size_t count;
+    size_t cap;
+    struct _visit_frame local[256];
+};
+
+__thread struct _visit_stack _visit_stack_local;
+
+void _visit_reserve(struct _visit_stack* stack, size_t count) {
+    if (stack->count + count <= stack->cap) return;
+    while (stack->count + count > stack->cap) stack->cap *= 2;
+    if (stack->frames == stack->local) {
+        stack->frames = smalloc(stack->cap * sizeof(struct _visit_frame));
+        memcpy(stack->frames, stack->local, stack->count * sizeof(struct _visit_frame));
+    } else {
+        stack->frames = srealloc(stack->frames, stack->cap * sizeof(struct _visit_frame));
+    }
+}
+
+void _visit_push(struct _visit_stack* stack, struct ast_node* node) {
+    if (stack->count == stack->cap) _visit_reserve(stack, 1);
+    struct _visit_frame* frame = &stack->frames[stack->count++];
+    frame->node = node;
+    frame->entered = 0;
+}
+
+void _visit_push_list(struct _visit_stack* stack, struct arraylist* list) {
+    _visit_reserve(stack, list->entry_count);
+    for (size_t i = list->entry_count; i > 0; i--) {
+        struct ast_node* child = arraylist_getptr(list, i - 1);
+        if (child == NULL) continue;
+        struct _visit_frame* frame = &stack->frames[stack->count++];
+        frame->node = child;
+        frame->entered = 0;
+    }
+}
+
+void _visit_push_children(struct _visit_stack* stack, struct ast_node* root) {
     switch (root->type) {
         case AST_NODE_BINARY:
-        TRAVERSE(root->data.binary.left);
-        TRAVERSE(root->data.binary.right);
+        VISIT_PUSH(root->data.binary.right);
+        VISIT_PUSH(root->data.binary.left);
         break;
         case AST_NODE_BODY:
-        TRAVERSE_ARRAYLIST(root->data.body.children);
+        VISIT_PUSH_ARRAYLIST(root->data.body.children);
         break;
         case AST_NODE_CALC_MEMBER:
-        TRAVERSE(root->data.calc_member.parent);
-        TRAVERSE(root->data.calc_member.calc);
+        VISIT_PUSH(root->data.calc_member.calc);
+        VISIT_PUSH(root->data.calc_member.parent);
         break;
         case AST_NODE_CALL:
-        TRAVERSE(root->data.call.func);
-        TRAVERSE_ARRAYLIST(root->data.call.parameters);
+        VISIT_PUSH_ARRAYLIST(root->data.call.parameters);
+        VISIT_PUSH(root->data.call.func);
         break;
         case AST_NODE_CASE:
-        TRAVERSE(root->data._case.value);
-        TRAVERSE(root->data._case.expr);
+        VISIT_PUSH(root->data._case.expr);
+        VISIT_PUSH(root->data._case.value);
         break;
         case AST_NODE_CAST:
-        TRAVERSE(root->data.cast.type);
-        TRAVERSE(root->data.cast.expr);
+        VISIT_PUSH(root->data.cast.expr);
+        VISIT_PUSH(root->data.cast.type);
         break;
         case AST_NODE_CLASS:
-        TRAVERSE_ARRAYLIST(root->data.class.parents);
-        TRAVERSE(root->data.class.body);
+        VISIT_PUSH(root->data.class.body);
+        VISIT_PUSH_ARRAYLIST(root->data.class.parents);
         break;
         case AST_NODE_DEFAULT_CASE:
-        TRAVERSE(root->data.default_case.expr);
+        VISIT_PUSH(root->data.default_case.expr);
         break;
         case AST_NODE_FILE:
-        TRAVERSE(root->data.file.body);
+        VISIT_PUSH(root->data.file.body);
         break;
         case AST_NODE_FOR:
-        TRAVERSE(root->data._for.init);
-        TRAVERSE(root->data._for.loop);
-        TRAVERSE(root->data._for.final);
-        TRAVERSE(root->data._for.expr);
+        VISIT_PUSH(root->data._for.expr);
+        VISIT_PUSH(root->data._for.final);
+        VISIT_PUSH(root->data._for.loop);
+        VISIT_PUSH(root->data._for.init);
         break;
         case AST_NODE_FOR_EACH:
-        TRAVERSE(root->data.for_each.init);
-        TRAVERSE(root->data.for_each.loop);
-        TRAVERSE(root->data.for_each.expr);
+        VISIT_PUSH(root->data.for_each.expr);
+        VISIT_PUSH(root->data.for_each.loop);
+        VISIT_PUSH(root->data.for_each.init);
         break;
         case AST_NODE_FUNC:
-        TRAVERSE(root->data.func.return_type);
-        TRAVERSE_ARRAYLIST(root->data.func.arguments);
-        TRAVERSE(root->data.func.body);
+        VISIT_PUSH(root->data.func.body);
+        VISIT_PUSH_ARRAYLIST(root->data.func.arguments);
+        VISIT_PUSH(root->data.func.return_type);
         break;
         case AST_NODE_GOTO:
-        TRAVERSE(root->data._goto.expr);
+        VISIT_PUSH(root->data._goto.expr);
         break;
         case AST_NODE_IF:
-        TRAVERSE(root->data._if.condition);
-        TRAVERSE(root->data._if.expr);
-        TRAVERSE(root->data._if.elseExpr);
+        VISIT_PUSH(root->data._if.elseExpr);
+        VISIT_PUSH(root->data._if.expr);
+        VISIT_PUSH(root->data._if.condition);
         break;
         case AST_NODE_MODULE:
-        TRAVERSE(root->data.module.body);
+        VISIT_PUSH(root->data.module.body);
         break;
         case AST_NODE_NEW:
-        TRAVERSE(root->data.new.type);
+        VISIT_PUSH(root->data.new.type);
         break;
         case AST_NODE_RET:
-        TRAVERSE(root->data.ret.expr);
+        VISIT_PUSH(root->data.ret.expr);
         break;
         case AST_NODE_SWITCH:
-        TRAVERSE(root->data._switch.switch_on);
-        TRAVERSE_ARRAYLIST(root->data._switch.cases);
+        VISIT_PUSH_ARRAYLIST(root->data._switch.cases);
+        VISIT_PUSH(root->data._switch.switch_on);
         break;
         case AST_NODE_TERNARY:
-        TRAVERSE(root->data.ternary.condition);
-        TRAVERSE(root->data.ternary.if_true);
-        TRAVERSE(root->data.ternary.if_false);
+        VISIT_PUSH(root->data.ternary.if_false);
+        VISIT_PUSH(root->data.ternary.if_true);
+        VISIT_PUSH(root->data.ternary.condition);
         break;
         case AST_NODE_THROW:
-        TRAVERSE(root->data.throw.what);
+        VISIT_PUSH(root->data.throw.what);
         break;
         case AST_NODE_TRY:
-        TRAVERSE(root->data.try.expr);
-        TRAVERSE(root->data.try.catch_var_decl);
-        TRAVERSE(root->data.try.catch_expr);
-        TRAVERSE(root->data.try.finally_expr);
+        VISIT_PUSH(root->data.try.finally_expr);
+        VISIT_PUSH(root->data.try.catch_expr);
+        VISIT_PUSH(root->data.try.catch_var_decl);
+        VISIT_PUSH(root->data.try.expr);
         break;
         case AST_NODE_TYPE:
-        TRAVERSE_ARRAYLIST(root->data.type.generics);
-        TRAVERSE_ARRAYLIST(root->data.type.protofunc_arguments);
+        VISIT_PUSH_ARRAYLIST(root->data.type.protofunc_arguments);
+        VISIT_PUSH_ARRAYLIST(root->data.type.generics);
         break;
         case AST_NODE_UNARY:
-        TRAVERSE(root->data.unary.child);
+        VISIT_PUSH(root->data.unary.child);
         break;
         case AST_NODE_UNARY_POSTFIX:
-        TRAVERSE(root->data.unary_postfix.child);
+        VISIT_PUSH(root->data.unary_postfix.child);
         break;
         case AST_NODE_VAR_DECL:
-        TRAVERSE(root->data.vardecl.type);
-        TRAVERSE(root->data.vardecl.init);
-        TRAVERSE_ARRAYLIST(root->data.vardecl.cons_init);
+        VISIT_PUSH_ARRAYLIST(root->data.vardecl.cons_init);
+        VISIT_PUSH(root->data.vardecl.init);
+        VISIT_PUSH(root->data.vardecl.type);
         break;
         case AST_NODE_WHILE:
-        TRAVERSE(root->data._while.loop);
-        TRAVERSE(root->data._while.expr);
+        VISIT_PUSH(root->data._while.expr);
+        VISIT_PUSH(root->data._while.loop);
         break;
         case AST_NODE_IMPORT:
-        TRAVERSE(root->data.import.what);
+        VISIT_PUSH(root->data.import.what);
         break;
         case AST_NODE_IMP_NEW:
-        TRAVERSE_ARRAYLIST(root->data.imp_new.parameters);
+        VISIT_PUSH_ARRAYLIST(root->data.imp_new.parameters);
         break;
     }
-    if (!pre) root = traverser(root, arg);
-    return root;
 }
 
-struct ast_node* _free_ast_node(struct ast_node* node, void* arg) {
+int visit_node(struct ast_node* root, struct ast_visitor* visitor) {
+    if (root == NULL) return AST_VISIT_CONTINUE;
+    struct _visit_stack* stack = &_visit_stack_local;
+    if (stack->frames == NULL) {
+        stack->frames = stack->local;
+        stack->cap = sizeof(stack->local) / sizeof(struct _visit_frame);
+    }
+    size_t base = stack->count;
+    _visit_push(stack, root);
+    int status = AST_VISIT_CONTINUE;
+    while (stack->count > base) {
+        // callbacks may start walks of their own that move the frames, so they are looked up again every time
+        struct _visit_frame* frame = &stack->frames[stack->count - 1];
+        struct ast_node* node = frame->node;
+        if (frame->entered) {
+            stack->count--;
+            if (visitor->leave != NULL && visitor->leave(node, visitor->arg) == AST_VISIT_STOP) {
+                status = AST_VISIT_STOP;
+                break;
+            }
+            continue;
+        }
+        // without a leave there is nothing to come back for, the frame is done once entered
+        if (visitor->leave == NULL) stack->count--;
+        else frame->entered = 1;
+        int action = visitor->enter == NULL ? AST_VISIT_CONTINUE : visitor->enter(node, visitor->arg);
+        if (action == AST_VISIT_STOP) {
+            status = AST_VISIT_STOP;
+            break;
+        }
+        if (action != AST_VISIT_SKIP) _visit_push_children(stack, node);
+    }
+    stack->count = base;
+    if (base == 0 && stack->frames != stack->local) {
+        free(stack->frames);
+        stack->frames = stack->local;
+        stack->cap = sizeof(stack->local) / sizeof(struct _visit_frame);
+    }
+    return status;
+}
+
+int _free_ast_node(struct ast_node* node, void* arg) {
     switch (node->type) {
         case AST_NODE_BODY:
         arraylist_free(node->data.body.children);
@@ -227,12 +309,34 @@ struct ast_node* _free_ast_node(struct ast_node* node, void* arg) {
         arraylist_free(node->data.imp_new.parameters);
     }
     free(node);
-    return NULL;
+    return AST_VISIT_CONTINUE;
 }
 
 void free_ast_node(struct ast_node* node) {
-    if (node == NULL) return;
-    traverse_node(node, _free_ast_node, NULL, 0);
+    struct ast_visitor visitor = {NULL, _free_ast_node, NULL};
+    visit_node(node, &visitor);
+}
+
+int _count_ast_node(struct ast_node* node, void* arg) {
+    ((uint64_t*) arg)[node->type]++;
+    return AST_VISIT_CONTINUE;
+}
+
+void print_ast_stats(struct arraylist* files, int fd) {
+    uint64_t counts[AST_NODE_LAZY_BODY + 1] = {0};
+    uint64_t total = 0;
+    struct ast_visitor visitor = {_count_ast_node, NULL, counts};
+    for (size_t i = 0; i < files->entry_count; i++) {
+        visit_node(arraylist_getptr(files, i), &visitor);
+    }
+    for (int i = 0; i <= AST_NODE_LAZY_BODY; i++) {
+        total += counts[i];
+    }
+    dprintf(fd, "ast node size = %lu bytes\n", sizeof(struct ast_node));
+    dprintf(fd, "ast nodes = %lu, %lu bytes\n", total, total * sizeof(struct ast_node));
+    for (int i = 0; i <= AST_NODE_LAZY_BODY; i++) {
+        if (counts[i] > 0) dprintf(fd, "ast nodes %s = %lu\n", AST_TYPE_NAMES[i], counts[i]);
+    }
 }
 
 struct ast_node* parse_lambda_func(struct parse_ctx* ctx, struct token*** tokens, size_t* token_count, uint8_t prot, uint8_t synch, uint8_t virt, uint8_t async, uint8_t csig, uint8_t stat, uint8_t pure);
@@ -255,18 +359,20 @@ struct ast_node* parse_type(struct parse_ctx* ctx, struct token*** tokens, size_
     ALLOC_NODE(AST_NODE_TYPE);
     START_NODE(node);
     if (can_cons && EAT(TOKEN_CONST)) {
-        node->data.type.cons = 1;
+        node->flags.cons = 1;
     }
     if (EAT(TOKEN_PROTOFUNC)) {
-        node->data.type.protofunc = 1;
+        node->flags.protofunc = 1;
         if (!MATCH(TOKEN_LPAREN)) {
             node->data.type.protofunc_return_type = parse_type(ctx, tokens, token_count, 0, 1, 1, 1, 1);
+            CHECK_EXPR_AND(node->data.type.protofunc_return_type, free_ast_node(node));
         }
         EXPECT_TOKEN(TOKEN_LPAREN, "(");
         if (!EAT(TOKEN_RPAREN)) {
             node->data.type.protofunc_arguments = arraylist_new(4, sizeof(struct ast_node*));
             do {
                 struct ast_node* nt = parse_type(ctx, tokens, token_count, 0, 1, 1, 1, 1);
+                CHECK_EXPR_AND(nt, free_ast_node(node));
                 arraylist_addptr(node->data.type.protofunc_arguments, nt);
             } while (EAT(TOKEN_COMMA));
             EXPECT_TOKEN(TOKEN_RPAREN, ")");
@@ -289,20 +395,20 @@ struct ast_node* parse_type(struct parse_ctx* ctx, struct token*** tokens, size_
     }
     if (can_ptrarr) {
         while (MATCH(TOKEN_LBRACK)) {
-            if (node->data.type.array_dimensonality >= 64) {
+            if (node->flags.array_dimensonality >= 64) {
                 break;
             }
             if (EAT(TOKEN_LBRACK)) {
                 EXPECT_TOKEN(TOKEN_RBRACK, "]");
-                node->data.type.array_dimensonality++;
+                node->flags.array_dimensonality++;
             }
         }
-        if (node->data.type.array_dimensonality == 0 && node->data.type.generics == NULL) {
-            node->data.type.is_ref = EAT(TOKEN_AND) != NULL;
+        if (node->flags.array_dimensonality == 0 && node->data.type.generics == NULL) {
+            node->flags.is_ref = EAT(TOKEN_AND) != NULL;
         }
     }
     if (can_variadic && EAT(TOKEN_ELLIPSIS)) {
-        node->data.type.variadic = 1;
+        node->flags.variadic = 1;
     }
     END_NODE(node);
     return node;
@@ -559,6 +665,7 @@ struct ast_node* parse_primary_expression(struct parse_ctx* ctx, struct token***
         START_NODE(node);
         EAT(TOKEN_THROW);
         node->data.throw.what = parse_expression(ctx, tokens, token_count);
+        CHECK_EXPR_AND(node->data.throw.what, free_ast_node(node));
         END_NODE(node);
         return node;
         case TOKEN_GOTO:
@@ -593,9 +700,9 @@ struct ast_node* parse_primary_expression(struct parse_ctx* ctx, struct token***
         case TOKEN_ASYNC:
         case TOKEN_LT:
         case TOKEN_FUNC:;
-        uint8_t async = EAT(TOKEN_ASYNC);
-        uint8_t synch = EAT(TOKEN_SYNCH);
-        uint8_t pure = EAT(TOKEN_PURE);
+        uint8_t async = EAT(TOKEN_ASYNC) != NULL;
+        uint8_t synch = EAT(TOKEN_SYNCH) != NULL;
+        uint8_t pure = EAT(TOKEN_PURE) != NULL;
         if (MATCH(TOKEN_FUNC)) goto func;
         return parse_lambda_func(ctx, tokens, token_count, PROTECTION_PRIV, synch, 0, async, 0, 0, pure);
         func:;
@@ -615,6 +722,8 @@ struct ast_node* parse_primary_expression(struct parse_ctx* ctx, struct token***
         ALLOC_NODE_DUMMY(AST_NODE_INTEGER_LIT);
         START_NODE(node);
         char* int_str = EAT(TOKEN_NUMERIC_LIT)->value;
+        // a literal 0 is only an error if strtoull itself failed, not whatever call set errno last
+        errno = 0;
         if (str_startsWithCase(int_str, "0b")) {
             node->data.integer_lit.lit = strtoull(int_str + 2, NULL, 2);
         } else {
@@ -733,6 +842,7 @@ struct ast_node* parse_postfix_unary_expression(struct parse_ctx* ctx, struct to
             ctx->flags = 0;
             node->data.calc_member.calc = parse_expression(ctx, tokens, token_count);
             ctx->flags = flags;
+            CHECK_EXPR_AND(node->data.calc_member.calc, free_ast_node(node));
             EXPECT_TOKEN(TOKEN_RBRACK, "]");
             END_NODE(node);
             base = node;
@@ -1399,18 +1509,18 @@ struct ast_node* parse_vardecl(struct parse_ctx* ctx, struct token*** tokens, si
     INIT_PARSE_FUNC();
     ALLOC_NODE(AST_NODE_VAR_DECL);
     START_NODE(node);
-    node->data.vardecl.prot = prot;
-    node->data.vardecl.synch = synch;
-    node->data.vardecl.csig = csig;
-    node->data.vardecl.stat = stat;
-    node->data.vardecl.cons = cons;
+    node->flags.prot = prot;
+    node->flags.synch = synch;
+    node->flags.csig = csig;
+    node->flags.stat = stat;
+    node->flags.cons = cons;
     node->data.vardecl.type = parse_type(ctx, tokens, token_count, can_variadic, 1, 1, 1, 1);
-    node->data.vardecl.type->data.type.cons |= cons;
-    node->data.vardecl.cons |= node->data.vardecl.type->data.type.cons;
     CHECK_EXPR_AND(node->data.vardecl.type, free_ast_node(node));
+    node->data.vardecl.type->flags.cons |= cons;
+    node->flags.cons |= node->data.vardecl.type->flags.cons;
     EXPECT_TOKEN(TOKEN_IDENTIFIER, "identifier");
     node->data.vardecl.name = ttok->value;
-    if (!node->data.vardecl.type->data.type.variadic && can_init) {
+    if (!node->data.vardecl.type->flags.variadic && can_init) {
         if (EAT(TOKEN_EQUALS)) {
             node->data.vardecl.init = parse_assignment_expression(ctx, tokens, token_count);
             CHECK_EXPR_AND(node->data.vardecl.init, free_ast_node(node));
@@ -1437,18 +1547,104 @@ struct ast_node* parse_vardecl(struct parse_ctx* ctx, struct token*** tokens, si
     return node;
 }
 
+// whether parse_expression stops at this token after a braced body, so the body alone is the whole expression
+int _ends_lazy_body(uint8_t type) {
+    switch (type) {
+        case TOKEN_SEMICOLON:
+        case TOKEN_RCURLY:
+        case TOKEN_IDENTIFIER:
+        case TOKEN_PUB:
+        case TOKEN_PRIV:
+        case TOKEN_PROT:
+        case TOKEN_SYNCH:
+        case TOKEN_VIRT:
+        case TOKEN_IFACE:
+        case TOKEN_CSIG:
+        case TOKEN_ASYNC:
+        case TOKEN_STATIC:
+        case TOKEN_CONST:
+        case TOKEN_PURE:
+        case TOKEN_FUNC:
+        case TOKEN_CLASS:
+        case TOKEN_MODULE:
+        case TOKEN_IMPORT:
+        return 1;
+    }
+    return 0;
+}
+
+// a stub for a braced body, found by matching braces. NULL without consuming anything when the body is not braced,
+// not closed, or followed by something the expression could go on with, those are parsed right away.
+struct ast_node* parse_lazy_body(struct parse_ctx* ctx, struct token*** tokens, size_t* token_count) {
+    if (!MATCH(TOKEN_LCURLY)) return NULL;
+    size_t depth = 0;
+    size_t end = 0;
+    for (; end < *token_count; end++) {
+        uint8_t type = (*tokens)[end]->type;
+        if (type == TOKEN_LCURLY) {
+            depth++;
+        } else if (type == TOKEN_RCURLY && --depth == 0) {
+            break;
+        }
+    }
+    if (end == *token_count) return NULL;
+    end++;
+    if (end < *token_count && !_ends_lazy_body((*tokens)[end]->type)) return NULL;
+    ALLOC_NODE(AST_NODE_LAZY_BODY);
+    START_NODE(node);
+    node->data.lazy_body.tokens = *tokens;
+    node->data.lazy_body.token_count = end;
+    node->data.lazy_body.ctx = ctx;
+    *tokens += end;
+    *token_count -= end;
+    END_NODE(node);
+    // what parse_expression_maybe_semicolon would have eaten after the body
+    while (!(ctx->flags & 0x2) && EAT(TOKEN_SEMICOLON));
+    return node;
+}
+
+struct ast_node* ast_func_body(struct ast_node* func) {
+    struct ast_node* stub = func->data.func.body;
+    if (stub == NULL || stub->type != AST_NODE_LAZY_BODY) return stub;
+    struct parse_ctx* ctx = stub->data.lazy_body.ctx;
+    struct token** body_tokens = stub->data.lazy_body.tokens;
+    size_t body_token_count = stub->data.lazy_body.token_count;
+    uint8_t flags = ctx->flags;
+    uint8_t lazy_bodies = ctx->lazy_bodies;
+    // the body is a whole expression of its own, funcs nested in it are parsed along with it
+    ctx->flags = 0;
+    ctx->lazy_bodies = 0;
+    func->data.func.body = parse_expression_maybe_semicolon(ctx, &body_tokens, &body_token_count);
+    ctx->flags = flags;
+    ctx->lazy_bodies = lazy_bodies;
+    free(stub);
+    return func->data.func.body;
+}
+
+int _expand_body(struct ast_node* node, void* arg) {
+    (void) arg;
+    // the parsed body replaces the stub before children are pushed, so it is walked next
+    if (node->type == AST_NODE_FUNC) ast_func_body(node);
+    return AST_VISIT_CONTINUE;
+}
+
+void ast_expand_bodies(struct ast_node* root) {
+    struct ast_visitor visitor = {_expand_body, NULL, NULL};
+    visit_node(root, &visitor);
+}
+
 struct ast_node* parse_func(struct parse_ctx* ctx, struct token*** tokens, size_t* token_count, uint8_t prot, uint8_t synch, uint8_t virt, uint8_t async, uint8_t csig, uint8_t stat, uint8_t pure) {
     INIT_PARSE_FUNC()
     ALLOC_NODE(AST_NODE_FUNC);
     START_NODE(node);
     EXPECT_TOKEN(TOKEN_FUNC, "func");
-    node->data.func.prot = prot;
-    node->data.func.synch = synch;
-    node->data.func.virt = virt;
-    node->data.func.async = async;
-    node->data.func.csig = csig;
-    node->data.func.stat = stat;
-    node->data.func.pure = pure;
+    node->flags.prot = prot;
+    node->flags.synch = synch;
+    node->flags.virt = virt;
+    node->flags.async = async;
+    node->flags.csig = csig;
+    node->flags.stat = stat;
+    node->flags.pure = pure;
     node->data.func.return_type = parse_type(ctx, tokens, token_count, 0, 1, 1, 1, 1);
     CHECK_EXPR_AND(node->data.func.return_type, free_ast_node(node));
     struct token* name_token = EAT(TOKEN_IDENTIFIER);
@@ -1469,7 +1665,8 @@ struct ast_node* parse_func(struct parse_ctx* ctx, struct token*** tokens, size_
         ctx->flags = flags = flags;
         EXPECT_TOKEN(TOKEN_RPAREN, ")");
     }
-    node->data.func.body = parse_expression_maybe_semicolon(ctx, tokens, token_count);
+    node->data.func.body = ctx->lazy_bodies ? parse_lazy_body(ctx, tokens, token_count) : NULL;
+    if (node->data.func.body == NULL) node->data.func.body = parse_expression_maybe_semicolon(ctx, tokens, token_count);
     CHECK_EXPR_AND(node->data.func.body, free_ast_node(node));
     END_NODE(node);
     return node;
@@ -1479,13 +1676,13 @@ struct ast_node* parse_lambda_func(struct parse_ctx* ctx, struct token*** tokens
     INIT_PARSE_FUNC()
     ALLOC_NODE(AST_NODE_FUNC);
     START_NODE(node);
-    node->data.func.prot = prot;
-    node->data.func.synch = synch;
-    node->data.func.virt = virt;
-    node->data.func.async = async;
-    node->data.func.csig = csig;
-    node->data.func.stat = stat;
-    node->data.func.pure = pure;
+    node->flags.prot = prot;
+    node->flags.synch = synch;
+    node->flags.virt = virt;
+    node->flags.async = async;
+    node->flags.csig = csig;
+    node->flags.stat = stat;
+    node->flags.pure = pure;
     EXPECT_TOKEN(TOKEN_LT, "<");
     if (!EAT(TOKEN_GT)) {
         node->data.func.arguments = arraylist_new(4, sizeof(struct ast_node*));
@@ -1504,7 +1701,8 @@ struct ast_node* parse_lambda_func(struct parse_ctx* ctx, struct token*** tokens
         CHECK_EXPR_AND(node->data.func.return_type, free_ast_node(node));
     }
     EXPECT_TOKEN(TOKEN_ARROW, "=>");
-    node->data.func.body = parse_expression_maybe_semicolon(ctx, tokens, token_count);
+    node->data.func.body = ctx->lazy_bodies ? parse_lazy_body(ctx, tokens, token_count) : NULL;
+    if (node->data.func.body == NULL) node->data.func.body = parse_expression_maybe_semicolon(ctx, tokens, token_count);
     CHECK_EXPR_AND(node->data.func.body, free_ast_node(node));
     END_NODE(node);
     return node;
@@ -1514,11 +1712,11 @@ struct ast_node* parse_class(struct parse_ctx* ctx, struct token*** tokens, size
     INIT_PARSE_FUNC();
     ALLOC_NODE(AST_NODE_CLASS);
     START_NODE(node);
-    node->data.class.prot = prot;
-    node->data.class.synch = synch;
-    node->data.class.virt = virt;
-    node->data.class.iface = iface;
-    node->data.class.pure = pure;
+    node->flags.prot = prot;
+    node->flags.synch = synch;
+    node->flags.virt = virt;
+    node->flags.iface = iface;
+    node->flags.pure = pure;
     EXPECT_TOKEN(TOKEN_CLASS, "class");
     node->data.class.name = parse_type(ctx, tokens, token_count, 0, 0, 1, 1, 0);
     CHECK_EXPR_AND(node->data.class.name, free_ast_node(node));
@@ -1530,20 +1728,20 @@ struct ast_node* parse_class(struct parse_ctx* ctx, struct token*** tokens, size
             arraylist_addptr(node->data.class.parents, type);
         } while (EAT(TOKEN_COMMA));
     }
-    node->data.class.body = scalloc(sizeof(struct ast_node));
+    node->data.class.body = scallocTag(sizeof(struct ast_node), SMEM_TAG_AST_NODE);
     node->data.class.body->type = AST_NODE_BODY;
     node->data.class.body->data.body.children = arraylist_new(8, sizeof(struct ast_node*));
     START_NODE(node->data.class.body);
     EXPECT_TOKEN(TOKEN_LCURLY, "{");
     while (1) {
         uint8_t prot = maybe_protection(tokens, token_count);
-        uint8_t synch = EAT(TOKEN_SYNCH);
-        uint8_t virt = EAT(TOKEN_VIRT);
-        uint8_t async = EAT(TOKEN_ASYNC);
-        uint8_t csig = EAT(TOKEN_CSIG);
-        uint8_t stat = EAT(TOKEN_STATIC);
-        uint8_t cons = EAT(TOKEN_CONST);
-        uint8_t pure = EAT(TOKEN_PURE);
+        uint8_t synch = EAT(TOKEN_SYNCH) != NULL;
+        uint8_t virt = EAT(TOKEN_VIRT) != NULL;
+        uint8_t async = EAT(TOKEN_ASYNC) != NULL;
+        uint8_t csig = EAT(TOKEN_CSIG) != NULL;
+        uint8_t stat = EAT(TOKEN_STATIC) != NULL;
+        uint8_t cons = EAT(TOKEN_CONST) != NULL;
+        uint8_t pure = EAT(TOKEN_PURE) != NULL;
         uint8_t can_var = !virt && !async && !pure;
         struct ast_node* child_node = NULL;
         if (!cons && MATCH(TOKEN_FUNC)) {
@@ -1594,8 +1792,8 @@ struct ast_node* parse_module(struct parse_ctx* ctx, struct token*** tokens, siz
     INIT_PARSE_FUNC();
     ALLOC_NODE(AST_NODE_MODULE);
     START_NODE(node);
-    node->data.module.prot = prot;
-    node->data.module.body = scalloc(sizeof(struct ast_node));
+    node->flags.prot = prot;
+    node->data.module.body = scallocTag(sizeof(struct ast_node), SMEM_TAG_AST_NODE);
     node->data.module.body->type = AST_NODE_BODY;
     node->data.module.body->data.body.children = arraylist_new(4, sizeof(struct ast_node*));
     EXPECT_TOKEN(TOKEN_MODULE, "module");
@@ -1608,13 +1806,13 @@ struct ast_node* parse_module(struct parse_ctx* ctx, struct token*** tokens, siz
     EXPECT_TOKEN(TOKEN_LCURLY, "{");
     while (1) {
         uint8_t prot = maybe_protection(tokens, token_count);
-        uint8_t synch = EAT(TOKEN_SYNCH);
-        uint8_t virt = EAT(TOKEN_VIRT);
-        uint8_t iface = EAT(TOKEN_IFACE);
-        uint8_t async = EAT(TOKEN_ASYNC);
-        uint8_t csig = EAT(TOKEN_CSIG);
-        uint8_t cons = EAT(TOKEN_CONST);
-        uint8_t pure = EAT(TOKEN_PURE);
+        uint8_t synch = EAT(TOKEN_SYNCH) != NULL;
+        uint8_t virt = EAT(TOKEN_VIRT) != NULL;
+        uint8_t iface = EAT(TOKEN_IFACE) != NULL;
+        uint8_t async = EAT(TOKEN_ASYNC) != NULL;
+        uint8_t csig = EAT(TOKEN_CSIG) != NULL;
+        uint8_t cons = EAT(TOKEN_CONST) != NULL;
+        uint8_t pure = EAT(TOKEN_PURE) != NULL;
         uint8_t can_module = !synch && !virt && !iface && !async && !csig && !pure && !cons;
         uint8_t can_class = !async && !csig && !cons;
         uint8_t can_func = !iface && !cons;
@@ -1678,7 +1876,7 @@ struct ast_node* parse_file(struct parse_ctx* ctx, struct token*** tokens, size_
     }
     ALLOC_NODE(AST_NODE_FILE);
     START_NODE(node);
-    node->data.file.body = scalloc(sizeof(struct ast_node));
+    node->data.file.body = scallocTag(sizeof(struct ast_node), SMEM_TAG_AST_NODE);
     node->data.file.body->type = AST_NODE_BODY;
     node->data.file.lines = lines;
     START_NODE(node->data.file.body);
@@ -1704,13 +1902,18 @@ struct ast_node* parse_file(struct parse_ctx* ctx, struct token*** tokens, size_
     return node;
 }
 
-struct parse_intermediates parse(struct arraylist* tokens_list, struct arraylist* lines) {
+struct parse_intermediates parse(struct arraylist* tokens_list, struct arraylist* lines, uint8_t lazy_bodies) {
     struct token** tokens = NULL;
-    struct token** otokens = tokens;
     size_t token_count = arraylist_arrayify(tokens_list, &tokens);
+    struct token** otokens = tokens;
     struct parse_ctx* ctx = scalloc(sizeof(struct parse_ctx));
     ctx->parse_errors = arraylist_new(16, sizeof(struct parse_error*));
+    ctx->lazy_bodies = lazy_bodies;
     struct parse_intermediates immed = (struct parse_intermediates) {ctx, parse_file(ctx, &tokens, &token_count, lines)};
-    if (otokens != NULL) free(otokens);
+    if (lazy_bodies) {
+        ctx->tokens = otokens;
+    } else if (otokens != NULL) {
+        free(otokens);
+    }
     return immed;
 }
\ No newline at end of file
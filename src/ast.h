@@ -5,9 +5,9 @@
 #include "arraylist.h"
 #include "prog_ir.h"
 
-const char* AST_TYPE_NAMES[];
-const char* UNARY_OP_NAMES[];
-const char* BINARY_OP_NAMES[];
+extern const char* AST_TYPE_NAMES[];
+extern const char* UNARY_OP_NAMES[];
+extern const char* BINARY_OP_NAMES[];
 
 enum ast_type {
     AST_NODE_BODY,
@@ -47,7 +47,8 @@ enum ast_type {
     AST_NODE_EMPTY,
     AST_NODE_IMPORT,
     AST_NODE_IMP_NEW,
-    AST_NODE_NULL
+    AST_NODE_NULL,
+    AST_NODE_LAZY_BODY // a func body a lazy parse left unparsed, see ast_func_body
 };
 
 enum unary_ops {
@@ -120,7 +121,7 @@ enum binary_ops {
 #define PROTECTION_PROT 2
 #define PROTECTION_PUB 3
 
-const char* PROT_STRING[];
+extern const char* PROT_STRING[];
 
 enum parse_error_type {
     PARSE_ERROR_TYPE_UNEXPECTED_TOKEN
@@ -140,30 +141,17 @@ struct ast_node_file {
 };
 
 struct ast_node_module {
-    uint8_t prot;
     struct arraylist* name_list;
     struct ast_node* body;
 };
 
 struct ast_node_class {
-    uint8_t prot;
-    uint8_t synch;
-    uint8_t virt;
-    uint8_t iface;
-    uint8_t pure;
     struct ast_node* name;
     struct arraylist* parents;
     struct ast_node* body;
 };
 
 struct ast_node_func {
-    uint8_t prot;
-    uint8_t synch;
-    uint8_t virt;
-    uint8_t async;
-    uint8_t csig;
-    uint8_t stat;
-    uint8_t pure;
     struct ast_node* return_type;
     char* name;
     struct arraylist* arguments;
@@ -202,11 +190,6 @@ struct ast_node_binary {
 };
 
 struct ast_node_vardecl {
-    uint8_t prot;
-    uint8_t synch;
-    uint8_t csig;
-    uint8_t stat;
-    uint8_t cons;
     struct ast_node* type;
     char* name;
     struct ast_node* init;
@@ -215,11 +198,6 @@ struct ast_node_vardecl {
 
 struct ast_node_type {
     char* name;
-    uint8_t variadic;
-    uint8_t protofunc;
-    uint8_t array_dimensonality;
-    uint8_t is_ref;
-    uint8_t cons;
     struct arraylist* generics;
     struct ast_node* protofunc_return_type;
     struct arraylist* protofunc_arguments;
@@ -333,13 +311,39 @@ struct ast_node_imp_new {
     struct arraylist* parameters;
 };
 
+struct ast_node_lazy_body {
+    struct token** tokens; // from the opening to the closing brace, in the token array kept by ctx
+    size_t token_count;
+    struct parse_ctx* ctx;
+};
+
+// modifiers of module, class, func, vardecl and type nodes. they sit in the node header where there would be padding,
+// so no variant in the union is larger than four pointers.
+struct ast_node_flags {
+    uint32_t prot : 2;
+    uint32_t synch : 1;
+    uint32_t virt : 1;
+    uint32_t iface : 1;
+    uint32_t async : 1;
+    uint32_t csig : 1;
+    uint32_t stat : 1;
+    uint32_t pure : 1;
+    uint32_t cons : 1;
+    uint32_t variadic : 1;
+    uint32_t protofunc : 1;
+    uint32_t is_ref : 1;
+    uint32_t array_dimensonality : 7; // the parser stops at 64
+};
+
+// 72 bytes on 64 bit targets. spans are 32 bit, files past 4G lines or columns are not supported.
 struct ast_node {
     uint8_t type;
     uint8_t scope_override;
-    uint64_t start_line;
-    uint64_t end_line;
-    uint64_t start_col;
-    uint64_t end_col;
+    struct ast_node_flags flags;
+    uint32_t start_line;
+    uint32_t end_line;
+    uint32_t start_col;
+    uint32_t end_col;
     struct prog_node* prog;
     struct prog_type* output_type;
     union {
@@ -379,6 +383,7 @@ struct ast_node {
         struct ast_node_new new;
         struct ast_node_import import;
         struct ast_node_imp_new imp_new;
+        struct ast_node_lazy_body lazy_body;
     } data;
 };
 
@@ -392,6 +397,8 @@ struct parse_error {
 struct parse_ctx {
     struct arraylist* parse_errors;
     uint8_t flags; // 0x1 == sequence_disabled, 0x2 = semi_disabled, 0x4 = colon_disabled
+    uint8_t lazy_bodies; // braced func bodies become AST_NODE_LAZY_BODY stubs
+    struct token** tokens; // of the whole file, kept for the stubs with lazy_bodies
 };
 
 struct parse_intermediates {
@@ -399,10 +406,35 @@ struct parse_intermediates {
     struct ast_node* root;
 };
 
-struct parse_intermediates parse(struct arraylist* tokens_list, struct arraylist* lines);
+// with lazy_bodies, braced func bodies are only matched up to their closing brace and parsed by ast_func_body. the
+// tokens must then outlive the tree.
+struct parse_intermediates parse(struct arraylist* tokens_list, struct arraylist* lines, uint8_t lazy_bodies);
+
+// the body of a func node, parsed first if it is still a lazy stub. errors go to the parse_ctx of the file and leave
+// the body NULL. stubs of one file share that parse_ctx, so they must not be parsed concurrently.
+struct ast_node* ast_func_body(struct ast_node* func);
+
+// parses every stub still left under root, so the tree is the one an eager parse gives
+void ast_expand_bodies(struct ast_node* root);
 
 void free_ast_node(struct ast_node* node);
 
-struct ast_node* traverse_node(struct ast_node* root, struct ast_node* (traverser)(struct ast_node*, void*), void* arg, int pre);
+// node count by type and the bytes of the nodes themselves, lists and strings are left out
+void print_ast_stats(struct arraylist* files, int fd);
+
+#define AST_VISIT_CONTINUE 0
+#define AST_VISIT_SKIP 1 // from enter, the children of the node are not visited, its leave still is
+#define AST_VISIT_STOP 2 // nothing more is visited, visit_node returns it
+
+// either callback may be NULL. nodes are visited in source order, children after enter and before leave.
+struct ast_visitor {
+    int (*enter)(struct ast_node* node, void* arg);
+    int (*leave)(struct ast_node* node, void* arg);
+    void* arg;
+};
+
+// walks root with an explicit stack, so the depth of the tree is not limited by the C stack. children are read after
+// enter returns, so enter may change them. leave may free the node.
+int visit_node(struct ast_node* root, struct ast_visitor* visitor);
 
 #endif
\ No newline at end of file
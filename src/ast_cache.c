@@ -0,0 +1,588 @@
+#include "ast_cache.h"
+#include "info.h"
+#include "hash.h"
+#include "smem.h"
+#include "xstring.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// entry layout, native endianness since the cache is local to a host:
+// magic, version string, u64 content hash, u64 content length, u64 line count, u64 offset of each line,
+// then the file node in preorder. a node is u8 present, then u8 type, u8 scope_override, u32 of its ast_node_flags
+// bits, u32 spans and the fields of its variant in declaration order. strings are u32 length and the bytes with their terminator, lists are u32 count and the items.
+// a NULL string or list has a length of AST_CACHE_NULL.
+#define AST_CACHE_MAGIC "FLEXAST2"
+#define AST_CACHE_NULL 0xFFFFFFFFU
+
+struct ast_cache_stats ast_cache_stats;
+
+char* _ast_cache_path(char* dir, uint64_t content_hash) {
+    // a new compiler version may parse the same content differently
+    uint64_t key = fnv1a_64(FLEXC_VERSION, strlen(FLEXC_VERSION), FNV1A_64_INIT);
+    key = fnv1a_64(&content_hash, sizeof(uint64_t), key);
+    char* path = NULL;
+    size_t path_len = 0;
+    FILE* out = open_memstream(&path, &path_len);
+    fprintf(out, "%s/%016lx.ast", dir, key);
+    fclose(out);
+    return path;
+}
+
+void _put_u8(FILE* out, uint8_t value) {
+    fwrite(&value, sizeof(uint8_t), 1, out);
+}
+
+void _put_u16(FILE* out, uint16_t value) {
+    fwrite(&value, sizeof(uint16_t), 1, out);
+}
+
+void _put_u32(FILE* out, uint32_t value) {
+    fwrite(&value, sizeof(uint32_t), 1, out);
+}
+
+void _put_u64(FILE* out, uint64_t value) {
+    fwrite(&value, sizeof(uint64_t), 1, out);
+}
+
+void _put_str(FILE* out, char* str) {
+    if (str == NULL) {
+        _put_u32(out, AST_CACHE_NULL);
+        return;
+    }
+    uint32_t len = strlen(str);
+    _put_u32(out, len);
+    fwrite(str, 1, len + 1, out);
+}
+
+void _put_node(FILE* out, struct ast_node* node);
+
+void _put_list(FILE* out, struct arraylist* list) {
+    if (list == NULL) {
+        _put_u32(out, AST_CACHE_NULL);
+        return;
+    }
+    _put_u32(out, list->entry_count);
+    for (size_t i = 0; i < list->entry_count; i++) {
+        _put_node(out, arraylist_getptr(list, i));
+    }
+}
+
+void _put_str_list(FILE* out, struct arraylist* list) {
+    if (list == NULL) {
+        _put_u32(out, AST_CACHE_NULL);
+        return;
+    }
+    _put_u32(out, list->entry_count);
+    for (size_t i = 0; i < list->entry_count; i++) {
+        _put_str(out, arraylist_getptr(list, i));
+    }
+}
+
+void _put_node(FILE* out, struct ast_node* node) {
+    _put_u8(out, node != NULL);
+    if (node == NULL) return;
+    _put_u8(out, node->type);
+    _put_u8(out, node->scope_override);
+    uint32_t flags;
+    memcpy(&flags, &node->flags, sizeof(uint32_t));
+    _put_u32(out, flags);
+    _put_u32(out, node->start_line);
+    _put_u32(out, node->end_line);
+    _put_u32(out, node->start_col);
+    _put_u32(out, node->end_col);
+    switch (node->type) {
+        case AST_NODE_BODY:
+        _put_list(out, node->data.body.children);
+        break;
+        case AST_NODE_FILE:
+        _put_node(out, node->data.file.body);
+        break;
+        case AST_NODE_MODULE:
+        _put_str_list(out, node->data.module.name_list);
+        _put_node(out, node->data.module.body);
+        break;
+        case AST_NODE_CLASS:
+        _put_node(out, node->data.class.name);
+        _put_list(out, node->data.class.parents);
+        _put_node(out, node->data.class.body);
+        break;
+        case AST_NODE_FUNC:
+        _put_node(out, node->data.func.return_type);
+        _put_str(out, node->data.func.name);
+        _put_list(out, node->data.func.arguments);
+        _put_node(out, node->data.func.body);
+        break;
+        case AST_NODE_UNARY_POSTFIX:
+        _put_u8(out, node->data.unary_postfix.unary_op);
+        _put_node(out, node->data.unary_postfix.child);
+        break;
+        case AST_NODE_UNARY:
+        _put_u8(out, node->data.unary.unary_op);
+        _put_node(out, node->data.unary.child);
+        break;
+        case AST_NODE_CALL:
+        _put_node(out, node->data.call.func);
+        _put_list(out, node->data.call.parameters);
+        break;
+        case AST_NODE_CALC_MEMBER:
+        _put_node(out, node->data.calc_member.parent);
+        _put_node(out, node->data.calc_member.calc);
+        break;
+        case AST_NODE_CAST:
+        _put_node(out, node->data.cast.type);
+        _put_node(out, node->data.cast.expr);
+        break;
+        case AST_NODE_BINARY:
+        _put_node(out, node->data.binary.left);
+        _put_u16(out, node->data.binary.op);
+        _put_node(out, node->data.binary.right);
+        break;
+        case AST_NODE_VAR_DECL:
+        _put_node(out, node->data.vardecl.type);
+        _put_str(out, node->data.vardecl.name);
+        _put_node(out, node->data.vardecl.init);
+        _put_list(out, node->data.vardecl.cons_init);
+        break;
+        case AST_NODE_TYPE:
+        _put_str(out, node->data.type.name);
+        _put_list(out, node->data.type.generics);
+        _put_node(out, node->data.type.protofunc_return_type);
+        _put_list(out, node->data.type.protofunc_arguments);
+        break;
+        case AST_NODE_INTEGER_LIT:
+        _put_u64(out, node->data.integer_lit.lit);
+        break;
+        case AST_NODE_DECIMAL_LIT:
+        fwrite(&node->data.decimal_lit.lit, sizeof(double), 1, out);
+        break;
+        case AST_NODE_STRING_LIT:
+        _put_str(out, node->data.string_lit.lit);
+        break;
+        case AST_NODE_CHAR_LIT:
+        _put_str(out, node->data.char_lit.lit);
+        break;
+        case AST_NODE_IDENTIFIER:
+        _put_str(out, node->data.identifier.identifier);
+        break;
+        case AST_NODE_TERNARY:
+        _put_node(out, node->data.ternary.condition);
+        _put_node(out, node->data.ternary.if_true);
+        _put_node(out, node->data.ternary.if_false);
+        break;
+        case AST_NODE_IF:
+        _put_node(out, node->data._if.condition);
+        _put_node(out, node->data._if.expr);
+        _put_node(out, node->data._if.elseExpr);
+        break;
+        case AST_NODE_FOR:
+        _put_node(out, node->data._for.init);
+        _put_node(out, node->data._for.loop);
+        _put_node(out, node->data._for.final);
+        _put_node(out, node->data._for.expr);
+        break;
+        case AST_NODE_WHILE:
+        _put_node(out, node->data._while.loop);
+        _put_node(out, node->data._while.expr);
+        break;
+        case AST_NODE_FOR_EACH:
+        _put_node(out, node->data.for_each.init);
+        _put_node(out, node->data.for_each.loop);
+        _put_node(out, node->data.for_each.expr);
+        break;
+        case AST_NODE_SWITCH:
+        _put_node(out, node->data._switch.switch_on);
+        _put_list(out, node->data._switch.cases);
+        break;
+        case AST_NODE_CASE:
+        _put_node(out, node->data._case.value);
+        _put_node(out, node->data._case.expr);
+        break;
+        case AST_NODE_DEFAULT_CASE:
+        _put_node(out, node->data.default_case.expr);
+        break;
+        case AST_NODE_GOTO:
+        _put_node(out, node->data._goto.expr);
+        break;
+        case AST_NODE_RET:
+        _put_node(out, node->data.ret.expr);
+        break;
+        case AST_NODE_TRY:
+        _put_node(out, node->data.try.expr);
+        _put_node(out, node->data.try.catch_var_decl);
+        _put_node(out, node->data.try.catch_expr);
+        _put_node(out, node->data.try.finally_expr);
+        break;
+        case AST_NODE_THROW:
+        _put_node(out, node->data.throw.what);
+        break;
+        case AST_NODE_NEW:
+        _put_node(out, node->data.new.type);
+        break;
+        case AST_NODE_LABEL:
+        _put_str(out, node->data.label.name);
+        break;
+        case AST_NODE_IMPORT:
+        _put_node(out, node->data.import.what);
+        break;
+        case AST_NODE_IMP_NEW:
+        _put_list(out, node->data.imp_new.parameters);
+        break;
+    }
+}
+
+int ast_cache_store(char* dir, uint64_t content_hash, char* content, size_t content_len, struct arraylist* lines, struct ast_node* root) {
+    if (mkdir(dir, 0775) != 0 && errno != EEXIST) return -1;
+    char* path = _ast_cache_path(dir, content_hash);
+    char* tmp_path = NULL;
+    size_t tmp_len = 0;
+    FILE* tmp = open_memstream(&tmp_path, &tmp_len);
+    // concurrent builds sharing a cache each write their own file, the last rename wins
+    fprintf(tmp, "%s.%d.tmp", path, getpid());
+    fclose(tmp);
+    FILE* out = fopen(tmp_path, "w");
+    if (out == NULL) {
+        free(tmp_path);
+        free(path);
+        return -1;
+    }
+    fwrite(AST_CACHE_MAGIC, 1, strlen(AST_CACHE_MAGIC), out);
+    _put_str(out, FLEXC_VERSION);
+    _put_u64(out, content_hash);
+    _put_u64(out, content_len);
+    _put_u64(out, lines->entry_count);
+    for (size_t i = 0; i < lines->entry_count; i++) {
+        _put_u64(out, (char*) arraylist_getptr(lines, i) - content);
+    }
+    _put_node(out, root);
+    int failed = fclose(out) != 0 || rename(tmp_path, path) != 0;
+    if (failed) {
+        unlink(tmp_path);
+    } else {
+        ast_cache_stats.stores++;
+    }
+    free(tmp_path);
+    free(path);
+    return failed ? -1 : 0;
+}
+
+struct _ast_reader {
+    uint8_t* data;
+    size_t len;
+    size_t pos;
+    uint8_t failed;
+};
+
+// bounds checked, a short read marks the reader failed and returns NULL
+void* _get_bytes(struct _ast_reader* reader, size_t len) {
+    if (reader->failed || len > reader->len - reader->pos) {
+        reader->failed = 1;
+        return NULL;
+    }
+    void* bytes = reader->data + reader->pos;
+    reader->pos += len;
+    return bytes;
+}
+
+uint8_t _get_u8(struct _ast_reader* reader) {
+    uint8_t* bytes = _get_bytes(reader, sizeof(uint8_t));
+    return bytes == NULL ? 0 : *bytes;
+}
+
+uint16_t _get_u16(struct _ast_reader* reader) {
+    uint16_t value = 0;
+    void* bytes = _get_bytes(reader, sizeof(uint16_t));
+    if (bytes != NULL) memcpy(&value, bytes, sizeof(uint16_t));
+    return value;
+}
+
+uint32_t _get_u32(struct _ast_reader* reader) {
+    uint32_t value = 0;
+    void* bytes = _get_bytes(reader, sizeof(uint32_t));
+    if (bytes != NULL) memcpy(&value, bytes, sizeof(uint32_t));
+    return value;
+}
+
+uint64_t _get_u64(struct _ast_reader* reader) {
+    uint64_t value = 0;
+    void* bytes = _get_bytes(reader, sizeof(uint64_t));
+    if (bytes != NULL) memcpy(&value, bytes, sizeof(uint64_t));
+    return value;
+}
+
+// strings are used in place, the mapping is private so a pass writing to one does not reach the file
+char* _get_str(struct _ast_reader* reader) {
+    uint32_t len = _get_u32(reader);
+    if (len == AST_CACHE_NULL) return NULL;
+    char* str = _get_bytes(reader, (size_t) len + 1);
+    if (str != NULL && str[len] != 0) {
+        reader->failed = 1;
+        return NULL;
+    }
+    return str;
+}
+
+struct ast_node* _get_node(struct _ast_reader* reader);
+
+// children are attached as they are read, so a failed read still leaves a tree free_ast_node can release
+struct arraylist* _get_list(struct _ast_reader* reader) {
+    uint32_t count = _get_u32(reader);
+    if (reader->failed || count == AST_CACHE_NULL) return NULL;
+    // every node takes more than a byte, a count beyond that is corrupt and must not size an allocation
+    if (count > reader->len - reader->pos) {
+        reader->failed = 1;
+        return NULL;
+    }
+    struct arraylist* list = arraylist_new(count < 4 ? 4 : count, sizeof(struct ast_node*));
+    for (uint32_t i = 0; i < count && !reader->failed; i++) {
+        arraylist_addptr(list, _get_node(reader));
+    }
+    return list;
+}
+
+struct arraylist* _get_str_list(struct _ast_reader* reader) {
+    uint32_t count = _get_u32(reader);
+    if (reader->failed || count == AST_CACHE_NULL) return NULL;
+    if (count > reader->len - reader->pos) {
+        reader->failed = 1;
+        return NULL;
+    }
+    struct arraylist* list = arraylist_new(count < 4 ? 4 : count, sizeof(char*));
+    for (uint32_t i = 0; i < count && !reader->failed; i++) {
+        arraylist_addptr(list, _get_str(reader));
+    }
+    return list;
+}
+
+struct ast_node* _get_node(struct _ast_reader* reader) {
+    if (!_get_u8(reader)) return NULL;
+    uint8_t type = _get_u8(reader);
+    if (reader->failed || type > AST_NODE_NULL) {
+        reader->failed = 1;
+        return NULL;
+    }
+    struct ast_node* node = scallocTag(sizeof(struct ast_node), SMEM_TAG_AST_NODE);
+    node->type = type;
+    node->scope_override = _get_u8(reader);
+    uint32_t flags = _get_u32(reader);
+    memcpy(&node->flags, &flags, sizeof(uint32_t));
+    node->start_line = _get_u32(reader);
+    node->end_line = _get_u32(reader);
+    node->start_col = _get_u32(reader);
+    node->end_col = _get_u32(reader);
+    switch (node->type) {
+        case AST_NODE_BODY:
+        node->data.body.children = _get_list(reader);
+        break;
+        case AST_NODE_FILE:
+        node->data.file.body = _get_node(reader);
+        break;
+        case AST_NODE_MODULE:
+        node->data.module.name_list = _get_str_list(reader);
+        node->data.module.body = _get_node(reader);
+        break;
+        case AST_NODE_CLASS:
+        node->data.class.name = _get_node(reader);
+        node->data.class.parents = _get_list(reader);
+        node->data.class.body = _get_node(reader);
+        break;
+        case AST_NODE_FUNC:
+        node->data.func.return_type = _get_node(reader);
+        node->data.func.name = _get_str(reader);
+        node->data.func.arguments = _get_list(reader);
+        node->data.func.body = _get_node(reader);
+        break;
+        case AST_NODE_UNARY_POSTFIX:
+        node->data.unary_postfix.unary_op = _get_u8(reader);
+        node->data.unary_postfix.child = _get_node(reader);
+        break;
+        case AST_NODE_UNARY:
+        node->data.unary.unary_op = _get_u8(reader);
+        node->data.unary.child = _get_node(reader);
+        break;
+        case AST_NODE_CALL:
+        node->data.call.func = _get_node(reader);
+        node->data.call.parameters = _get_list(reader);
+        break;
+        case AST_NODE_CALC_MEMBER:
+        node->data.calc_member.parent = _get_node(reader);
+        node->data.calc_member.calc = _get_node(reader);
+        break;
+        case AST_NODE_CAST:
+        node->data.cast.type = _get_node(reader);
+        node->data.cast.expr = _get_node(reader);
+        break;
+        case AST_NODE_BINARY:
+        node->data.binary.left = _get_node(reader);
+        node->data.binary.op = _get_u16(reader);
+        node->data.binary.right = _get_node(reader);
+        break;
+        case AST_NODE_VAR_DECL:
+        node->data.vardecl.type = _get_node(reader);
+        node->data.vardecl.name = _get_str(reader);
+        node->data.vardecl.init = _get_node(reader);
+        node->data.vardecl.cons_init = _get_list(reader);
+        break;
+        case AST_NODE_TYPE:
+        node->data.type.name = _get_str(reader);
+        node->data.type.generics = _get_list(reader);
+        node->data.type.protofunc_return_type = _get_node(reader);
+        node->data.type.protofunc_arguments = _get_list(reader);
+        break;
+        case AST_NODE_INTEGER_LIT:
+        node->data.integer_lit.lit = _get_u64(reader);
+        break;
+        case AST_NODE_DECIMAL_LIT:;
+        void* lit = _get_bytes(reader, sizeof(double));
+        if (lit != NULL) memcpy(&node->data.decimal_lit.lit, lit, sizeof(double));
+        break;
+        case AST_NODE_STRING_LIT:
+        node->data.string_lit.lit = _get_str(reader);
+        break;
+        case AST_NODE_CHAR_LIT:
+        node->data.char_lit.lit = _get_str(reader);
+        break;
+        case AST_NODE_IDENTIFIER:
+        node->data.identifier.identifier = _get_str(reader);
+        break;
+        case AST_NODE_TERNARY:
+        node->data.ternary.condition = _get_node(reader);
+        node->data.ternary.if_true = _get_node(reader);
+        node->data.ternary.if_false = _get_node(reader);
+        break;
+        case AST_NODE_IF:
+        node->data._if.condition = _get_node(reader);
+        node->data._if.expr = _get_node(reader);
+        node->data._if.elseExpr = _get_node(reader);
+        break;
+        case AST_NODE_FOR:
+        node->data._for.init = _get_node(reader);
+        node->data._for.loop = _get_node(reader);
+        node->data._for.final = _get_node(reader);
+        node->data._for.expr = _get_node(reader);
+        break;
+        case AST_NODE_WHILE:
+        node->data._while.loop = _get_node(reader);
+        node->data._while.expr = _get_node(reader);
+        break;
+        case AST_NODE_FOR_EACH:
+        node->data.for_each.init = _get_node(reader);
+        node->data.for_each.loop = _get_node(reader);
+        node->data.for_each.expr = _get_node(reader);
+        break;
+        case AST_NODE_SWITCH:
+        node->data._switch.switch_on = _get_node(reader);
+        node->data._switch.cases = _get_list(reader);
+        break;
+        case AST_NODE_CASE:
+        node->data._case.value = _get_node(reader);
+        node->data._case.expr = _get_node(reader);
+        break;
+        case AST_NODE_DEFAULT_CASE:
+        node->data.default_case.expr = _get_node(reader);
+        break;
+        case AST_NODE_GOTO:
+        node->data._goto.expr = _get_node(reader);
+        break;
+        case AST_NODE_RET:
+        node->data.ret.expr = _get_node(reader);
+        break;
+        case AST_NODE_TRY:
+        node->data.try.expr = _get_node(reader);
+        node->data.try.catch_var_decl = _get_node(reader);
+        node->data.try.catch_expr = _get_node(reader);
+        node->data.try.finally_expr = _get_node(reader);
+        break;
+        case AST_NODE_THROW:
+        node->data.throw.what = _get_node(reader);
+        break;
+        case AST_NODE_NEW:
+        node->data.new.type = _get_node(reader);
+        break;
+        case AST_NODE_LABEL:
+        node->data.label.name = _get_str(reader);
+        break;
+        case AST_NODE_IMPORT:
+        node->data.import.what = _get_node(reader);
+        break;
+        case AST_NODE_IMP_NEW:
+        node->data.imp_new.parameters = _get_list(reader);
+        break;
+    }
+    return node;
+}
+
+void ast_cache_unmap(struct ast_cache_map* map) {
+    if (map->base != NULL) munmap(map->base, map->len);
+    map->base = NULL;
+    map->len = 0;
+}
+
+struct ast_node* ast_cache_load(char* dir, uint64_t content_hash, char* content, size_t content_len, struct arraylist* lines, struct ast_cache_map* map) {
+    char* path = _ast_cache_path(dir, content_hash);
+    int fd = open(path, O_RDONLY);
+    free(path);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        if (fd >= 0) close(fd);
+        ast_cache_stats.misses++;
+        return NULL;
+    }
+    void* base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        ast_cache_stats.misses++;
+        return NULL;
+    }
+    struct _ast_reader reader = (struct _ast_reader) {base, st.st_size, 0, 0};
+    char* magic = _get_bytes(&reader, strlen(AST_CACHE_MAGIC));
+    char* version = NULL;
+    if (magic != NULL && memcmp(magic, AST_CACHE_MAGIC, strlen(AST_CACHE_MAGIC)) == 0) {
+        version = _get_str(&reader);
+    }
+    uint64_t stored_hash = _get_u64(&reader);
+    uint64_t stored_len = _get_u64(&reader);
+    uint64_t line_count = _get_u64(&reader);
+    uint8_t* offsets = NULL;
+    if (version == NULL || !str_eq(version, FLEXC_VERSION) || stored_hash != content_hash || stored_len != content_len || line_count == 0 || line_count > content_len + 1) {
+        reader.failed = 1;
+    } else {
+        offsets = _get_bytes(&reader, line_count * sizeof(uint64_t));
+    }
+    // every line but the first must follow a newline, checked up front so a rejected entry leaves content as read
+    for (uint64_t i = 0; !reader.failed && i < line_count; i++) {
+        uint64_t offset = 0;
+        memcpy(&offset, offsets + i * sizeof(uint64_t), sizeof(uint64_t));
+        if (i == 0 ? offset != 0 : (offset == 0 || offset > content_len || content[offset - 1] != '\n')) reader.failed = 1;
+    }
+    struct ast_node* root = reader.failed ? NULL : _get_node(&reader);
+    if (reader.failed || root == NULL || root->type != AST_NODE_FILE || reader.pos != reader.len) {
+        free_ast_node(root);
+        munmap(base, st.st_size);
+        ast_cache_stats.rejected++;
+        ast_cache_stats.misses++;
+        return NULL;
+    }
+    for (uint64_t i = 0; i < line_count; i++) {
+        uint64_t offset = 0;
+        memcpy(&offset, offsets + i * sizeof(uint64_t), sizeof(uint64_t));
+        if (offset > 0) content[offset - 1] = 0;
+        arraylist_addptr(lines, content + offset);
+    }
+    root->data.file.lines = lines;
+    map->base = base;
+    map->len = st.st_size;
+    ast_cache_stats.hits++;
+    return root;
+}
+
+void print_ast_cache_stats(int fd) {
+    dprintf(fd, "ast cache hits = %lu\n", ast_cache_stats.hits);
+    dprintf(fd, "ast cache misses = %lu\n", ast_cache_stats.misses);
+    dprintf(fd, "ast cache stores = %lu\n", ast_cache_stats.stores);
+    dprintf(fd, "ast cache rejected = %lu\n", ast_cache_stats.rejected);
+}
@@ -0,0 +1,36 @@
+#ifndef __AST_CACHE_H__
+#define __AST_CACHE_H__
+
+#include <stdint.h>
+#include <unistd.h>
+#include "arraylist.h"
+#include "ast.h"
+
+struct ast_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t rejected; // entries that were found but truncated, corrupt or from another compiler version
+};
+
+extern struct ast_cache_stats ast_cache_stats;
+
+// a loaded entry stays mapped while its AST is in use, strings in the tree point into it
+struct ast_cache_map {
+    void* base;
+    size_t len;
+};
+
+// looks up the parse of a file by the fnv1a_64 of its content. on a hit, splits content into lines the way the
+// lexer pass would and returns the file node, with nodes and lists freshly allocated so free_ast_node works as usual.
+// returns NULL on a miss, leaving content untouched.
+struct ast_node* ast_cache_load(char* dir, uint64_t content_hash, char* content, size_t content_len, struct arraylist* lines, struct ast_cache_map* map);
+
+// only error free parses should be stored, a hit skips lexing and its error reporting entirely
+int ast_cache_store(char* dir, uint64_t content_hash, char* content, size_t content_len, struct arraylist* lines, struct ast_node* root);
+
+void ast_cache_unmap(struct ast_cache_map* map);
+
+void print_ast_cache_stats(int fd);
+
+#endif
@@ -1,4 +1,36 @@
 #ifndef __CLI_H__
 #define __CLI_H__
 
-#endif
\ No newline at end of file
+#include <stdint.h>
+
+struct cli_options {
+    char* outputPE;
+    char* outputLex;
+    char* outputAST;
+    char* outputIR;
+    char* out_dir; // -olex and -oast write a file per input here, their arguments are the extensions
+    uint8_t dump_json; // -olex and -oast as ndjson instead of text
+    char* dump_ir; // IR file to print as text instead of compiling
+    uint8_t print_stats;
+    uint8_t check_all;
+    uint8_t prune_report;
+    uint8_t time_report; // wall and cpu time per phase and file, see time_report.h
+    uint8_t time_report_json;
+    char* time_report_out; // file for the time report instead of stderr
+    uint8_t perf_counters; // hardware counters per phase in the time report
+    char* trace; // file to write chrome trace events of the build to
+    uint8_t mem_report; // allocations by tag and phase, needs a SMEM_TRACK build
+    char* incremental;
+    char* ast_cache; // directory of parsed files keyed by content
+    char* ast_cache_owned; // <incremental>.ast when only --incremental is given, freed with input_files
+    uint8_t lazy_bodies; // func bodies are parsed when analysis first needs them, -oast alone shows them all as stubs
+    char* emit_interface; // directory to write .flexi files of the source modules to
+    char* iface_path; // directory to read .flexi files of imported modules from
+    char* daemon; // socket to serve requests on
+    char* connect; // socket of a daemon to forward this invocation to
+    long thread_count;
+    char** input_files;
+    int input_file_count;
+};
+
+#endif
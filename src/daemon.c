@@ -0,0 +1,198 @@
+#include "daemon.h"
+#include "smem.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+// wire format, native endianness since both ends are on the same host:
+// request: u32 cwd length, cwd, u32 argc, then per arg u32 length and bytes
+// response: raw output until the last 4 bytes, which are the i32 exit status
+
+// anything beyond these is not a flexc command line, and the request is dropped
+#define DAEMON_MAX_ARGS 65536
+#define DAEMON_MAX_STR (1 << 20)
+// a client that stops sending mid request would otherwise block the daemon for good
+#define DAEMON_READ_TIMEOUT_SEC 10
+
+int _write_full(int fd, const void* buf, size_t len) {
+    while (len > 0) {
+        ssize_t wr = write(fd, buf, len);
+        if (wr < 0 && errno == EINTR) continue;
+        if (wr <= 0) return -1;
+        buf += wr;
+        len -= wr;
+    }
+    return 0;
+}
+
+int _read_full(int fd, void* buf, size_t len) {
+    while (len > 0) {
+        ssize_t rd = read(fd, buf, len);
+        if (rd < 0 && errno == EINTR) continue;
+        if (rd <= 0) return -1;
+        buf += rd;
+        len -= rd;
+    }
+    return 0;
+}
+
+int _write_str(int fd, const char* str) {
+    uint32_t len = strlen(str);
+    if (_write_full(fd, &len, sizeof(uint32_t))) return -1;
+    return _write_full(fd, str, len);
+}
+
+char* _read_str(int fd) {
+    uint32_t len = 0;
+    if (_read_full(fd, &len, sizeof(uint32_t)) || len > DAEMON_MAX_STR) return NULL;
+    char* str = smalloc(len + 1);
+    if (_read_full(fd, str, len)) {
+        free(str);
+        return NULL;
+    }
+    str[len] = 0;
+    return str;
+}
+
+int _socket_addr(char* path, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Socket path too long: '%s'\n", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+void _serve_client(int client, daemon_handler handler) {
+    char* cwd = _read_str(client);
+    uint32_t argc = 0;
+    if (cwd == NULL || _read_full(client, &argc, sizeof(uint32_t)) || argc > DAEMON_MAX_ARGS) {
+        free(cwd);
+        return;
+    }
+    char** argv = smalloc((argc + 1) * sizeof(char*));
+    uint32_t read_args = 0;
+    for (; read_args < argc; read_args++) {
+        argv[read_args] = _read_str(client);
+        if (argv[read_args] == NULL) break;
+    }
+    argv[read_args] = NULL;
+    if (read_args == argc) {
+        int32_t status = 1;
+        // the request runs in the client's directory, the daemon goes back to its own afterwards
+        int saved_cwd = open(".", O_RDONLY | O_DIRECTORY);
+        if (saved_cwd < 0 || chdir(cwd) != 0) {
+            dprintf(client, "IO Error: '%s' '%s'\n", strerror(errno), cwd);
+        } else {
+            // everything the request prints goes to the client, forked children included
+            fflush(stdout);
+            fflush(stderr);
+            int saved_out = dup(STDOUT_FILENO);
+            int saved_err = dup(STDERR_FILENO);
+            dup2(client, STDOUT_FILENO);
+            dup2(client, STDERR_FILENO);
+            status = handler(argc, argv);
+            fflush(stdout);
+            fflush(stderr);
+            dup2(saved_out, STDOUT_FILENO);
+            dup2(saved_err, STDERR_FILENO);
+            close(saved_out);
+            close(saved_err);
+            if (fchdir(saved_cwd) != 0) {
+                fprintf(stderr, "IO Error: '%s' while restoring the daemon directory\n", strerror(errno));
+            }
+        }
+        if (saved_cwd >= 0) close(saved_cwd);
+        _write_full(client, &status, sizeof(int32_t));
+    }
+    for (uint32_t i = 0; i < read_args; i++) free(argv[i]);
+    free(argv);
+    free(cwd);
+}
+
+int daemon_serve(char* path, daemon_handler handler) {
+    struct sockaddr_un addr;
+    if (_socket_addr(path, &addr)) return 1;
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        fprintf(stderr, "IO Error: '%s' '%s'\n", strerror(errno), path);
+        return 1;
+    }
+    // a socket left behind by a daemon that was killed
+    unlink(path);
+    if (bind(server, (struct sockaddr*) &addr, sizeof(struct sockaddr_un)) != 0 || listen(server, 16) != 0) {
+        fprintf(stderr, "IO Error: '%s' '%s'\n", strerror(errno), path);
+        close(server);
+        return 1;
+    }
+    // a client going away mid request must not take the daemon with it
+    signal(SIGPIPE, SIG_IGN);
+    while (1) {
+        int client = accept(server, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "IO Error: '%s' '%s'\n", strerror(errno), path);
+            break;
+        }
+        struct timeval timeout = {DAEMON_READ_TIMEOUT_SEC, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(struct timeval));
+        _serve_client(client, handler);
+        close(client);
+    }
+    close(server);
+    unlink(path);
+    return 1;
+}
+
+int daemon_forward(char* path, int argc, char* argv[]) {
+    struct sockaddr_un addr;
+    if (_socket_addr(path, &addr)) return 1;
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 || connect(server, (struct sockaddr*) &addr, sizeof(struct sockaddr_un)) != 0) {
+        fprintf(stderr, "Could not connect to daemon: '%s' '%s'\n", strerror(errno), path);
+        if (server >= 0) close(server);
+        return 1;
+    }
+    char* cwd = getcwd(NULL, 0);
+    uint32_t count = argc;
+    if (cwd == NULL || _write_str(server, cwd) || _write_full(server, &count, sizeof(uint32_t))) goto lost;
+    for (int i = 0; i < argc; i++) {
+        if (_write_str(server, argv[i])) goto lost;
+    }
+    // the status trails the output, so the last 4 bytes read are always held back
+    char buf[4096 + sizeof(int32_t)];
+    size_t held = 0;
+    while (1) {
+        ssize_t rd = read(server, buf + held, sizeof(buf) - held);
+        if (rd < 0 && errno == EINTR) continue;
+        if (rd < 0) goto lost;
+        if (rd == 0) break;
+        held += rd;
+        if (held > sizeof(int32_t)) {
+            size_t out = held - sizeof(int32_t);
+            if (_write_full(STDERR_FILENO, buf, out)) goto lost;
+            memmove(buf, buf + out, sizeof(int32_t));
+            held = sizeof(int32_t);
+        }
+    }
+    if (held != sizeof(int32_t)) goto lost;
+    int32_t status = 0;
+    memcpy(&status, buf, sizeof(int32_t));
+    free(cwd);
+    close(server);
+    return status;
+    lost:;
+    fprintf(stderr, "Lost connection to daemon: '%s'\n", path);
+    free(cwd);
+    close(server);
+    return 1;
+}
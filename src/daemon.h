@@ -0,0 +1,13 @@
+#ifndef __DAEMON_H__
+#define __DAEMON_H__
+
+// a request runs with stdout and stderr redirected to the client, returns the exit status to report back
+typedef int (*daemon_handler)(int argc, char* argv[]);
+
+// accepts requests on a unix socket at path, one at a time. only returns on setup failure.
+int daemon_serve(char* path, daemon_handler handler);
+
+// sends argv and the working directory to the daemon at path, copies its output to stderr and returns its exit status
+int daemon_forward(char* path, int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,293 @@
+#include "flexir.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char* FLEXIR_PROT_NAMES[] = {"none", "priv", "prot", "pub"};
+
+// in the order of enum prim_type
+const char* FLEXIR_PRIM_NAMES[] = {"u8", "i8", "u16", "i16", "u32", "i32", "u64", "i64", "f", "d"};
+
+const size_t FLEXIR_RECORD_SIZES[FLEXIR_SECTION_COUNT] = {1, sizeof(uint32_t), sizeof(struct flexir_file), sizeof(struct flexir_module), sizeof(struct flexir_class), sizeof(struct flexir_func), sizeof(struct flexir_var), sizeof(struct flexir_type), sizeof(struct flexir_node_type)};
+
+int flexir_init(struct flexir* ir, const void* data, size_t len) {
+    memset(ir, 0, sizeof(struct flexir));
+    const struct flexir_header* header = data;
+    if (((uintptr_t) data & 7) != 0 || len < sizeof(struct flexir_header)) return -2;
+    if (memcmp(header->magic, FLEXIR_MAGIC, 8) != 0 || header->version != FLEXIR_VERSION || header->byte_order != FLEXIR_BYTE_ORDER || header->size != len) return -2;
+    for (int i = 0; i < FLEXIR_SECTION_COUNT; i++) {
+        const struct flexir_section* section = &header->sections[i];
+        if ((section->offset & 7) != 0 || section->offset > len || section->count > (len - section->offset) / FLEXIR_RECORD_SIZES[i]) return -2;
+        // indices are 32 bit, FLEXIR_NONE included
+        if (i != FLEXIR_SECTION_STRINGS && section->count >= FLEXIR_NONE) return -2;
+    }
+    const struct flexir_section* sections = header->sections;
+    ir->header = header;
+    ir->strings = (const char*) data + sections[FLEXIR_SECTION_STRINGS].offset;
+    ir->strings_len = sections[FLEXIR_SECTION_STRINGS].count;
+    // every string ends before the section does
+    if (ir->strings_len > 0 && ir->strings[ir->strings_len - 1] != 0) return -2;
+    ir->refs = (const void*) ((const char*) data + sections[FLEXIR_SECTION_REFS].offset);
+    ir->ref_count = sections[FLEXIR_SECTION_REFS].count;
+    ir->files = (const void*) ((const char*) data + sections[FLEXIR_SECTION_FILES].offset);
+    ir->file_count = sections[FLEXIR_SECTION_FILES].count;
+    ir->modules = (const void*) ((const char*) data + sections[FLEXIR_SECTION_MODULES].offset);
+    ir->module_count = sections[FLEXIR_SECTION_MODULES].count;
+    ir->classes = (const void*) ((const char*) data + sections[FLEXIR_SECTION_CLASSES].offset);
+    ir->class_count = sections[FLEXIR_SECTION_CLASSES].count;
+    ir->funcs = (const void*) ((const char*) data + sections[FLEXIR_SECTION_FUNCS].offset);
+    ir->func_count = sections[FLEXIR_SECTION_FUNCS].count;
+    ir->vars = (const void*) ((const char*) data + sections[FLEXIR_SECTION_VARS].offset);
+    ir->var_count = sections[FLEXIR_SECTION_VARS].count;
+    ir->types = (const void*) ((const char*) data + sections[FLEXIR_SECTION_TYPES].offset);
+    ir->type_count = sections[FLEXIR_SECTION_TYPES].count;
+    ir->node_types = (const void*) ((const char*) data + sections[FLEXIR_SECTION_NODE_TYPES].offset);
+    ir->node_type_count = sections[FLEXIR_SECTION_NODE_TYPES].count;
+    return 0;
+}
+
+int flexir_open(struct flexir* ir, const char* path) {
+    memset(ir, 0, sizeof(struct flexir));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if ((uint64_t) st.st_size < sizeof(struct flexir_header)) {
+        close(fd);
+        return -2;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    int status = flexir_init(ir, map, st.st_size);
+    if (status != 0) {
+        munmap(map, st.st_size);
+        return status;
+    }
+    ir->map = map;
+    ir->map_len = st.st_size;
+    return 0;
+}
+
+void flexir_close(struct flexir* ir) {
+    if (ir->map != NULL) munmap(ir->map, ir->map_len);
+    memset(ir, 0, sizeof(struct flexir));
+}
+
+const char* flexir_string(const struct flexir* ir, uint32_t ref) {
+    return ref < ir->strings_len ? ir->strings + ref : NULL;
+}
+
+const uint32_t* flexir_list(const struct flexir* ir, struct flexir_list list) {
+    return list.first <= ir->ref_count && list.count <= ir->ref_count - list.first ? ir->refs + list.first : NULL;
+}
+
+const struct flexir_file* flexir_file(const struct flexir* ir, uint32_t i) {
+    return i < ir->file_count ? ir->files + i : NULL;
+}
+
+const struct flexir_module* flexir_module(const struct flexir* ir, uint32_t i) {
+    return i < ir->module_count ? ir->modules + i : NULL;
+}
+
+const struct flexir_class* flexir_class(const struct flexir* ir, uint32_t i) {
+    return i < ir->class_count ? ir->classes + i : NULL;
+}
+
+const struct flexir_func* flexir_func(const struct flexir* ir, uint32_t i) {
+    return i < ir->func_count ? ir->funcs + i : NULL;
+}
+
+const struct flexir_var* flexir_var(const struct flexir* ir, uint32_t i) {
+    return i < ir->var_count ? ir->vars + i : NULL;
+}
+
+const struct flexir_type* flexir_type(const struct flexir* ir, uint32_t i) {
+    return i < ir->type_count ? ir->types + i : NULL;
+}
+
+uint32_t flexir_node_type(const struct flexir* ir, uint32_t file, uint32_t node) {
+    const struct flexir_file* f = flexir_file(ir, file);
+    if (f == NULL || f->node_types.first > ir->node_type_count || f->node_types.count > ir->node_type_count - f->node_types.first) return FLEXIR_NONE;
+    const struct flexir_node_type* entries = ir->node_types + f->node_types.first;
+    uint32_t low = 0;
+    uint32_t high = f->node_types.count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (entries[mid].node == node) {
+            return entries[mid].type;
+        } else if (entries[mid].node < node) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return FLEXIR_NONE;
+}
+
+const char* _flexir_str(const struct flexir* ir, uint32_t ref) {
+    const char* str = flexir_string(ir, ref);
+    return str == NULL ? "?" : str;
+}
+
+void _flexir_write_type(const struct flexir* ir, uint32_t type, FILE* out, int depth) {
+    const struct flexir_type* t = flexir_type(ir, type);
+    // interned types can not be cyclic, a corrupt file can
+    if (t == NULL || depth > 64) {
+        fputc('?', out);
+        return;
+    }
+    if (t->flags & FLEXIR_TYPE_CONST) fputs("const ", out);
+    const uint32_t* args = flexir_list(ir, t->args);
+    if (t->kind == FLEXIR_TYPE_FUNC) {
+        fputs("protofunc ", out);
+        _flexir_write_type(ir, t->return_type, out, depth + 1);
+        fputc('(', out);
+        for (uint32_t i = 0; args != NULL && i < t->args.count; i++) {
+            if (i > 0) fputs(", ", out);
+            _flexir_write_type(ir, args[i], out, depth + 1);
+        }
+        fputc(')', out);
+    } else {
+        if (t->name != FLEXIR_NONE) {
+            fputs(_flexir_str(ir, t->name), out);
+        } else if (t->kind == FLEXIR_TYPE_PRIMITIVE && t->prim < sizeof(FLEXIR_PRIM_NAMES) / sizeof(char*)) {
+            fputs(FLEXIR_PRIM_NAMES[t->prim], out);
+        } else {
+            fputc('?', out);
+        }
+        if (args != NULL && t->args.count > 0) {
+            fputc('<', out);
+            for (uint32_t i = 0; i < t->args.count; i++) {
+                if (i > 0) fputs(", ", out);
+                _flexir_write_type(ir, args[i], out, depth + 1);
+            }
+            fputc('>', out);
+        }
+    }
+    for (uint8_t i = 0; i < t->array_dims; i++) fputs("[]", out);
+    if (t->flags & FLEXIR_TYPE_REF) fputc('&', out);
+    if (t->flags & FLEXIR_TYPE_VARIADIC) fputs("...", out);
+}
+
+void flexir_write_type(const struct flexir* ir, uint32_t type, FILE* out) {
+    _flexir_write_type(ir, type, out, 0);
+}
+
+void _flexir_dump_ref(FILE* out, const char* what, uint32_t i) {
+    if (i != FLEXIR_NONE) fprintf(out, " %s=#%u", what, i);
+}
+
+void _flexir_dump_list(const struct flexir* ir, FILE* out, const char* what, struct flexir_list list) {
+    if (list.count == 0) return;
+    const uint32_t* items = flexir_list(ir, list);
+    fprintf(out, " %s=", what);
+    for (uint32_t i = 0; i < list.count; i++) {
+        if (items == NULL) {
+            fputc('?', out);
+            break;
+        }
+        fprintf(out, "%s#%u", i == 0 ? "" : ",", items[i]);
+    }
+}
+
+void _flexir_dump_flags(FILE* out, uint8_t flags, const char** names) {
+    for (int i = 0; names[i] != NULL; i++) {
+        if (flags & (1 << i)) fprintf(out, " %s", names[i]);
+    }
+}
+
+const char* _flexir_prot(uint8_t prot) {
+    return prot < 4 ? FLEXIR_PROT_NAMES[prot] : "?";
+}
+
+const char* FLEXIR_MODULE_FLAG_NAMES[] = {"entry", "live", "iface", NULL};
+const char* FLEXIR_CLASS_FLAG_NAMES[] = {"synch", "virt", "iface", "pure", "live", NULL};
+const char* FLEXIR_FUNC_FLAG_NAMES[] = {"anonymous", "synch", "virt", "async", "csig", "static", "pure", "live", NULL};
+const char* FLEXIR_VAR_FLAG_NAMES[] = {"synch", "csig", "static", "const", "live", NULL};
+
+void flexir_dump(const struct flexir* ir, FILE* out) {
+    fprintf(out, "flexir v%u, %lu errors\n", ir->header->version, ir->header->error_count);
+    for (uint32_t i = 0; i < ir->file_count; i++) {
+        const struct flexir_file* file = &ir->files[i];
+        fprintf(out, "file #%u %s lines=%u nodes=%u typed=%u\n", i, _flexir_str(ir, file->rel_path), file->line_count, file->node_count, file->node_types.count);
+    }
+    for (uint32_t i = 0; i < ir->module_count; i++) {
+        const struct flexir_module* mod = &ir->modules[i];
+        fprintf(out, "module #%u %s %s", i, _flexir_str(ir, mod->name), _flexir_prot(mod->prot));
+        _flexir_dump_flags(out, mod->flags, FLEXIR_MODULE_FLAG_NAMES);
+        _flexir_dump_ref(out, "parent", mod->parent);
+        _flexir_dump_ref(out, "file", mod->file);
+        _flexir_dump_list(ir, out, "submodules", mod->submodules);
+        _flexir_dump_list(ir, out, "imports", mod->imports);
+        _flexir_dump_list(ir, out, "classes", mod->classes);
+        _flexir_dump_list(ir, out, "funcs", mod->funcs);
+        _flexir_dump_list(ir, out, "vars", mod->vars);
+        fputc('\n', out);
+    }
+    for (uint32_t i = 0; i < ir->class_count; i++) {
+        const struct flexir_class* clas = &ir->classes[i];
+        fprintf(out, "class #%u %s %s", i, _flexir_str(ir, clas->name), _flexir_prot(clas->prot));
+        _flexir_dump_flags(out, clas->flags, FLEXIR_CLASS_FLAG_NAMES);
+        fprintf(out, " @%u:%u", clas->pos.line, clas->pos.col);
+        _flexir_dump_ref(out, "module", clas->module);
+        _flexir_dump_ref(out, "file", clas->file);
+        _flexir_dump_ref(out, "type", clas->type);
+        _flexir_dump_list(ir, out, "parents", clas->parents);
+        _flexir_dump_list(ir, out, "funcs", clas->funcs);
+        _flexir_dump_list(ir, out, "vars", clas->vars);
+        fputc('\n', out);
+    }
+    for (uint32_t i = 0; i < ir->func_count; i++) {
+        const struct flexir_func* func = &ir->funcs[i];
+        fprintf(out, "func #%u %s %s", i, func->name == FLEXIR_NONE ? "<anonymous>" : _flexir_str(ir, func->name), _flexir_prot(func->prot));
+        _flexir_dump_flags(out, func->flags, FLEXIR_FUNC_FLAG_NAMES);
+        fprintf(out, " @%u:%u frame=%u", func->pos.line, func->pos.col, func->frame_size);
+        _flexir_dump_ref(out, "module", func->module);
+        _flexir_dump_ref(out, "class", func->clas);
+        _flexir_dump_ref(out, "closing", func->closing);
+        _flexir_dump_ref(out, "file", func->file);
+        _flexir_dump_ref(out, "returns", func->return_type);
+        _flexir_dump_list(ir, out, "args", func->args);
+        _flexir_dump_list(ir, out, "closures", func->closures);
+        fputc('\n', out);
+    }
+    for (uint32_t i = 0; i < ir->var_count; i++) {
+        const struct flexir_var* var = &ir->vars[i];
+        fprintf(out, "var #%u %s %s", i, _flexir_str(ir, var->name), _flexir_prot(var->prot));
+        _flexir_dump_flags(out, var->flags, FLEXIR_VAR_FLAG_NAMES);
+        fprintf(out, " @%u:%u uid=%lu slot=%u", var->pos.line, var->pos.col, var->uid, var->slot);
+        _flexir_dump_ref(out, "module", var->module);
+        _flexir_dump_ref(out, "class", var->clas);
+        _flexir_dump_ref(out, "func", var->func);
+        _flexir_dump_ref(out, "file", var->file);
+        _flexir_dump_ref(out, "type", var->type);
+        _flexir_dump_ref(out, "names", var->names_func);
+        fputc('\n', out);
+    }
+    for (uint32_t i = 0; i < ir->type_count; i++) {
+        const struct flexir_type* type = &ir->types[i];
+        fprintf(out, "type #%u ", i);
+        flexir_write_type(ir, i, out);
+        if (type->flags & FLEXIR_TYPE_GENERIC) fputs(" generic", out);
+        if (type->flags & FLEXIR_TYPE_OPTIONAL) fputs(" optional", out);
+        if (type->flags & FLEXIR_TYPE_MASTER) fputs(" master", out);
+        if (type->kind == FLEXIR_TYPE_CLASS) _flexir_dump_ref(out, "class", type->clas);
+        fputc('\n', out);
+    }
+    for (uint32_t i = 0; i < ir->file_count; i++) {
+        const struct flexir_file* file = &ir->files[i];
+        for (uint32_t j = 0; j < file->node_types.count; j++) {
+            if (file->node_types.first > ir->node_type_count || j >= ir->node_type_count - file->node_types.first) break;
+            const struct flexir_node_type* entry = &ir->node_types[file->node_types.first + j];
+            fprintf(out, "node #%u:%u %s @%u:%u ", i, entry->node, _flexir_str(ir, entry->kind), entry->pos.line, entry->pos.col);
+            flexir_write_type(ir, entry->type, out);
+            fprintf(out, " type=#%u\n", entry->type);
+        }
+    }
+}
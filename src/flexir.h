@@ -0,0 +1,253 @@
+#ifndef __FLEXIR_H__
+#define __FLEXIR_H__
+
+// the binary prog IR written by -oir, and a reader for it. this header and flexir.c only need libc, tools can take
+// them as they are to consume analysis results without running the compiler.
+//
+// a file is a flexir_header followed by the sections it points to. every section is an array of fixed size records
+// at an 8 byte aligned offset, so a mapping of the file is used as is: records refer to each other by index into
+// their section, to strings by byte offset into the strings section, and to lists by a range of the refs section.
+// numbers are in the byte order of the machine that wrote the file, see byte_order.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define FLEXIR_MAGIC "FLEXIR\0\0"
+#define FLEXIR_VERSION 1
+#define FLEXIR_BYTE_ORDER 0x01020304
+
+// an absent string, type or declaration
+#define FLEXIR_NONE UINT32_MAX
+
+#define FLEXIR_SECTION_STRINGS 0 // count is in bytes, every string is nul terminated
+#define FLEXIR_SECTION_REFS 1 // uint32_t indices making up lists
+#define FLEXIR_SECTION_FILES 2
+#define FLEXIR_SECTION_MODULES 3
+#define FLEXIR_SECTION_CLASSES 4
+#define FLEXIR_SECTION_FUNCS 5
+#define FLEXIR_SECTION_VARS 6
+#define FLEXIR_SECTION_TYPES 7
+#define FLEXIR_SECTION_NODE_TYPES 8
+#define FLEXIR_SECTION_COUNT 9
+
+struct flexir_section {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct flexir_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size; // of the whole file
+    uint64_t error_count; // analysis errors of the build, types are incomplete unless 0
+    struct flexir_section sections[FLEXIR_SECTION_COUNT];
+};
+
+struct flexir_list {
+    uint32_t first;
+    uint32_t count;
+};
+
+struct flexir_pos {
+    uint32_t line;
+    uint32_t col;
+};
+
+// same values as PROTECTION_*
+#define FLEXIR_PROT_NONE 0
+#define FLEXIR_PROT_PRIV 1
+#define FLEXIR_PROT_PROT 2
+#define FLEXIR_PROT_PUB 3
+
+struct flexir_file {
+    uint32_t name;
+    uint32_t rel_path;
+    uint32_t line_count;
+    uint32_t node_count; // AST nodes in the order -oast lists them, which node_types indexes
+    struct {
+        uint32_t first;
+        uint32_t count;
+    } node_types; // range of the node_types section, sorted by node
+};
+
+#define FLEXIR_MODULE_ENTRY 0x1
+#define FLEXIR_MODULE_LIVE 0x2
+#define FLEXIR_MODULE_IFACE 0x4
+
+struct flexir_module {
+    uint32_t name;
+    uint32_t parent; // module
+    uint32_t file; // the file that declared it first
+    uint8_t prot;
+    uint8_t flags;
+    uint8_t pad[2];
+    struct flexir_list submodules;
+    struct flexir_list imports; // modules, including the parent
+    struct flexir_list classes;
+    struct flexir_list funcs; // named and anonymous, closures are listed by the func enclosing them
+    struct flexir_list vars; // including the vars naming funcs
+};
+
+#define FLEXIR_CLASS_SYNCH 0x1
+#define FLEXIR_CLASS_VIRT 0x2
+#define FLEXIR_CLASS_IFACE 0x4
+#define FLEXIR_CLASS_PURE 0x8
+#define FLEXIR_CLASS_LIVE 0x10
+
+struct flexir_class {
+    uint32_t name;
+    uint32_t module;
+    uint32_t file;
+    uint32_t type; // its master type, holding the generic parameters
+    struct flexir_pos pos;
+    uint8_t prot;
+    uint8_t flags;
+    uint8_t pad[2];
+    struct flexir_list parents; // types
+    struct flexir_list funcs;
+    struct flexir_list vars;
+};
+
+#define FLEXIR_FUNC_ANONYMOUS 0x1
+#define FLEXIR_FUNC_SYNCH 0x2
+#define FLEXIR_FUNC_VIRT 0x4
+#define FLEXIR_FUNC_ASYNC 0x8
+#define FLEXIR_FUNC_CSIG 0x10
+#define FLEXIR_FUNC_STAT 0x20
+#define FLEXIR_FUNC_PURE 0x40
+#define FLEXIR_FUNC_LIVE 0x80
+
+struct flexir_func {
+    uint32_t name; // FLEXIR_NONE if anonymous
+    uint32_t module; // exactly one of module, clas and closing is set
+    uint32_t clas;
+    uint32_t closing; // func
+    uint32_t file;
+    uint32_t return_type;
+    struct flexir_pos pos;
+    uint32_t frame_size; // param and local slots
+    uint8_t prot;
+    uint8_t flags;
+    uint8_t pad[2];
+    struct flexir_list args; // vars
+    struct flexir_list closures; // funcs
+};
+
+#define FLEXIR_VAR_SYNCH 0x1
+#define FLEXIR_VAR_CSIG 0x2
+#define FLEXIR_VAR_STAT 0x4
+#define FLEXIR_VAR_CONS 0x8
+#define FLEXIR_VAR_LIVE 0x10
+
+// module vars, class vars and func arguments. locals only show up through node types.
+struct flexir_var {
+    uint64_t uid;
+    uint32_t name;
+    uint32_t module; // exactly one of module, clas and func is set
+    uint32_t clas;
+    uint32_t func; // for arguments
+    uint32_t file;
+    uint32_t type;
+    uint32_t slot;
+    uint32_t names_func; // the func a module or class var stands for
+    struct flexir_pos pos;
+    uint8_t prot;
+    uint8_t flags;
+    uint8_t pad[6];
+};
+
+// same values as PROG_TYPE_*
+#define FLEXIR_TYPE_UNKNOWN 0
+#define FLEXIR_TYPE_PRIMITIVE 1
+#define FLEXIR_TYPE_CLASS 2
+#define FLEXIR_TYPE_FUNC 3
+
+#define FLEXIR_TYPE_REF 0x1
+#define FLEXIR_TYPE_VARIADIC 0x2
+#define FLEXIR_TYPE_CONST 0x4
+#define FLEXIR_TYPE_GENERIC 0x8 // a generic parameter, not a type with generic arguments
+#define FLEXIR_TYPE_OPTIONAL 0x10
+#define FLEXIR_TYPE_MASTER 0x20 // the type a class declares
+
+// types are interned, two indices are the same type exactly when they are equal
+struct flexir_type {
+    uint8_t kind; // FLEXIR_TYPE_UNKNOWN etc.
+    uint8_t prim; // same values as enum prim_type, for primitives
+    uint8_t array_dims;
+    uint8_t flags;
+    uint32_t name;
+    uint32_t clas; // for class types
+    uint32_t return_type; // for func types
+    struct flexir_list args; // types, func arguments or generic arguments in the order of the class parameters
+};
+
+struct flexir_node_type {
+    uint32_t node; // index of the node within its file
+    uint32_t type;
+    uint32_t kind; // string, the AST node type name
+    struct flexir_pos pos;
+    uint32_t pad;
+};
+
+struct flexir {
+    void* map; // NULL unless opened by flexir_open
+    size_t map_len;
+    const struct flexir_header* header;
+    const char* strings;
+    uint64_t strings_len;
+    const uint32_t* refs;
+    uint64_t ref_count;
+    const struct flexir_file* files;
+    uint64_t file_count;
+    const struct flexir_module* modules;
+    uint64_t module_count;
+    const struct flexir_class* classes;
+    uint64_t class_count;
+    const struct flexir_func* funcs;
+    uint64_t func_count;
+    const struct flexir_var* vars;
+    uint64_t var_count;
+    const struct flexir_type* types;
+    uint64_t type_count;
+    const struct flexir_node_type* node_types;
+    uint64_t node_type_count;
+};
+
+// maps path read only. returns 0, -1 on IO errors with errno set, or -2 if it is not a valid IR file.
+int flexir_open(struct flexir* ir, const char* path);
+
+// reads an IR file already in memory, data has to be 8 byte aligned and outlive ir. returns 0 or -2.
+int flexir_init(struct flexir* ir, const void* data, size_t len);
+
+void flexir_close(struct flexir* ir);
+
+// the accessors return NULL for FLEXIR_NONE and for anything out of range, so a corrupt file can not make a reader
+// go outside the mapping. only the sections are checked up front.
+const char* flexir_string(const struct flexir* ir, uint32_t ref);
+
+const uint32_t* flexir_list(const struct flexir* ir, struct flexir_list list);
+
+const struct flexir_file* flexir_file(const struct flexir* ir, uint32_t i);
+
+const struct flexir_module* flexir_module(const struct flexir* ir, uint32_t i);
+
+const struct flexir_class* flexir_class(const struct flexir* ir, uint32_t i);
+
+const struct flexir_func* flexir_func(const struct flexir* ir, uint32_t i);
+
+const struct flexir_var* flexir_var(const struct flexir* ir, uint32_t i);
+
+const struct flexir_type* flexir_type(const struct flexir* ir, uint32_t i);
+
+// the type analysis gave a node, by binary search. FLEXIR_NONE if it has none.
+uint32_t flexir_node_type(const struct flexir* ir, uint32_t file, uint32_t node);
+
+// writes a type the way it would be spelled in source
+void flexir_write_type(const struct flexir* ir, uint32_t type, FILE* out);
+
+// text form of everything in the file, one declaration per line
+void flexir_dump(const struct flexir* ir, FILE* out);
+
+#endif
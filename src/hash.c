@@ -5,7 +5,8 @@
 #include "smem.h"
 #include <string.h>
 
-uint64_t hashmap_hash(char* key, size_t size) {
+// entries keep this unfolded, so their bucket can be found again after the table grows
+uint64_t hashmap_hash(char* key) {
     if (key == NULL) return 0;
     size_t kl = strlen(key);
     size_t i = 0;
@@ -24,6 +25,10 @@ uint64_t hashmap_hash(char* key, size_t size) {
         }
     }
     hash = hash ^ kl;
+    return hash;
+}
+
+uint64_t hashmap_index(uint64_t hash, size_t size) {
     // a loop would get marginally better hashes, but be a bit slower
     if (size <= 0xFFFFFFFF) {
         hash = (hash >> 32) ^ (hash & 0xFFFFFFFF);
@@ -34,25 +39,137 @@ uint64_t hashmap_hash(char* key, size_t size) {
     if (size <= 0xFF) {
         hash = (hash >> 8) ^ (hash & 0xFF);
     }
+    return hash % size;
+}
+
+// allocations are aligned and bucket counts are powers of two, so the low bits of a pointer would pick only a few buckets
+uint64_t hashmap_ptr_index(uint64_t ptr, size_t size) {
+    return ((ptr * 0x9E3779B97F4A7C15ULL) >> 32) % size;
+}
+
+uint64_t fnv1a_64(const void* data, size_t len, uint64_t hash) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
     return hash;
 }
 
 void hashset_fixcap(struct hashset* set);
 void hashmap_fixcap(struct hashmap* map);
 
+#ifdef HASH_STATS
+
+#include <pthread.h>
+#include <stdio.h>
+
+struct hash_site* hash_sites = NULL;
+pthread_mutex_t hash_sites_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void _hash_max(uint64_t* max, uint64_t value) {
+    uint64_t seen = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (value > seen && !__atomic_compare_exchange_n(max, &seen, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+struct hash_site* _hash_site(const char* site, uint8_t set, size_t bucket_count) {
+    pthread_mutex_lock(&hash_sites_lock);
+    struct hash_site* found = hash_sites;
+    while (found != NULL && (found->set != set || strcmp(found->site, site) != 0)) found = found->next;
+    if (found == NULL) {
+        found = calloc(1, sizeof(struct hash_site));
+        found->site = site;
+        found->set = set;
+        found->next = hash_sites;
+        hash_sites = found;
+    }
+    found->tables++;
+    pthread_mutex_unlock(&hash_sites_lock);
+    _hash_max(&found->max_buckets, bucket_count);
+    return found;
+}
+
+// maps are read from several analysis tasks at once, so counters are atomic
+void _hash_lookup(struct hash_site* site, uint64_t probes, uint8_t hit) {
+    __atomic_fetch_add(&site->lookups, 1, __ATOMIC_RELAXED);
+    if (hit) __atomic_fetch_add(&site->hits, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->probes, probes, __ATOMIC_RELAXED);
+    _hash_max(&site->max_probe, probes);
+}
+
+void _hash_insert(struct hash_site* site, size_t entry_count) {
+    __atomic_fetch_add(&site->inserts, 1, __ATOMIC_RELAXED);
+    _hash_max(&site->max_entries, entry_count);
+}
+
+void _hash_resize(struct hash_site* site, size_t bucket_count) {
+    __atomic_fetch_add(&site->resizes, 1, __ATOMIC_RELAXED);
+    _hash_max(&site->max_buckets, bucket_count);
+}
+
+#define HASH_LOOKUP(table, probes, hit) _hash_lookup((table)->site, probes, hit)
+#define HASH_INSERT(table) _hash_insert((table)->site, (table)->entry_count)
+#define HASH_RESIZE(table, bucket_count) _hash_resize((table)->site, bucket_count)
+
+int _hash_site_cmp(const void* a, const void* b) {
+    uint64_t pa = (*(struct hash_site**) a)->probes;
+    uint64_t pb = (*(struct hash_site**) b)->probes;
+    return pa < pb ? 1 : pa > pb ? -1 : 0;
+}
+
+void print_hash_stats(int fd) {
+    pthread_mutex_lock(&hash_sites_lock);
+    size_t count = 0;
+    for (struct hash_site* site = hash_sites; site != NULL; site = site->next) count++;
+    struct hash_site** sorted = smalloc(sizeof(struct hash_site*) * (count + 1));
+    count = 0;
+    for (struct hash_site* site = hash_sites; site != NULL; site = site->next) sorted[count++] = site;
+    // the sites costing the most probes first
+    qsort(sorted, count, sizeof(struct hash_site*), _hash_site_cmp);
+    dprintf(fd, "%-28s %4s %8s %10s %10s %8s %6s %10s %8s %10s %10s\n", "hash site", "kind", "tables", "lookups", "hits", "avg probe", "max", "inserts", "resizes", "max size", "max bucket");
+    for (size_t i = 0; i < count; i++) {
+        struct hash_site* site = sorted[i];
+        dprintf(fd, "%-28s %4s %8lu %10lu %10lu %9.2f %6lu %10lu %8lu %10lu %10lu\n", site->site, site->set ? "set" : "map", site->tables, site->lookups, site->hits, site->lookups == 0 ? 0.0 : (double) site->probes / site->lookups, site->max_probe, site->inserts, site->resizes, site->max_entries, site->max_buckets);
+    }
+    pthread_mutex_unlock(&hash_sites_lock);
+    free(sorted);
+}
+
+struct hashmap* new_hashmap_at(size_t init_cap, const char* site) {
+#else
+
+#define HASH_LOOKUP(table, probes, hit)
+#define HASH_INSERT(table)
+#define HASH_RESIZE(table, bucket_count)
+
+void print_hash_stats(int fd) {
+    (void) fd;
+}
+
 struct hashmap* new_hashmap(size_t init_cap) {
-    struct hashmap* map = smalloc(sizeof(struct hashmap));
+#endif
+    struct hashmap* map = smallocTag(sizeof(struct hashmap), SMEM_TAG_HASHMAP);
     map->bucket_count = init_cap;
-    map->buckets = scalloc(sizeof(struct hashmap_bucket_entry*) * map->bucket_count);
+    map->buckets = scallocTag(sizeof(struct hashmap_bucket_entry*) * map->bucket_count, SMEM_TAG_HASHMAP);
     map->entry_count = 0;
+#ifdef HASH_STATS
+    map->site = _hash_site(site, 0, init_cap);
+#endif
     return map;
 }
 
+#ifdef HASH_STATS
+struct hashset* new_hashset_at(size_t init_cap, const char* site) {
+#else
 struct hashset* new_hashset(size_t init_cap) {
-    struct hashset* set = smalloc(sizeof(struct hashset));
+#endif
+    struct hashset* set = smallocTag(sizeof(struct hashset), SMEM_TAG_HASHMAP);
     set->bucket_count = init_cap;
-    set->buckets = scalloc(sizeof(struct hashset_bucket_entry*) * set->bucket_count);
+    set->buckets = scallocTag(sizeof(struct hashset_bucket_entry*) * set->bucket_count, SMEM_TAG_HASHMAP);
     set->entry_count = 0;
+#ifdef HASH_STATS
+    set->site = _hash_site(site, 1, init_cap);
+#endif
     return set;
 }
 
@@ -81,59 +198,76 @@ void free_hashset(struct hashset* set) {
 }
 
 void* hashmap_get(struct hashmap* hashmap, char* key) {
-    uint64_t hashum = hashmap_hash(key, hashmap->bucket_count);
-    uint64_t hash = hashum % hashmap->bucket_count;
+    uint64_t hashum = hashmap_hash(key);
+    uint64_t hash = hashmap_index(hashum, hashmap->bucket_count);
+    uint64_t probes = 0;
     for (struct hashmap_bucket_entry* bucket = hashmap->buckets[hash]; bucket != NULL; bucket = bucket->next) {
+        probes++;
         if (bucket->umod_hash == hashum && (key == bucket->key || (key != NULL && strcmp(bucket->key, key) == 0))) {
+            HASH_LOOKUP(hashmap, probes, 1);
             return bucket->data;
         }
     }
+    HASH_LOOKUP(hashmap, probes, 0);
     return NULL;
 }
 
 void* hashmap_getptr(struct hashmap* hashmap, void* key) {
-    uint64_t hash = (uint64_t)key % hashmap->bucket_count;
+    uint64_t hash = hashmap_ptr_index((uint64_t) key, hashmap->bucket_count);
+    uint64_t probes = 0;
     for (struct hashmap_bucket_entry* bucket = hashmap->buckets[hash]; bucket != NULL; bucket = bucket->next) {
+        probes++;
         if (bucket->umod_hash == key && bucket->key == NULL) {
+            HASH_LOOKUP(hashmap, probes, 1);
             return bucket->data;
         }
     }
+    HASH_LOOKUP(hashmap, probes, 0);
     return NULL;
 }
 
 int hashset_has(struct hashset* set, char* key) {
-    uint64_t hashum = hashmap_hash(key, set->bucket_count);
-    uint64_t hash = hashum % set->bucket_count;
+    uint64_t hashum = hashmap_hash(key);
+    uint64_t hash = hashmap_index(hashum, set->bucket_count);
+    uint64_t probes = 0;
     for (struct hashset_bucket_entry* bucket = set->buckets[hash]; bucket != NULL; bucket = bucket->next) {
+        probes++;
         if (bucket->umod_hash == hashum && strcmp(bucket->key, key) == 0) {
+            HASH_LOOKUP(set, probes, 1);
             return 1;
         }
     }
+    HASH_LOOKUP(set, probes, 0);
     return 0;
 }
 
 int hashset_hasptr(struct hashset* set, void* key) {
-    uint64_t hash = (uint64_t)key % set->bucket_count;
+    uint64_t hash = hashmap_ptr_index((uint64_t) key, set->bucket_count);
+    uint64_t probes = 0;
     for (struct hashset_bucket_entry* bucket = set->buckets[hash]; bucket != NULL; bucket = bucket->next) {
+        probes++;
         if (bucket->key == key) {
+            HASH_LOOKUP(set, probes, 1);
             return 1;
         }
     }
+    HASH_LOOKUP(set, probes, 0);
     return 0;
 }
 
 void hashmap_put(struct hashmap* hashmap, char* key, void* data) {
-    uint64_t hashum = hashmap_hash(key, hashmap->bucket_count);
-    uint64_t hash = hashum % hashmap->bucket_count;
+    uint64_t hashum = hashmap_hash(key);
+    uint64_t hash = hashmap_index(hashum, hashmap->bucket_count);
     struct hashmap_bucket_entry* bucket = hashmap->buckets[hash];
     if (bucket == NULL) {
-        bucket = smalloc(sizeof(struct hashmap_bucket_entry));
+        bucket = smallocTag(sizeof(struct hashmap_bucket_entry), SMEM_TAG_HASHMAP);
         bucket->umod_hash = hashum;
         bucket->next = NULL;
         bucket->key = key;
         bucket->data = data;
         hashmap->buckets[hash] = bucket;
         hashmap->entry_count++;
+        HASH_INSERT(hashmap);
         goto putret;
     }
     for (; bucket != NULL; bucket = bucket->next) {
@@ -141,13 +275,14 @@ void hashmap_put(struct hashmap* hashmap, char* key, void* data) {
             bucket->data = data;
             break;
         } else if (bucket->next == NULL) {
-            struct hashmap_bucket_entry* bucketc = smalloc(sizeof(struct hashmap_bucket_entry));
+            struct hashmap_bucket_entry* bucketc = smallocTag(sizeof(struct hashmap_bucket_entry), SMEM_TAG_HASHMAP);
             bucketc->umod_hash = hashum;
             bucketc->next = NULL;
             bucketc->key = key;
             bucketc->data = data;
             bucket->next = bucketc;
             hashmap->entry_count++;
+            HASH_INSERT(hashmap);
             break;
        }
     }
@@ -156,16 +291,17 @@ void hashmap_put(struct hashmap* hashmap, char* key, void* data) {
 }
 
 void hashmap_putptr(struct hashmap* hashmap, void* key, void* data) {
-    uint64_t hash = (uint64_t)key % hashmap->bucket_count;
+    uint64_t hash = hashmap_ptr_index((uint64_t) key, hashmap->bucket_count);
     struct hashmap_bucket_entry* bucket = hashmap->buckets[hash];
     if (bucket == NULL) {
-        bucket = smalloc(sizeof(struct hashmap_bucket_entry));
+        bucket = smallocTag(sizeof(struct hashmap_bucket_entry), SMEM_TAG_HASHMAP);
         bucket->umod_hash = key;
         bucket->next = NULL;
         bucket->key = NULL;
         bucket->data = data;
         hashmap->buckets[hash] = bucket;
         hashmap->entry_count++;
+        HASH_INSERT(hashmap);
         goto putret;
     }
     for (; bucket != NULL; bucket = bucket->next) {
@@ -173,13 +309,14 @@ void hashmap_putptr(struct hashmap* hashmap, void* key, void* data) {
             bucket->data = data;
             break;
         } else if (bucket->next == NULL) {
-            struct hashmap_bucket_entry* bucketc = smalloc(sizeof(struct hashmap_bucket_entry));
+            struct hashmap_bucket_entry* bucketc = smallocTag(sizeof(struct hashmap_bucket_entry), SMEM_TAG_HASHMAP);
             bucketc->umod_hash = key;
             bucketc->next = NULL;
             bucketc->key = NULL;
             bucketc->data = data;
             bucket->next = bucketc;
             hashmap->entry_count++;
+            HASH_INSERT(hashmap);
             break;
        }
     }
@@ -190,12 +327,13 @@ void hashmap_putptr(struct hashmap* hashmap, void* key, void* data) {
 void hashmap_fixcap(struct hashmap* hashmap) {
     if ((hashmap->entry_count / hashmap->bucket_count) > 4) {
         size_t nbuck_count = hashmap->bucket_count * 2;
-        hashmap->buckets = srealloc(hashmap->buckets, nbuck_count * sizeof(struct hashmap_bucket_entry*));
+        HASH_RESIZE(hashmap, nbuck_count);
+        hashmap->buckets = sreallocTag(hashmap->buckets, nbuck_count * sizeof(struct hashmap_bucket_entry*), SMEM_TAG_HASHMAP);
         memset((void*)hashmap->buckets + (hashmap->bucket_count * sizeof(struct hashmap_bucket_entry*)), 0, hashmap->bucket_count * sizeof(struct hashmap_bucket_entry*));
         for (size_t i = 0; i < hashmap->bucket_count; i++) {
             struct hashmap_bucket_entry* lbucket = NULL; 
             for (struct hashmap_bucket_entry* bucket = hashmap->buckets[i]; bucket != NULL;) {
-                size_t ni = bucket->umod_hash % nbuck_count;
+                size_t ni = bucket->key == NULL ? hashmap_ptr_index(bucket->umod_hash, nbuck_count) : hashmap_index(bucket->umod_hash, nbuck_count);
                 if (ni == i) {
                     lbucket = bucket;
                     bucket = bucket->next;
@@ -224,28 +362,30 @@ void hashmap_fixcap(struct hashmap* hashmap) {
 }
 
 void hashset_add(struct hashset* set, char* key) {
-    uint64_t hashum = hashmap_hash(key, set->bucket_count);
-    uint64_t hash = hashum % set->bucket_count;
+    uint64_t hashum = hashmap_hash(key);
+    uint64_t hash = hashmap_index(hashum, set->bucket_count);
     struct hashset_bucket_entry* bucket = set->buckets[hash];
     if (bucket == NULL) {
-        bucket = smalloc(sizeof(struct hashset_bucket_entry));
+        bucket = smallocTag(sizeof(struct hashset_bucket_entry), SMEM_TAG_HASHMAP);
         bucket->umod_hash = hashum;
         bucket->next = NULL;
         bucket->key = key;
         set->buckets[hash] = bucket;
         set->entry_count++;
+        HASH_INSERT(set);
         goto putret;
     }
     for (; bucket != NULL; bucket = bucket->next) {
         if (bucket->umod_hash == hashum && strcmp(bucket->key, key) == 0) {
             break;
         } else if (bucket->next == NULL) {
-            struct hashset_bucket_entry* bucketc = smalloc(sizeof(struct hashset_bucket_entry));
+            struct hashset_bucket_entry* bucketc = smallocTag(sizeof(struct hashset_bucket_entry), SMEM_TAG_HASHMAP);
             bucketc->umod_hash = hashum;
             bucketc->next = NULL;
             bucketc->key = key;
             bucket->next = bucketc;
             set->entry_count++;
+            HASH_INSERT(set);
             break;
        }
     }
@@ -254,27 +394,29 @@ void hashset_add(struct hashset* set, char* key) {
 }
 
 void hashset_addptr(struct hashset* set, void* key) {
-    uint64_t hash = (uint64_t)key % set->bucket_count;
+    uint64_t hash = hashmap_ptr_index((uint64_t) key, set->bucket_count);
     struct hashset_bucket_entry* bucket = set->buckets[hash];
     if (bucket == NULL) {
-        bucket = smalloc(sizeof(struct hashset_bucket_entry));
-        bucket->umod_hash = 0;
+        bucket = smallocTag(sizeof(struct hashset_bucket_entry), SMEM_TAG_HASHMAP);
+        bucket->umod_hash = (uint64_t) key;
         bucket->next = NULL;
         bucket->key = key;
         set->buckets[hash] = bucket;
         set->entry_count++;
+        HASH_INSERT(set);
         goto putret;
     }
     for (; bucket != NULL; bucket = bucket->next) {
         if (bucket->key == key) {
             break;
         } else if (bucket->next == NULL) {
-            struct hashset_bucket_entry* bucketc = smalloc(sizeof(struct hashset_bucket_entry));
-            bucketc->umod_hash = 0;
+            struct hashset_bucket_entry* bucketc = smallocTag(sizeof(struct hashset_bucket_entry), SMEM_TAG_HASHMAP);
+            bucketc->umod_hash = (uint64_t) key;
             bucketc->next = NULL;
             bucketc->key = key;
             bucket->next = bucketc;
             set->entry_count++;
+            HASH_INSERT(set);
             break;
        }
     }
@@ -285,12 +427,14 @@ void hashset_addptr(struct hashset* set, void* key) {
 void hashset_fixcap(struct hashset* set) {
     if ((set->entry_count / set->bucket_count) > 4) {
         size_t nbuck_count = set->bucket_count * 2;
-        set->buckets = srealloc(set->buckets, nbuck_count * sizeof(struct hashset_bucket_entry*));
+        HASH_RESIZE(set, nbuck_count);
+        set->buckets = sreallocTag(set->buckets, nbuck_count * sizeof(struct hashset_bucket_entry*), SMEM_TAG_HASHMAP);
         memset((void*)set->buckets + (set->bucket_count * sizeof(struct hashset_bucket_entry*)), 0, set->bucket_count * sizeof(struct hashset_bucket_entry*));
         for (size_t i = 0; i < set->bucket_count; i++) {
             struct hashset_bucket_entry* lbucket = NULL;
             for (struct hashset_bucket_entry* bucket = set->buckets[i]; bucket != NULL;) {
-                size_t ni = bucket->umod_hash % nbuck_count;
+                // pointer keys are their own hash
+                size_t ni = bucket->umod_hash == (uint64_t) bucket->key ? hashmap_ptr_index(bucket->umod_hash, nbuck_count) : hashmap_index(bucket->umod_hash, nbuck_count);
                 if (ni == i) {
                     lbucket = bucket;
                     bucket = bucket->next;
@@ -319,12 +463,17 @@ void hashset_fixcap(struct hashset* set) {
 }
 
 struct hashmap* hashmap_clone(struct hashmap* hashmap) {
+#ifdef HASH_STATS
+    // counted where the original was made
+    struct hashmap* newmap = new_hashmap_at(hashmap->bucket_count, hashmap->site->site);
+#else
     struct hashmap* newmap = new_hashmap(hashmap->bucket_count);
+#endif
     for (size_t i = 0; i < hashmap->bucket_count; i++) {
         if (hashmap->buckets[i] == NULL) continue;
         struct hashmap_bucket_entry** newbucket = &newmap->buckets[i];
         for (struct hashmap_bucket_entry* bucket = hashmap->buckets[i]; bucket != NULL; bucket = bucket->next) {
-            (*newbucket) = scalloc(sizeof(struct hashmap_bucket_entry));
+            (*newbucket) = scallocTag(sizeof(struct hashmap_bucket_entry), SMEM_TAG_HASHMAP);
             (*newbucket)->data = bucket->data;
             (*newbucket)->key = bucket->key;
             (*newbucket)->umod_hash = bucket->umod_hash;
@@ -17,10 +17,33 @@ struct hashset_bucket_entry {
     struct hashset_bucket_entry* next;
 };
 
+#ifdef HASH_STATS
+
+// usage of every map and set created at one source line, only kept when built with HASH_STATS
+struct hash_site {
+    const char* site; // file:line of the new_hashmap or new_hashset call
+    uint8_t set;
+    uint64_t tables;
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t probes; // chain entries compared by lookups
+    uint64_t max_probe;
+    uint64_t inserts;
+    uint64_t resizes;
+    uint64_t max_entries; // of the largest table
+    uint64_t max_buckets;
+    struct hash_site* next;
+};
+
+#endif
+
 struct hashmap {
     size_t entry_count;
     size_t bucket_count;
     struct hashmap_bucket_entry** buckets;
+#ifdef HASH_STATS
+    struct hash_site* site;
+#endif
 };
 
 #define ITER_MAP(map) {for (size_t bucket_i = 0; bucket_i < map->bucket_count; bucket_i++) { for (struct hashmap_bucket_entry* bucket_entry = map->buckets[bucket_i]; bucket_entry != NULL; bucket_entry = bucket_entry->next) { char* str_key = bucket_entry->key; void* ptr_key = (void*)bucket_entry->umod_hash; void* value = bucket_entry->data;
@@ -31,16 +54,38 @@ struct hashset {
     size_t entry_count;
     size_t bucket_count;
     struct hashset_bucket_entry** buckets;
+#ifdef HASH_STATS
+    struct hash_site* site;
+#endif
 };
 
 #define ITER_SET(set) {for (size_t bucket_i = 0; bucket_i < set->bucket_count; bucket_i++) { for (struct hashset_bucket_entry* bucket_entry = set->buckets[bucket_i]; bucket_entry != NULL; bucket_entry = bucket_entry->next) { char* str_key = bucket_entry->key; void* ptr_key = (void*)bucket_entry->umod_hash;
 
 #define ITER_SET_END() }}}
 
+#ifdef HASH_STATS
+
+#define HASH_SITE_STR(x) #x
+#define HASH_SITE_LINE(x) HASH_SITE_STR(x)
+
+struct hashmap* new_hashmap_at(size_t init_cap, const char* site);
+
+struct hashset* new_hashset_at(size_t init_cap, const char* site);
+
+#define new_hashmap(init_cap) new_hashmap_at(init_cap, __FILE__ ":" HASH_SITE_LINE(__LINE__))
+#define new_hashset(init_cap) new_hashset_at(init_cap, __FILE__ ":" HASH_SITE_LINE(__LINE__))
+
+#else
+
 struct hashmap* new_hashmap(size_t init_cap);
 
 struct hashset* new_hashset(size_t init_cap);
 
+#endif
+
+// per creation site table of lookups, probe lengths and resizes. prints nothing unless built with HASH_STATS.
+void print_hash_stats(int fd);
+
 void free_hashmap(struct hashmap* hashmap);
 
 void free_hashset(struct hashset* set);
@@ -63,4 +108,12 @@ void hashset_addptr(struct hashset* set, void* key);
 
 struct hashmap* hashmap_clone(struct hashmap* hashmap);
 
+// key hash of string entries, fast rather than thorough: the key is xored together 8 bytes at a time
+uint64_t hashmap_hash(char* key);
+
+#define FNV1A_64_INIT 0xcbf29ce484222325ULL
+
+// content fingerprints, unlike hashmap_hash every byte counts. chain calls by passing the previous result.
+uint64_t fnv1a_64(const void* data, size_t len, uint64_t hash);
+
 #endif
\ No newline at end of file
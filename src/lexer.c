@@ -4,9 +4,9 @@
 #include "smem.h"
 #include "xstring.h"
 
-#define ADD_TOKEN(typex, start, end) {struct token* token = smalloc(sizeof(struct token));\
+#define ADD_TOKEN(typex, start, end) {struct token* token = smallocTag(sizeof(struct token), SMEM_TAG_TOKEN);\
 size_t buflen = (end) - (start);\
-token->value = smalloc(buflen + 1);\
+token->value = smallocTag(buflen + 1, SMEM_TAG_STRING);\
 memcpy(token->value, (source) + (start), buflen);\
 token->value[buflen] = 0;\
 token->type = typex;\
@@ -460,7 +460,7 @@ void tokenize(char* source, size_t src_len, struct arraylist* tokens) {
                 goto main_default;
                 case 'r':
                 if (token_len == 3 && str_startsWithCase(source + i + 1, "et")) {
-                    ADD_TOKEN(TOKEN_RET, i, i + 6);
+                    ADD_TOKEN(TOKEN_RET, i, i + 3);
                     break;
                 }
                 goto main_default;
@@ -5,12 +5,29 @@
 #include "streams.h"
 #include "info.h"
 #include "prog_ir.h"
+#include "prog_reach.h"
+#include "prog_incr.h"
+#include "prog_iface.h"
+#include "prog_flexir.h"
+#include "time_report.h"
+#include "trace.h"
+#include "flexir.h"
+#include "daemon.h"
+#include "ast_cache.h"
+#include "cli.h"
+#include "hash.h"
+#include "task_pool.h"
+#include "smem.h"
 #include <unistd.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <math.h>
 
 #define FLEX_HELP "See flexc -h for more information.\n"
 
@@ -25,38 +42,134 @@
 struct input_file {
     char* filename;
     char* rel_path;
+    void* content;
+    size_t content_len;
+    uint64_t content_hash; // of the file as read, before lines are split
+    struct stat stat; // when it was read, to tell whether a cached copy is stale
     struct arraylist* lines;
     struct arraylist* tokens;
     struct ast_node* root;
     struct parse_ctx* parse_ctx;
+    struct ast_cache_map ast_map; // backs the strings of an AST loaded from the cache, tokens stay NULL then
+    uint8_t cached; // owned by input_cache
+    uint8_t lazy_bodies; // parsed with --lazy-bodies
 };
 
-struct ast_node* print_ast(struct ast_node* node, int fd) {
-    dprintf(fd, "%lu<%lu>-%lu<%lu> %s:\n", node->start_line, node->start_col, node->end_line, node->end_col, AST_TYPE_NAMES[node->type]);
+// -olex and -oast output, as text or as one json object per line
+struct dump_ctx {
+    struct out_stream* out;
+    uint8_t json;
+    uint64_t index; // of the next AST node in its file, as -oir numbers them
+};
+
+void _dump_key(struct dump_ctx* ctx, char* label, char* key) {
+    if (ctx->json) {
+        outWrite(ctx->out, ",\"", 2);
+        outPuts(ctx->out, key);
+        outWrite(ctx->out, "\":", 2);
+    } else {
+        outPuts(ctx->out, label);
+        outWrite(ctx->out, " = ", 3);
+    }
+}
+
+void _dump_end_field(struct dump_ctx* ctx) {
+    if (!ctx->json) outPutc(ctx->out, '\n');
+}
+
+void dump_u64(struct dump_ctx* ctx, char* label, char* key, uint64_t value) {
+    _dump_key(ctx, label, key);
+    outU64(ctx->out, value);
+    _dump_end_field(ctx);
+}
+
+// quote only applies to text, json strings are always quoted
+void dump_str(struct dump_ctx* ctx, char* label, char* key, const char* value, char quote) {
+    _dump_key(ctx, label, key);
+    if (ctx->json) {
+        outJsonString(ctx->out, value);
+    } else {
+        if (quote) outPutc(ctx->out, quote);
+        outPuts(ctx->out, value == NULL ? "(null)" : value);
+        if (quote) outPutc(ctx->out, quote);
+    }
+    _dump_end_field(ctx);
+}
+
+void dump_count(struct dump_ctx* ctx, char* label, char* key, struct arraylist* list) {
+    dump_u64(ctx, label, key, list == NULL ? 0 : list->entry_count);
+}
+
+void dump_file_header(struct dump_ctx* ctx, struct input_file* input, char* text_sep) {
+    if (ctx->json) {
+        outPuts(ctx->out, "{\"kind\":\"file\",\"file\":");
+        outJsonString(ctx->out, input->filename);
+        outPuts(ctx->out, ",\"path\":");
+        outJsonString(ctx->out, input->rel_path);
+        outPuts(ctx->out, ",\"lines\":");
+        outU64(ctx->out, input->lines->entry_count);
+        outPuts(ctx->out, "}\n");
+    } else {
+        outPuts(ctx->out, "File: ");
+        outPuts(ctx->out, input->filename);
+        outPuts(ctx->out, text_sep);
+        outU64(ctx->out, input->lines->entry_count);
+    }
+}
+
+int dump_ast_node(struct ast_node* node, void* arg) {
+    struct dump_ctx* ctx = arg;
+    struct out_stream* out = ctx->out;
+    if (ctx->json) {
+        outPuts(out, "{\"kind\":\"node\",\"index\":");
+        outU64(out, ctx->index);
+        outPuts(out, ",\"type\":\"");
+        outPuts(out, AST_TYPE_NAMES[node->type]);
+        outPuts(out, "\",\"start_line\":");
+        outU64(out, node->start_line);
+        outPuts(out, ",\"start_col\":");
+        outU64(out, node->start_col);
+        outPuts(out, ",\"end_line\":");
+        outU64(out, node->end_line);
+        outPuts(out, ",\"end_col\":");
+        outU64(out, node->end_col);
+    } else {
+        outU64(out, node->start_line);
+        outPutc(out, '<');
+        outU64(out, node->start_col);
+        outWrite(out, ">-", 2);
+        outU64(out, node->end_line);
+        outPutc(out, '<');
+        outU64(out, node->end_col);
+        outWrite(out, "> ", 2);
+        outPuts(out, AST_TYPE_NAMES[node->type]);
+        outWrite(out, ":\n", 2);
+    }
+    ctx->index++;
     switch (node->type) {
         case AST_NODE_BINARY:
-        dprintf(fd, "OP = %s\n", BINARY_OP_NAMES[node->data.binary.op]);
+        dump_str(ctx, "OP", "op", BINARY_OP_NAMES[node->data.binary.op], 0);
         break;
         case AST_NODE_BODY:
-        dprintf(fd, "expr# = %lu\n", node->data.body.children == NULL ? 0 : node->data.body.children->entry_count);
+        dump_count(ctx, "expr#", "exprs", node->data.body.children);
         break;
         case AST_NODE_CALC_MEMBER:
         break;
         case AST_NODE_CALL:
-        dprintf(fd, "arg# = %lu\n", node->data.call.parameters == NULL ? 0 : node->data.call.parameters->entry_count);
+        dump_count(ctx, "arg#", "args", node->data.call.parameters);
         break;
         case AST_NODE_CASE:
         break;
         case AST_NODE_CAST:
         break;
         case AST_NODE_CLASS:
-        dprintf(fd, "prot = %s\n", PROT_STRING[node->data.class.prot]);
-        dprintf(fd, "synch = %u\n", node->data.class.synch);
-        dprintf(fd, "iface = %u\n", node->data.class.iface);
-        dprintf(fd, "typed = %u\n", node->data.class.typed);
-        dprintf(fd, "virt = %u\n", node->data.class.virt);
-        dprintf(fd, "name = %s\n", node->data.class.name);
-        dprintf(fd, "extends# = %lu\n", node->data.class.parents == NULL ? 0 : node->data.class.parents->entry_count);
+        dump_str(ctx, "prot", "prot", PROT_STRING[node->flags.prot], 0);
+        dump_u64(ctx, "synch", "synch", node->flags.synch);
+        dump_u64(ctx, "iface", "iface", node->flags.iface);
+        dump_u64(ctx, "pure", "pure", node->flags.pure);
+        dump_u64(ctx, "virt", "virt", node->flags.virt);
+        dump_str(ctx, "name", "name", node->data.class.name == NULL ? NULL : node->data.class.name->data.type.name, 0);
+        dump_count(ctx, "extends#", "extends", node->data.class.parents);
         break;
         case AST_NODE_DEFAULT_CASE:
         break;
@@ -67,31 +180,40 @@ struct ast_node* print_ast(struct ast_node* node, int fd) {
         case AST_NODE_FOR_EACH:
         break;
         case AST_NODE_FUNC:
-        dprintf(fd, "prot = %s\n", PROT_STRING[node->data.func.prot]);
-        dprintf(fd, "synch = %u\n", node->data.func.synch);
-        dprintf(fd, "virt = %u\n", node->data.func.virt);
-        dprintf(fd, "name = %s\n", node->data.func.name);
-        dprintf(fd, "arg# = %lu\n", node->data.func.arguments == NULL ? 0 : node->data.func.arguments->entry_count);
+        dump_str(ctx, "prot", "prot", PROT_STRING[node->flags.prot], 0);
+        dump_u64(ctx, "synch", "synch", node->flags.synch);
+        dump_u64(ctx, "virt", "virt", node->flags.virt);
+        dump_str(ctx, "name", "name", node->data.func.name, 0);
+        dump_count(ctx, "arg#", "args", node->data.func.arguments);
         break;
         case AST_NODE_GOTO:
         break;
         case AST_NODE_IF:
         break;
         case AST_NODE_MODULE:
-        dprintf(fd, "prot = %s\n", PROT_STRING[node->data.module.prot]);
-        dprintf(fd, "name = ");
+        dump_str(ctx, "prot", "prot", PROT_STRING[node->flags.prot], 0);
+        _dump_key(ctx, "name", "name");
+        if (ctx->json) outPutc(out, '"');
         for (size_t i = 0; i < node->data.module.name_list->entry_count; i++) {
-            dprintf(fd, "%s%s", i == 0 ? "" : ".", arraylist_getptr(node->data.module.name_list, i));
+            if (i > 0) outPutc(out, '.');
+            if (ctx->json) {
+                outJsonEscaped(out, arraylist_getptr(node->data.module.name_list, i));
+            } else {
+                outPuts(out, arraylist_getptr(node->data.module.name_list, i));
+            }
         }
-        dprintf(fd, "\n");
+        if (ctx->json) outPutc(out, '"');
+        _dump_end_field(ctx);
         break;
         case AST_NODE_NEW:
         break;
         case AST_NODE_RET:
-        dprintf(fd, "has ret = %s\n", node->data.ret.expr == NULL ? "false" : "true");
+        _dump_key(ctx, "has ret", "has_ret");
+        outPuts(out, node->data.ret.expr == NULL ? "false" : "true");
+        _dump_end_field(ctx);
         break;
         case AST_NODE_SWITCH:
-        dprintf(fd, "case# = %lu\n", node->data._switch.cases == NULL ? 0 : node->data._switch.cases->entry_count);
+        dump_count(ctx, "case#", "cases", node->data._switch.cases);
         break;
         case AST_NODE_TERNARY:
         break;
@@ -100,62 +222,115 @@ struct ast_node* print_ast(struct ast_node* node, int fd) {
         case AST_NODE_TRY:
         break;
         case AST_NODE_TYPE:
-        dprintf(fd, "ptr# = %lu\n", node->data.type.array_pointer_count);
-        dprintf(fd, "ptr = %o\n", node->data.type.array_pointer_bitlist);
-        dprintf(fd, "generic# = %lu\n", node->data.type.generics == NULL ? 0 : node->data.type.generics->entry_count);
-        dprintf(fd, "name = %s\n", node->data.type.name);
+        dump_u64(ctx, "array#", "array_dims", node->flags.array_dimensonality);
+        dump_u64(ctx, "ref", "ref", node->flags.is_ref);
+        dump_count(ctx, "generic#", "generics", node->data.type.generics);
+        dump_str(ctx, "name", "name", node->data.type.name, 0);
         break;
         case AST_NODE_INTEGER_LIT:
-        dprintf(fd, "int = %lu\n", node->data.integer_lit.lit);
+        dump_u64(ctx, "int", "int", node->data.integer_lit.lit);
         break;
-        case AST_NODE_DECIMAL_LIT:
-        dprintf(fd, "double = %f\n", node->data.decimal_lit.lit);
+        case AST_NODE_DECIMAL_LIT:;
+        char decimal[64];
+        _dump_key(ctx, "double", "double");
+        if (ctx->json && !isfinite(node->data.decimal_lit.lit)) {
+            outPuts(out, "null");
+        } else {
+            snprintf(decimal, sizeof(decimal), ctx->json ? "%.17g" : "%f", node->data.decimal_lit.lit);
+            outPuts(out, decimal);
+        }
+        _dump_end_field(ctx);
         break;
         case AST_NODE_STRING_LIT:
-        dprintf(fd, "string = \"%s\"\n", node->data.string_lit.lit);
+        dump_str(ctx, "string", "string", node->data.string_lit.lit, '"');
         break;
         case AST_NODE_CHAR_LIT:
-        dprintf(fd, "char = '%s'\n", node->data.char_lit.lit);
+        dump_str(ctx, "char", "char", node->data.char_lit.lit, '\'');
         break;
         case AST_NODE_IDENTIFIER:
-        dprintf(fd, "ident = %s\n", node->data.identifier.identifier);
+        dump_str(ctx, "ident", "ident", node->data.identifier.identifier, 0);
         break;
         case AST_NODE_UNARY:
-        dprintf(fd, "OP = %s\n", UNARY_OP_NAMES[node->data.unary.unary_op]);
+        dump_str(ctx, "OP", "op", UNARY_OP_NAMES[node->data.unary.unary_op], 0);
         break;
         case AST_NODE_UNARY_POSTFIX:
-        dprintf(fd, "OP = %s\n", UNARY_OP_NAMES[node->data.unary_postfix.unary_op]);
+        dump_str(ctx, "OP", "op", UNARY_OP_NAMES[node->data.unary_postfix.unary_op], 0);
         break;
         case AST_NODE_VAR_DECL:
-        dprintf(fd, "prot = %s\n", PROT_STRING[node->data.vardecl.prot]);
-        dprintf(fd, "synch = %u\n", node->data.vardecl.synch);
-        dprintf(fd, "csig = %u\n", node->data.vardecl.csig);
-        dprintf(fd, "name = %s\n", node->data.vardecl.name);
+        dump_str(ctx, "prot", "prot", PROT_STRING[node->flags.prot], 0);
+        dump_u64(ctx, "synch", "synch", node->flags.synch);
+        dump_u64(ctx, "csig", "csig", node->flags.csig);
+        dump_str(ctx, "name", "name", node->data.vardecl.name, 0);
         break;
         case AST_NODE_WHILE:
         break;
         case AST_NODE_LABEL:
-        dprintf(fd, "label = %s\n", node->data.identifier.identifier);
+        dump_str(ctx, "label", "label", node->data.identifier.identifier, 0);
         break;
         case AST_NODE_CONTINUE:
         break;
         case AST_NODE_BREAK:;
         break;
         case AST_NODE_IMP_NEW:;
-        dprintf(fd, "arg# = %lu\n", node->data.imp_new.parameters == NULL ? 0 : node->data.imp_new.parameters->entry_count);
+        dump_count(ctx, "arg#", "args", node->data.imp_new.parameters);
         break;
         case AST_NODE_IMPORT:;
+        break;
+        case AST_NODE_LAZY_BODY:
+        dump_u64(ctx, "token#", "tokens", node->data.lazy_body.token_count);
+        break;
     }
-    return node;
+    if (ctx->json) outWrite(out, "}\n", 2);
+    return AST_VISIT_CONTINUE;
 }
 
-int main(int argc, char* argv[]) {
-    char* outputPE = NULL;
-    char* outputLex = NULL;
-    char* outputAST = NULL;
-    char* outputIR = NULL;
-    char* input_files[argc];
-    int input_file_count = 0;
+void dump_ast_file(struct dump_ctx* ctx, struct input_file* input) {
+    dump_file_header(ctx, input, ", Line#: ");
+    if (!ctx->json) outPutc(ctx->out, '\n');
+    ctx->index = 0;
+    struct ast_visitor visitor = {dump_ast_node, NULL, ctx};
+    visit_node(input->root, &visitor);
+}
+
+// text lines end in CRLF like writeLine wrote them
+void dump_lex_file(struct dump_ctx* ctx, struct input_file* input) {
+    struct out_stream* out = ctx->out;
+    dump_file_header(ctx, input, ", Line# ");
+    if (!ctx->json) outWrite(out, "\r\n", 2);
+    for (size_t j = 0; j < input->tokens->entry_count; j++) {
+        struct token* token = arraylist_getptr(input->tokens, j);
+        if (ctx->json) {
+            outPuts(out, "{\"kind\":\"token\",\"line\":");
+            outU64(out, token->line);
+            outPuts(out, ",\"start_col\":");
+            outU64(out, token->start_col);
+            outPuts(out, ",\"end_col\":");
+            outU64(out, token->end_col);
+            outPuts(out, ",\"type\":");
+            outU64(out, token->type);
+            outPuts(out, ",\"value\":");
+            outJsonString(out, token->value);
+            outWrite(out, "}\n", 2);
+        } else {
+            outU64(out, token->line);
+            outPutc(out, '<');
+            outU64(out, token->start_col);
+            outPutc(out, '-');
+            outU64(out, token->end_col);
+            outWrite(out, ">, ", 3);
+            outU64(out, token->type);
+            outWrite(out, ": ", 2);
+            outPuts(out, token->value);
+            outWrite(out, "\r\n", 2);
+        }
+    }
+}
+
+// returns 0 to go on, 1 after printing an error
+int parse_cli(int argc, char* argv[], struct cli_options* opts) {
+    memset(opts, 0, sizeof(struct cli_options));
+    opts->thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    opts->input_files = smalloc(sizeof(char*) * (argc + 1));
     for (int i = 1; i < argc; i++) {
         char* arg = argv[i];
         if (arg[0] == '-') {
@@ -169,115 +344,629 @@ int main(int argc, char* argv[]) {
                     MISSING_ARG(arg - 1);
                 }
                 char* arg2 = argv[++i];
-                outputPE = arg2;
+                opts->outputPE = arg2;
             } else if (str_eq(arg, "olex") || str_eq(arg, "-out-lex")) {
                 if (i >= argc - 1) {
                     MISSING_ARG(arg - 1);
                 }
                 char* arg2 = argv[++i];
-                outputLex = arg2;
+                opts->outputLex = arg2;
             } else if (str_eq(arg, "oast") || str_eq(arg, "-out-ast")) {
                 if (i >= argc - 1) {
                     MISSING_ARG(arg - 1);
                 }
                 char* arg2 = argv[++i];
-                outputAST = arg2;
+                opts->outputAST = arg2;
             } else if (str_eq(arg, "oir") || str_eq(arg, "-out-ir")) {
                 if (i >= argc - 1) {
                     MISSING_ARG(arg - 1);
                 }
                 char* arg2 = argv[++i];
-                outputIR = arg2;
+                opts->outputIR = arg2;
+            } else if (str_eq(arg, "-out-dir")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->out_dir = arg2;
+            } else if (str_eq(arg, "-dump-format")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                if (str_eq(arg2, "ndjson")) {
+                    opts->dump_json = 1;
+                } else if (str_eq(arg2, "text")) {
+                    opts->dump_json = 0;
+                } else {
+                    INVALID_ARG(arg2);
+                }
+            } else if (str_eq(arg, "-dump-ir")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->dump_ir = arg2;
+            } else if (str_eq(arg, "j") || str_eq(arg, "-jobs")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->thread_count = strtol(arg2, NULL, 10);
+                if (opts->thread_count < 1) INVALID_ARG(arg2);
+            } else if (str_eq(arg, "inc") || str_eq(arg, "-incremental")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->incremental = arg2;
+            } else if (str_eq(arg, "-ast-cache")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->ast_cache = arg2;
+            } else if (str_eq(arg, "-emit-interface")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->emit_interface = arg2;
+            } else if (str_eq(arg, "I") || str_eq(arg, "-interface-path")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->iface_path = arg2;
+            } else if (str_eq(arg, "-daemon")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->daemon = arg2;
+            } else if (str_eq(arg, "-connect")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->connect = arg2;
+            } else if (str_eq(arg, "-time-report") || str_eq(arg, "-time-report=text") || str_eq(arg, "-time-report=json")) {
+                opts->time_report = 1;
+                opts->time_report_json = str_eq(arg, "-time-report=json");
+            } else if (str_startsWith(arg, "-trace=")) {
+                opts->trace = arg + 7;
+            } else if (str_eq(arg, "-trace")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->trace = arg2;
+            } else if (str_eq(arg, "-time-report-out")) {
+                if (i >= argc - 1) {
+                    MISSING_ARG(arg - 1);
+                }
+                char* arg2 = argv[++i];
+                opts->time_report_out = arg2;
+                opts->time_report = 1;
+            } else if (str_eq(arg, "-perf-counters")) {
+                opts->perf_counters = 1;
+                opts->time_report = 1;
+            } else if (str_eq(arg, "check-all") || str_eq(arg, "-check-all")) {
+                opts->check_all = 1;
+            } else if (str_eq(arg, "prune-report") || str_eq(arg, "-prune-report")) {
+                opts->prune_report = 1;
+            } else if (str_eq(arg, "-lazy-bodies")) {
+                opts->lazy_bodies = 1;
+            } else if (str_eq(arg, "-mem-report")) {
+                opts->mem_report = 1;
+            } else if (str_eq(arg, "stats") || str_eq(arg, "-stats")) {
+                opts->print_stats = 1;
             } else {
                 INVALID_ARG(arg - 1);
             }
         } else {
-            input_files[input_file_count++] = arg;
+            opts->input_files[opts->input_file_count++] = arg;
         }
     }
-    if (input_file_count == 0) {
+    if (opts->daemon != NULL || opts->connect != NULL || opts->dump_ir != NULL) return 0;
+    if (opts->input_file_count == 0) {
         CLI_ERROR("No input specified.");
     }
-    if (outputPE == NULL && outputLex == NULL && outputAST == NULL && outputIR == NULL) {
+    if (opts->outputPE == NULL && opts->outputLex == NULL && opts->outputAST == NULL && opts->outputIR == NULL && opts->emit_interface == NULL) {
         CLI_ERROR("No output specified.");
     }
-    struct {
-        char* filename;
-        void* content;
-        size_t length;
-    } input_contents[input_file_count];
-
-    for (int i = 0; i < input_file_count; i++) {
-        char* file = input_files[i];
-        int fd = open(file, O_RDONLY);
-        if (fd < 0) {
-            IO_ERROR(file);
+    // unchanged modules are not analyzed and nothing restores their results, their IR would come out untyped
+    if (opts->incremental != NULL && opts->outputIR != NULL) {
+        CLI_ERROR("Invalid Argument: --incremental cannot be combined with -oir yet.");
+    }
+    // unchanged files are not lexed or parsed again either, their trees come from a cache next to the store
+    if (opts->incremental != NULL && opts->ast_cache == NULL) {
+        opts->ast_cache_owned = smalloc(strlen(opts->incremental) + 5);
+        sprintf(opts->ast_cache_owned, "%s.ast", opts->incremental);
+        opts->ast_cache = opts->ast_cache_owned;
+    }
+    return 0;
+}
+
+// frees everything the lex and parse phase allocated for a file, analysis memory is owned by the build
+void release_input(struct input_file* input) {
+    free_ast_node(input->root);
+    ast_cache_unmap(&input->ast_map);
+    if (input->tokens != NULL) {
+        for (size_t i = 0; i < input->tokens->entry_count; i++) {
+            struct token* token = arraylist_getptr(input->tokens, i);
+            free(token->value);
+            free(token);
         }
-        void* content = NULL;
-        ssize_t content_len = readUntilEnd(fd, &content);
+        arraylist_free(input->tokens);
+    }
+    if (input->parse_ctx != NULL) {
+        for (size_t i = 0; i < input->parse_ctx->parse_errors->entry_count; i++) {
+            struct parse_error* error = arraylist_getptr(input->parse_ctx->parse_errors, i);
+            free(error->message);
+            free(error);
+        }
+        arraylist_free(input->parse_ctx->parse_errors);
+        free(input->parse_ctx->tokens);
+        free(input->parse_ctx);
+    }
+    arraylist_free(input->lines);
+    free(input->content);
+    free(input->rel_path);
+    free(input);
+}
+
+// releases the inputs of a request that stops on errors. whatever made it into a daemon's cache stays there.
+void release_inputs(struct cli_options* opts, struct input_file** inputs) {
+    for (int i = 0; i < opts->input_file_count; i++) {
+        if (inputs[i] != NULL && !inputs[i]->cached) release_input(inputs[i]);
+        inputs[i] = NULL;
+    }
+}
+
+int _count_node(struct ast_node* node, void* arg) {
+    (void) node;
+    (*(uint64_t*) arg)++;
+    return AST_VISIT_CONTINUE;
+}
+
+void _load_phase_end(struct time_report_file* timing, uint8_t phase, struct time_mark* mark) {
+    uint64_t ns = time_phase_end(phase, mark);
+    if (timing != NULL) timing->phase_ns[phase] = ns;
+}
+
+// reads, lexes and parses a file. returns 1 on IO errors or corrupt input, lex and parse errors are only counted.
+// with ast_cache set, a file parsed before by this compiler version skips lexing and parsing entirely.
+// with lazy_bodies, braced func bodies are left for analysis to parse when it reaches them.
+int load_input(struct input_file* input, char* path, char* ast_cache, uint8_t lazy_bodies, int* lex_error_count, int* parse_error_count) {
+    TRACE_BEGIN(trace_start);
+    struct time_report_file* timing = time_report_add_file(path);
+    struct time_mark mark;
+    time_mark_now(&mark);
+    input->rel_path = str_dup(path, 0);
+    input->lazy_bodies = lazy_bodies;
+    input->filename = strrchr(input->rel_path, '/');
+    if (input->filename == NULL) {
+        input->filename = input->rel_path;
+    } else {
+        input->filename++;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        IO_ERROR(path);
+    }
+    if (fstat(fd, &input->stat) != 0) {
         close(fd);
-        if (content_len < 0) {
-            IO_ERROR(file);
+        IO_ERROR(path);
+    }
+    ssize_t content_len = readUntilEnd(fd, &input->content);
+    close(fd);
+    if (content_len < 0) {
+        IO_ERROR(path);
+    }
+    char* data = input->content;
+    size_t data_len = content_len;
+    input->content_len = content_len;
+    input->content_hash = fnv1a_64(data, data_len, FNV1A_64_INIT);
+    input->lines = arraylist_new(128, sizeof(char*));
+    if (timing != NULL) timing->bytes = data_len;
+    _load_phase_end(timing, TIME_PHASE_READ, &mark);
+    if (ast_cache != NULL) {
+        input->root = ast_cache_load(ast_cache, input->content_hash, data, data_len, input->lines, &input->ast_map);
+        time_phase_end(TIME_PHASE_AST_CACHE_LOAD, &mark);
+        if (input->root != NULL) {
+            input->root->data.file.filename = input->filename;
+            input->root->data.file.rel_path = input->rel_path;
+            if (timing != NULL) {
+                timing->cached = 1;
+                timing->lines = input->lines->entry_count;
+                struct ast_visitor visitor = {_count_node, NULL, &timing->nodes};
+                visit_node(input->root, &visitor);
+            }
+            TRACE_END(trace_start, "file", input->rel_path, "cached");
+            return 0;
+        }
+    }
+    uint32_t line = 1;
+    uint32_t column = 0;
+    input->tokens = arraylist_new(128, sizeof(struct token*));
+    arraylist_addptr(input->lines, data);
+    for (size_t i = 0; i < data_len; i++) {
+        column++;
+        if (data[i] == 0 || data[i] > 0x7F) {
+            CORRUPT_FILE_ERROR("Invalid character at %s:%u:%u: 0x%02X", input->rel_path COMMA line COMMA column COMMA data[i]);
+        } else if (data[i] == '\n') {
+            data[i] = 0;
+            line++;
+            column = 0;
+            arraylist_addptr(input->lines, data + i + 1);
         }
-        input_contents[i].filename = file;
-        input_contents[i].content = content;
-        input_contents[i].length = content_len;
     }
+    if (timing != NULL) timing->lines = input->lines->entry_count;
+    _load_phase_end(timing, TIME_PHASE_VALIDATE, &mark);
+    tokenize(data, data_len, input->tokens);
+    if (timing != NULL) timing->tokens = input->tokens->entry_count;
+    _load_phase_end(timing, TIME_PHASE_TOKENIZE, &mark);
+    int file_lex_errors = 0;
+    for (size_t j = 0; j < input->tokens->entry_count; j++) {
+        struct token* token = arraylist_getptr(input->tokens, j);
+        if (token->type == TOKEN_UNKNOWN) {
+            LEX_ERROR("Invalid symbol @ %s:%u<%u-%u>: %s", input->rel_path COMMA token->line COMMA token->start_col COMMA token->end_col COMMA token->value);
+            file_lex_errors++;
+        }
+    }
+    *lex_error_count += file_lex_errors;
+    if (*lex_error_count > 0) return 0;
+    struct parse_intermediates immed = parse(input->tokens, input->lines, lazy_bodies);
+    input->parse_ctx = immed.ctx;
+    input->root = immed.root;
+    _load_phase_end(timing, TIME_PHASE_PARSE, &mark);
+    if (timing != NULL) {
+        struct ast_visitor visitor = {_count_node, NULL, &timing->nodes};
+        visit_node(input->root, &visitor);
+        time_mark_now(&mark);
+    }
+    // a file that failed to parse has no root
+    if (input->parse_ctx->parse_errors->entry_count > 0) {
+        fprintf(stderr, "%lu errors found in file %s.\n", input->parse_ctx->parse_errors->entry_count, input->rel_path);
+        for (size_t i = 0; i < input->parse_ctx->parse_errors->entry_count; i++) {
+            struct parse_error* error = arraylist_getptr(input->parse_ctx->parse_errors, i);
+            fprintf(stderr, "%s\n", error->message);
+        }
+        *parse_error_count += input->parse_ctx->parse_errors->entry_count;
+        TRACE_END(trace_start, "file", input->rel_path, NULL);
+        return 0;
+    }
+    input->root->data.file.filename = input->filename;
+    input->root->data.file.rel_path = input->rel_path;
+    if (ast_cache != NULL && !lazy_bodies) {
+        // a tree with stubs in it is not the whole file
+        ast_cache_store(ast_cache, input->content_hash, data, data_len, input->lines, input->root);
+        time_phase_end(TIME_PHASE_AST_CACHE_STORE, &mark);
+    }
+    TRACE_END(trace_start, "file", input->rel_path, NULL);
+    return 0;
+}
 
-    struct input_file input_data[input_file_count];
-    int lex_error_count = 0;
-    int parse_error_count = 0;
-    struct arraylist* allfiles = arraylist_new(16, sizeof(struct ast_node*));
-    for (int i = 0; i < input_file_count; i++) {
-        struct input_file* input = &input_data[i];
-        input->filename = strrchr(input_contents[i].filename, '/');
-        if (input->filename == NULL) {
-            input->filename = input_contents[i].filename;
+// lexed and parsed files kept by a daemon between requests, by real path
+struct hashmap* input_cache = NULL;
+
+int _input_unchanged(struct input_file* input, struct stat* st) {
+    return input->stat.st_dev == st->st_dev && input->stat.st_ino == st->st_ino && input->stat.st_size == st->st_size && input->stat.st_mtim.tv_sec == st->st_mtim.tv_sec && input->stat.st_mtim.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+// like load_input, but reuses the daemon's copy of a file as long as it is unchanged on disk
+int load_cached_input(struct input_file** input, char* path, char* ast_cache, uint8_t lazy_bodies, int* lex_error_count, int* parse_error_count) {
+    char* key = realpath(path, NULL);
+    struct stat st;
+    if (key == NULL || stat(key, &st) != 0) {
+        free(key);
+        IO_ERROR(path);
+    }
+    struct input_file* cached = hashmap_get(input_cache, key);
+    if (cached != NULL && _input_unchanged(cached, &st) && cached->lazy_bodies == lazy_bodies) {
+        free(key);
+        if (!str_eq(cached->rel_path, path)) {
+            free(cached->rel_path);
+            cached->rel_path = str_dup(path, 0);
+            cached->filename = strrchr(cached->rel_path, '/');
+            cached->filename = cached->filename == NULL ? cached->rel_path : cached->filename + 1;
+            cached->root->data.file.filename = cached->filename;
+            cached->root->data.file.rel_path = cached->rel_path;
+        }
+        *input = cached;
+        return 0;
+    }
+    if (cached != NULL) {
+        hashmap_put(input_cache, key, NULL);
+        release_input(cached);
+    }
+    *input = scalloc(sizeof(struct input_file));
+    int prior_errors = *lex_error_count + *parse_error_count;
+    int status = load_input(*input, path, ast_cache, lazy_bodies, lex_error_count, parse_error_count);
+    // files with errors are loaded again next time, so their errors are reported again.
+    // a lex error in an earlier file skips parsing this one, which leaves no root to reuse.
+    if (status == 0 && *lex_error_count + *parse_error_count == prior_errors && (*input)->root != NULL) {
+        (*input)->cached = 1;
+        hashmap_put(input_cache, key, *input);
+    } else {
+        free(key);
+    }
+    return status;
+}
+
+// files rendered at once when concatenating, so memory stays bounded by a window instead of the whole dump
+#define DUMP_WINDOW_PER_THREAD 4
+
+struct dump_job {
+    struct cli_options* opts;
+    struct input_file** inputs;
+    size_t first; // input of task 0
+    struct out_stream** lex; // rendered per task, NULL with --out-dir
+    struct out_stream** ast;
+    char** failed; // with --out-dir, the path that could not be written per task
+    int* failed_errno;
+};
+
+// <dir>/<rel_path with / escaped as %2F and % as %25><ext>. the escape can be undone, so no two inputs share a file,
+// whatever their names and directories.
+char* dump_path(char* dir, struct input_file* input, char* ext) {
+    char* path = NULL;
+    size_t path_len = 0;
+    FILE* out = open_memstream(&path, &path_len);
+    fprintf(out, "%s/", dir);
+    char* rel_path = input->rel_path;
+    while (rel_path[0] == '/' || (rel_path[0] == '.' && rel_path[1] == '/')) rel_path += rel_path[0] == '/' ? 1 : 2;
+    for (char* c = rel_path; *c != 0; c++) {
+        if (*c == '/') {
+            fputs("%2F", out);
+        } else if (*c == '%') {
+            fputs("%25", out);
         } else {
-            input->filename++;
+            fputc(*c, out);
         }
-        input->rel_path = input_contents[i].filename;
-        char* data = input_contents[i].content;
-        size_t data_len = input_contents[i].length;
-        uint32_t line = 1;
-        uint32_t column = 0;
-        input->lines = arraylist_new(128, sizeof(char*));
-        input->tokens = arraylist_new(128, sizeof(struct token*));
-        arraylist_addptr(input->lines, data);
-        for (size_t i = 0; i < data_len; i++) {
-            column++;
-            if (data[i] == 0 || data[i] > 0x7F) {
-                CORRUPT_FILE_ERROR("Invalid character at %s:%u:%u: 0x%02X", input->rel_path COMMA line COMMA column COMMA data[i]);
-            } else if (data[i] == '\n') {
-                data[i] = 0;
-                line++;
-                column = 0;
-                arraylist_addptr(input->lines, data + i + 1);
+    }
+    fputs(ext, out);
+    fclose(out);
+    return path;
+}
+
+// renders into memory, or straight into the input's own file. returns 0, or -1 with errno set.
+int _dump_one(struct dump_job* job, struct input_file* input, char* ext, uint8_t lex, struct out_stream** rendered, char** path) {
+    TRACE_BEGIN(trace_start);
+    struct dump_ctx ctx;
+    memset(&ctx, 0, sizeof(struct dump_ctx));
+    ctx.json = job->opts->dump_json;
+    int fd = -1;
+    if (job->opts->out_dir != NULL) {
+        *path = dump_path(job->opts->out_dir, input, ext);
+        fd = open(*path, O_RDWR | O_CREAT | O_TRUNC, 0664);
+        if (fd < 0) return -1;
+        ctx.out = newOutStream(fd, OUT_STREAM_DEFAULT_CAP);
+    } else {
+        ctx.out = newMemOutStream(64 * 1024);
+    }
+    if (lex) {
+        dump_lex_file(&ctx, input);
+    } else {
+        dump_ast_file(&ctx, input);
+    }
+    TRACE_END(trace_start, "dump", input->rel_path, lex ? "lex" : "ast");
+    if (fd < 0) {
+        *rendered = ctx.out;
+        return 0;
+    }
+    int status = freeOutStream(ctx.out);
+    int error = errno;
+    close(fd);
+    errno = error;
+    return status;
+}
+
+void _dump_task(size_t index, void* arg) {
+    struct dump_job* job = arg;
+    struct input_file* input = job->inputs[job->first + index];
+    struct cli_options* opts = job->opts;
+    char* path = NULL;
+    if (opts->outputLex != NULL) {
+        if (input->tokens == NULL) {
+            // loaded from the AST cache, lines are already split so the content is exactly what the lexer saw
+            input->tokens = arraylist_new(128, sizeof(struct token*));
+            tokenize(input->content, input->content_len, input->tokens);
+        }
+        if (_dump_one(job, input, opts->outputLex, 1, &job->lex[index], &path) != 0) {
+            job->failed[index] = path;
+            job->failed_errno[index] = errno;
+            return;
+        }
+        free(path);
+        path = NULL;
+    }
+    if (opts->outputAST != NULL) {
+        if (_dump_one(job, input, opts->outputAST, 0, &job->ast[index], &path) != 0) {
+            job->failed[index] = path;
+            job->failed_errno[index] = errno;
+            return;
+        }
+        free(path);
+    }
+}
+
+// renders the -olex and -oast dumps of every input on the worker pool. they are concatenated in input order, or
+// with --out-dir, written per input with the -olex and -oast arguments as extensions.
+int dump_inputs(struct cli_options* opts, struct input_file** inputs) {
+    uint32_t thread_count = opts->thread_count < 1 ? 1 : (uint32_t) opts->thread_count;
+    size_t window = opts->out_dir != NULL ? (size_t) opts->input_file_count : thread_count * DUMP_WINDOW_PER_THREAD;
+    if (window < 1) window = 1;
+    struct dump_job job;
+    memset(&job, 0, sizeof(struct dump_job));
+    job.opts = opts;
+    job.inputs = inputs;
+    job.lex = scalloc(sizeof(struct out_stream*) * window);
+    job.ast = scalloc(sizeof(struct out_stream*) * window);
+    job.failed = scalloc(sizeof(char*) * window);
+    job.failed_errno = scalloc(sizeof(int) * window);
+    int lex_fd = -1;
+    int ast_fd = -1;
+    struct out_stream* lex_out = NULL;
+    struct out_stream* ast_out = NULL;
+    int status = 0;
+    if (opts->out_dir != NULL) {
+        if (mkdir(opts->out_dir, 0775) != 0 && errno != EEXIST) {
+            IO_ERROR(opts->out_dir);
+        }
+    } else {
+        if (opts->outputLex != NULL) {
+            lex_fd = open(opts->outputLex, O_RDWR | O_CREAT | O_TRUNC, 0664);
+            if (lex_fd < 0) {
+                IO_ERROR(opts->outputLex);
             }
+            lex_out = newOutStream(lex_fd, OUT_STREAM_DEFAULT_CAP);
         }
-        tokenize(data, data_len, input->tokens);
-        for (size_t j = 0; j < input->tokens->entry_count; j++) {
-            struct token* token = arraylist_getptr(input->tokens, j);
-            if (token->type == TOKEN_UNKNOWN) {
-                LEX_ERROR("Invalid symbol @ %s:%u<%u-%u>: %s", input->rel_path COMMA token->line COMMA token->start_col COMMA token->end_col COMMA token->value);
-                lex_error_count++;
+        if (opts->outputAST != NULL) {
+            ast_fd = open(opts->outputAST, O_RDWR | O_CREAT | O_TRUNC, 0664);
+            if (ast_fd < 0) {
+                IO_ERROR(opts->outputAST);
             }
+            ast_out = newOutStream(ast_fd, OUT_STREAM_DEFAULT_CAP);
         }
-        if (lex_error_count > 0) continue;
-        struct parse_intermediates immed = parse(input->tokens, input->lines);
-        input->parse_ctx = immed.ctx;
-        input->root = immed.root;
-        if (input->parse_ctx->parse_errors->entry_count > 0) {
-            fprintf(stderr, "%lu errors found in file %s.\n", input->parse_ctx->parse_errors->entry_count, input->rel_path);
-            for (size_t i = 0; i < input->parse_ctx->parse_errors->entry_count; i++) {
-                struct parse_error* error = arraylist_getptr(input->parse_ctx->parse_errors, i);
-                fprintf(stderr, "%s\n", error->message);
+    }
+    for (size_t first = 0; first < (size_t) opts->input_file_count; first += window) {
+        size_t count = opts->input_file_count - first < window ? opts->input_file_count - first : window;
+        job.first = first;
+        task_pool_run(count, thread_count, _dump_task, &job);
+        for (size_t i = 0; i < count; i++) {
+            if (job.failed[i] != NULL) {
+                if (status == 0) {
+                    errno = job.failed_errno[i];
+                    fprintf(stderr, "IO Error: '%s' '%s'\n", strerror(errno), job.failed[i]);
+                    status = 1;
+                }
+                free(job.failed[i]);
+                job.failed[i] = NULL;
+            }
+            if (job.lex[i] != NULL) {
+                outWrite(lex_out, job.lex[i]->buf, job.lex[i]->len);
+                freeOutStream(job.lex[i]);
+                job.lex[i] = NULL;
+            }
+            if (job.ast[i] != NULL) {
+                outWrite(ast_out, job.ast[i]->buf, job.ast[i]->len);
+                freeOutStream(job.ast[i]);
+                job.ast[i] = NULL;
             }
-            parse_error_count += input->parse_ctx->parse_errors->entry_count;
-            continue;
+        }
+    }
+    if (lex_out != NULL && freeOutStream(lex_out) != 0 && status == 0) {
+        fprintf(stderr, "IO Error: '%s' '%s'\n", strerror(errno), opts->outputLex);
+        status = 1;
+    }
+    if (ast_out != NULL && freeOutStream(ast_out) != 0 && status == 0) {
+        fprintf(stderr, "IO Error: '%s' '%s'\n", strerror(errno), opts->outputAST);
+        status = 1;
+    }
+    if (lex_fd >= 0) close(lex_fd);
+    if (ast_fd >= 0) close(ast_fd);
+    free(job.lex);
+    free(job.ast);
+    free(job.failed);
+    free(job.failed_errno);
+    return status;
+}
+
+// to stderr unless --time-report-out is given
+int write_time_report(struct cli_options* opts, struct prog_state* state) {
+    if (opts->time_report_out == NULL) {
+        print_time_report(STDERR_FILENO, opts->time_report_json, state);
+        return 0;
+    }
+    int fd = open(opts->time_report_out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 1;
+    print_time_report(fd, opts->time_report_json, state);
+    return close(fd);
+}
+
+// analysis and output, reading the already parsed inputs
+int build(struct cli_options* opts, struct input_file** inputs) {
+    struct arraylist* allfiles = arraylist_new(16, sizeof(struct ast_node*));
+    for (int i = 0; i < opts->input_file_count; i++) {
+        arraylist_addptr(allfiles, inputs[i]->root);
+    }
+    // -olex and -oast alone read nothing analysis produces, with --lazy-bodies their bodies all stay stubs then
+    uint8_t analyze = opts->outputIR != NULL || opts->emit_interface != NULL || opts->print_stats || opts->prune_report || opts->check_all || opts->incremental != NULL;
+    struct prog_state* prog_ctx = NULL;
+    if (analyze) {
+        struct prog_incr* incr = opts->incremental == NULL ? NULL : prog_incr_load(opts->incremental);
+        for (int i = 0; incr != NULL && i < opts->input_file_count; i++) {
+            prog_incr_add_file(incr, inputs[i]->rel_path, inputs[i]->content_hash);
+        }
+        prog_ctx = gen_prog(allfiles, opts->thread_count < 1 ? 1 : (uint32_t) opts->thread_count, opts->check_all, incr, opts->iface_path);
+        if (prog_ctx->parse_errors > 0) {
+            fprintf(stderr, "You have %lu invalid tokens(s), compilation terminated.", prog_ctx->parse_errors);
+            release_inputs(opts, inputs);
+            return 1;
+        }
+    }
+    struct time_mark mark;
+    time_mark_now(&mark);
+    if (opts->print_stats) {
+        print_prog_stats(prog_ctx, STDERR_FILENO);
+        print_ast_stats(allfiles, STDERR_FILENO);
+        if (opts->ast_cache != NULL) print_ast_cache_stats(STDERR_FILENO);
+        print_hash_stats(STDERR_FILENO);
+    }
+    if (opts->prune_report) {
+        print_prune_report(prog_ctx, STDERR_FILENO);
+    }
+    if (opts->emit_interface != NULL) {
+        if (prog_ctx->errors->entry_count > 0) {
+            fprintf(stderr, "Warning: the build has errors, interfaces in '%s' were not updated\n", opts->emit_interface);
+        } else if (prog_iface_emit(prog_ctx, opts->emit_interface) != 0) {
+            fprintf(stderr, "Warning: could not write interfaces to '%s'\n", opts->emit_interface);
+        }
+        time_phase_end(TIME_PHASE_EMIT_INTERFACE, &mark);
+    }
+    if (opts->outputIR != NULL) {
+        if (prog_write_flexir(prog_ctx, allfiles, opts->outputIR) != 0) IO_ERROR(opts->outputIR);
+        time_phase_end(TIME_PHASE_WRITE_IR, &mark);
+    }
+    int status = 0;
+    if (opts->outputLex != NULL || opts->outputAST != NULL) {
+        // analysis only parsed the bodies it reached, the rest are parsed too so -oast does not depend on reachability
+        for (int i = 0; prog_ctx != NULL && opts->lazy_bodies && opts->outputAST != NULL && i < opts->input_file_count; i++) {
+            ast_expand_bodies(inputs[i]->root);
+        }
+        status = dump_inputs(opts, inputs);
+        time_phase_end(TIME_PHASE_DUMP, &mark);
+    }
+    if (opts->time_report && write_time_report(opts, prog_ctx) != 0) {
+        fprintf(stderr, "Warning: could not write time report to '%s'\n", opts->time_report_out);
+    }
+    if (opts->mem_report) {
+#ifdef SMEM_TRACK
+        smem_printReport(STDERR_FILENO, TIME_PHASE_NAMES, TIME_PHASE_COUNT);
+#else
+        fprintf(stderr, "Warning: --mem-report needs a build with allocation tracking, make SMEM_TRACK=1\n");
+#endif
+    }
+    if (opts->trace != NULL && trace_write(opts->trace) != 0) {
+        fprintf(stderr, "Warning: could not write trace to '%s': %s\n", opts->trace, strerror(errno));
+    }
+    return status;
+}
+
+int load_inputs(struct cli_options* opts, struct input_file** inputs) {
+    int lex_error_count = 0;
+    int parse_error_count = 0;
+    for (int i = 0; i < opts->input_file_count; i++) {
+        int status = 0;
+        if (input_cache != NULL) {
+            status = load_cached_input(&inputs[i], opts->input_files[i], opts->ast_cache, opts->lazy_bodies, &lex_error_count, &parse_error_count);
         } else {
-            arraylist_addptr(allfiles, input->root);
+            inputs[i] = scalloc(sizeof(struct input_file));
+            status = load_input(inputs[i], opts->input_files[i], opts->ast_cache, opts->lazy_bodies, &lex_error_count, &parse_error_count);
         }
+        if (status != 0) return status;
     }
     if (lex_error_count > 0) {
         LEX_ERROR("You have %u invalid symbol(s), compilation terminated.", lex_error_count);
@@ -287,42 +976,98 @@ int main(int argc, char* argv[]) {
         fprintf(stderr, "You have %u invalid tokens(s), compilation terminated.", parse_error_count);
         return 1;
     }
-    struct prog_state* prog_ctx = gen_prog(allfiles);
+    return 0;
+}
 
-    if (outputLex != NULL) {
-        int fd = open(outputLex, O_RDWR | O_CREAT | O_TRUNC, 0664);
-        if (fd < 0) {
-            IO_ERROR(outputLex);
-        }
-        char linebuf[4096];
-        size_t line_ct = 0;
-        for (int i = 0; i < input_file_count; i++) {
-            struct input_file* input = &input_data[i];
-            line_ct = snprintf(linebuf, 4096, "File: %s, Line# %lu", input->filename, input->lines->entry_count);
-            if (line_ct < 0) line_ct = 4096;
-            writeLine(fd, linebuf, line_ct);
-            for (size_t j = 0; j < input->tokens->entry_count; j++) {
-                struct token* token = arraylist_getptr(input->tokens, j);
-                line_ct = snprintf(linebuf, 4096, "%lu<%lu-%lu>, %u: %s", token->line, token->start_col, token->end_col, token->type, token->value);
-                if (line_ct < 0) line_ct = 4096;
-                writeLine(fd, linebuf, line_ct);
-            }
-        }
-        close(fd);
+int compile(struct cli_options* opts) {
+    memset(&ast_cache_stats, 0, sizeof(struct ast_cache_stats));
+    time_report_reset(opts->time_report);
+    if (opts->perf_counters && time_report_perf() != 0) {
+        fprintf(stderr, "Warning: hardware counters are unavailable, the time report goes on without them: %s\n", strerror(errno));
+    }
+    trace_reset(opts->trace != NULL);
+#ifdef SMEM_TRACK
+    smem_resetStats();
+#endif
+    struct input_file* inputs[opts->input_file_count];
+    memset(inputs, 0, sizeof(inputs));
+    int status = load_inputs(opts, inputs);
+    if (status != 0) {
+        release_inputs(opts, inputs);
+        return status;
     }
+    if (input_cache == NULL) return build(opts, inputs);
+    // everything analysis allocates belongs to the request, a child process releases it all on exit
+    // while the parsed inputs stay with the daemon
+    fflush(stdout);
+    fflush(stderr);
+    pid_t child = fork();
+    if (child < 0) {
+        fprintf(stderr, "Could not fork: '%s'\n", strerror(errno));
+        return 1;
+    }
+    if (child == 0) {
+        int status = build(opts, inputs);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(status);
+    }
+    int child_status = 0;
+    while (waitpid(child, &child_status, 0) < 0) {
+        if (errno != EINTR) return 1;
+    }
+    return WIFEXITED(child_status) ? WEXITSTATUS(child_status) : 1;
+}
 
-    if (outputAST != NULL) {
-        int fd = open(outputAST, O_RDWR | O_CREAT | O_TRUNC, 0664);
-        if (fd < 0) {
-            IO_ERROR(outputAST);
-        }
-        for (int i = 0; i < input_file_count; i++) {
-            struct input_file* input = &input_data[i];
-            dprintf(fd, "File: %s, Line#: %lu\n", input->filename, input->lines->entry_count);
-            traverse_node(input->root, print_ast, fd, 1);
-        }
-        close(fd);
+int dump_ir(char* path) {
+    struct flexir ir;
+    int status = flexir_open(&ir, path);
+    if (status == -1) {
+        IO_ERROR(path);
+    } else if (status != 0) {
+        CORRUPT_FILE_ERROR("'%s' is not an IR file written by this version", path);
     }
+    flexir_dump(&ir, stdout);
+    flexir_close(&ir);
+    return 0;
+}
 
+int serve_request(int argc, char* argv[]) {
+    struct cli_options opts;
+    int status = parse_cli(argc, argv, &opts);
+    if (status == 0 && (opts.daemon != NULL || opts.connect != NULL)) {
+        fprintf(stderr, "Invalid Argument: daemons do not accept --daemon or --connect\n" FLEX_HELP);
+        status = 1;
+    }
+    if (status == 0) {
+        status = opts.dump_ir != NULL ? dump_ir(opts.dump_ir) : compile(&opts);
+    }
+    free(opts.input_files);
+    free(opts.ast_cache_owned);
+    return status;
+}
 
-}
\ No newline at end of file
+int main(int argc, char* argv[]) {
+    struct cli_options opts;
+    int status = parse_cli(argc, argv, &opts);
+    if (status != 0) return status;
+    if (opts.connect != NULL) {
+        // forward everything but the --connect pair itself
+        char* forward[argc];
+        int forward_count = 0;
+        for (int i = 0; i < argc; i++) {
+            if (i > 0 && str_eq(argv[i], "--connect")) {
+                i++;
+                continue;
+            }
+            forward[forward_count++] = argv[i];
+        }
+        return daemon_forward(opts.connect, forward_count, forward);
+    }
+    if (opts.dump_ir != NULL) return dump_ir(opts.dump_ir);
+    if (opts.daemon != NULL) {
+        input_cache = new_hashmap(64);
+        return daemon_serve(opts.daemon, serve_request);
+    }
+    return compile(&opts);
+}
@@ -0,0 +1,60 @@
+#include "perf_counters.h"
+#include <linux/perf_event.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+const char* PERF_COUNTER_NAMES[] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+int perf_counter_fds[PERF_COUNTER_COUNT] = {-1, -1, -1, -1, -1};
+
+int _perf_open(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(struct perf_event_attr));
+    attr.size = sizeof(struct perf_event_attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+int perf_counters_open() {
+    perf_counters_close();
+    perf_counter_fds[PERF_COUNTER_CYCLES] = _perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    perf_counter_fds[PERF_COUNTER_INSTRUCTIONS] = _perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    perf_counter_fds[PERF_COUNTER_L1D_MISSES] = _perf_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    perf_counter_fds[PERF_COUNTER_LLC_MISSES] = _perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    perf_counter_fds[PERF_COUNTER_BRANCH_MISSES] = _perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    int error = errno;
+    int opened = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perf_counter_fds[i] >= 0) opened++;
+    }
+    if (opened == 0) errno = error;
+    return opened;
+}
+
+uint8_t perf_counter_available(int counter) {
+    return perf_counter_fds[counter] >= 0;
+}
+
+void perf_counters_read(uint64_t values[PERF_COUNTER_COUNT]) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        // value, time enabled, time running
+        uint64_t data[3];
+        values[i] = 0;
+        if (perf_counter_fds[i] < 0 || read(perf_counter_fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+        values[i] = data[2] < data[1] ? (uint64_t) ((double) data[0] * data[1] / data[2]) : data[0];
+    }
+}
+
+void perf_counters_close() {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perf_counter_fds[i] >= 0) close(perf_counter_fds[i]);
+        perf_counter_fds[i] = -1;
+    }
+}
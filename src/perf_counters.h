@@ -0,0 +1,29 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <stdint.h>
+
+// hardware counters of the process through perf_event_open. threads started after perf_counters_open are counted
+// too, once they exit, which task_pool_run threads have by the time it returns. counters the kernel or cpu refuses
+// read as 0 and are left out of reports.
+
+#define PERF_COUNTER_CYCLES 0
+#define PERF_COUNTER_INSTRUCTIONS 1
+#define PERF_COUNTER_L1D_MISSES 2 // data cache read misses
+#define PERF_COUNTER_LLC_MISSES 3
+#define PERF_COUNTER_BRANCH_MISSES 4
+#define PERF_COUNTER_COUNT 5
+
+extern const char* PERF_COUNTER_NAMES[];
+
+// returns how many counters opened, 0 with errno set if none did
+int perf_counters_open();
+
+uint8_t perf_counter_available(int counter);
+
+// user space counts since perf_counters_open, scaled up when the kernel multiplexed the counter
+void perf_counters_read(uint64_t values[PERF_COUNTER_COUNT]);
+
+void perf_counters_close();
+
+#endif
@@ -0,0 +1,467 @@
+#include "prog_flexir.h"
+#include "flexir.h"
+#include "smem.h"
+#include "hash.h"
+#include "arraylist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// every section is built in memory and the file is written front to back once the sizes are known
+struct flexir_writer {
+    FILE* sections[FLEXIR_SECTION_COUNT];
+    char* section_data[FLEXIR_SECTION_COUNT];
+    size_t section_len[FLEXIR_SECTION_COUNT];
+    uint64_t counts[FLEXIR_SECTION_COUNT]; // records written so far, bytes for strings
+    struct hashmap* strings; // string -> offset + 1
+    struct hashmap* types; // structural key of a record -> index + 1
+    struct hashmap* type_ptrs; // prog_type* -> index + 1
+    struct hashmap* indices; // prog_module*, prog_class*, prog_func*, prog_var* and file rel_path -> index + 1
+    struct arraylist* files; // file ast_nodes
+    struct arraylist* modules;
+    struct arraylist* classes;
+    struct arraylist* funcs;
+    struct arraylist* vars;
+};
+
+#define FLEXIR_DECL_MODULE 0
+#define FLEXIR_DECL_CLASS 1
+#define FLEXIR_DECL_FUNC 2
+#define FLEXIR_DECL_VAR 3
+
+struct flexir_decl {
+    void* item;
+    char* name;
+    struct ast_node* at;
+};
+
+uint32_t _flexir_lookup(struct hashmap* map, void* ptr) {
+    if (ptr == NULL) return FLEXIR_NONE;
+    return (uint32_t) ((uintptr_t) hashmap_getptr(map, ptr) - 1);
+}
+
+void _flexir_number(struct flexir_writer* w, struct arraylist* list, void* item) {
+    hashmap_putptr(w->indices, item, (void*) (uintptr_t) (list->entry_count + 1));
+    arraylist_addptr(list, item);
+}
+
+void _flexir_record(struct flexir_writer* w, int section, void* record, size_t size) {
+    fwrite(record, size, 1, w->sections[section]);
+    w->counts[section]++;
+}
+
+struct flexir_list _flexir_list(struct flexir_writer* w, uint32_t* items, size_t count) {
+    struct flexir_list list;
+    list.first = (uint32_t) w->counts[FLEXIR_SECTION_REFS];
+    list.count = (uint32_t) count;
+    // empty lists come with no items array
+    if (count == 0) return list;
+    fwrite(items, sizeof(uint32_t), count, w->sections[FLEXIR_SECTION_REFS]);
+    w->counts[FLEXIR_SECTION_REFS] += count;
+    return list;
+}
+
+uint32_t _flexir_string(struct flexir_writer* w, char* str) {
+    if (str == NULL) return FLEXIR_NONE;
+    void* known = hashmap_get(w->strings, str);
+    if (known != NULL) return (uint32_t) ((uintptr_t) known - 1);
+    uint64_t offset = w->counts[FLEXIR_SECTION_STRINGS];
+    size_t len = strlen(str) + 1;
+    fwrite(str, 1, len, w->sections[FLEXIR_SECTION_STRINGS]);
+    w->counts[FLEXIR_SECTION_STRINGS] += len;
+    hashmap_put(w->strings, str, (void*) (uintptr_t) (offset + 1));
+    return (uint32_t) offset;
+}
+
+struct flexir_pos _flexir_pos(struct ast_node* node) {
+    struct flexir_pos pos;
+    pos.line = node == NULL ? 0 : (uint32_t) node->start_line;
+    pos.col = node == NULL ? 0 : (uint32_t) node->start_col;
+    return pos;
+}
+
+int _flexir_decl_cmp(const void* a, const void* b) {
+    const struct flexir_decl* d1 = a;
+    const struct flexir_decl* d2 = b;
+    struct flexir_pos p1 = _flexir_pos(d1->at);
+    struct flexir_pos p2 = _flexir_pos(d2->at);
+    if (p1.line != p2.line) return p1.line < p2.line ? -1 : 1;
+    if (p1.col != p2.col) return p1.col < p2.col ? -1 : 1;
+    return strcmp(d1->name == NULL ? "" : d1->name, d2->name == NULL ? "" : d2->name);
+}
+
+// the values of map in source order, so the numbering does not depend on hashing
+struct flexir_decl* _flexir_sorted(struct hashmap* map, uint8_t kind) {
+    struct flexir_decl* decls = smalloc(sizeof(struct flexir_decl) * (map->entry_count + 1));
+    size_t count = 0;
+    ITER_MAP(map) {
+        struct flexir_decl* decl = &decls[count++];
+        decl->item = value;
+        if (kind == FLEXIR_DECL_MODULE) {
+            decl->name = ((struct prog_module*) value)->name;
+            decl->at = NULL;
+        } else if (kind == FLEXIR_DECL_CLASS) {
+            decl->name = ((struct prog_class*) value)->name;
+            decl->at = ((struct prog_class*) value)->decl;
+        } else if (kind == FLEXIR_DECL_FUNC) {
+            decl->name = ((struct prog_func*) value)->name;
+            decl->at = ((struct prog_func*) value)->proc.root;
+        } else {
+            struct prog_var* var = value;
+            decl->name = var->name;
+            decl->at = var->decl != NULL ? var->decl : var->type == NULL ? NULL : var->type->ast;
+        }
+    ITER_MAP_END()}
+    qsort(decls, count, sizeof(struct flexir_decl), _flexir_decl_cmp);
+    return decls;
+}
+
+struct flexir_list _flexir_map_list(struct flexir_writer* w, struct hashmap* map, uint8_t kind) {
+    struct flexir_decl* decls = _flexir_sorted(map, kind);
+    uint32_t* items = smalloc(sizeof(uint32_t) * (map->entry_count + 1));
+    for (size_t i = 0; i < map->entry_count; i++) {
+        items[i] = _flexir_lookup(w->indices, decls[i].item);
+    }
+    struct flexir_list list = _flexir_list(w, items, map->entry_count);
+    free(items);
+    free(decls);
+    return list;
+}
+
+struct flexir_list _flexir_arraylist(struct flexir_writer* w, struct arraylist* from) {
+    size_t count = from == NULL ? 0 : from->entry_count;
+    uint32_t* items = smalloc(sizeof(uint32_t) * (count + 1));
+    for (size_t i = 0; i < count; i++) {
+        items[i] = _flexir_lookup(w->indices, arraylist_getptr(from, i));
+    }
+    struct flexir_list list = _flexir_list(w, items, count);
+    free(items);
+    return list;
+}
+
+void _flexir_number_func(struct flexir_writer* w, struct prog_func* func) {
+    _flexir_number(w, w->funcs, func);
+    for (size_t i = 0; i < func->arguments_list->entry_count; i++) {
+        _flexir_number(w, w->vars, arraylist_getptr(func->arguments_list, i));
+    }
+    for (size_t i = 0; i < func->closures->entry_count; i++) {
+        _flexir_number_func(w, arraylist_getptr(func->closures, i));
+    }
+}
+
+void _flexir_number_members(struct flexir_writer* w, struct hashmap* vars, struct hashmap* funcs) {
+    struct flexir_decl* decls = _flexir_sorted(vars, FLEXIR_DECL_VAR);
+    for (size_t i = 0; i < vars->entry_count; i++) {
+        _flexir_number(w, w->vars, decls[i].item);
+    }
+    free(decls);
+    decls = _flexir_sorted(funcs, FLEXIR_DECL_FUNC);
+    for (size_t i = 0; i < funcs->entry_count; i++) {
+        _flexir_number_func(w, decls[i].item);
+    }
+    free(decls);
+}
+
+void _flexir_number_module(struct flexir_writer* w, struct prog_module* mod) {
+    _flexir_number(w, w->modules, mod);
+    struct flexir_decl* decls = _flexir_sorted(mod->classes, FLEXIR_DECL_CLASS);
+    for (size_t i = 0; i < mod->classes->entry_count; i++) {
+        struct prog_class* clas = decls[i].item;
+        _flexir_number(w, w->classes, clas);
+        _flexir_number_members(w, clas->vars, clas->funcs);
+    }
+    free(decls);
+    _flexir_number_members(w, mod->vars, mod->funcs);
+    decls = _flexir_sorted(mod->submodules, FLEXIR_DECL_MODULE);
+    for (size_t i = 0; i < mod->submodules->entry_count; i++) {
+        _flexir_number_module(w, decls[i].item);
+    }
+    free(decls);
+}
+
+uint32_t _flexir_type(struct flexir_writer* w, struct prog_type* type) {
+    if (type == NULL) return FLEXIR_NONE;
+    uint32_t known = _flexir_lookup(w->type_ptrs, type);
+    if (known != FLEXIR_NONE) return known;
+    struct flexir_type record;
+    memset(&record, 0, sizeof(struct flexir_type));
+    record.kind = type->type;
+    record.array_dims = type->array_dimensonality;
+    record.flags = (type->is_ref ? FLEXIR_TYPE_REF : 0) | (type->variadic ? FLEXIR_TYPE_VARIADIC : 0) | (type->is_const ? FLEXIR_TYPE_CONST : 0) | (type->is_generic ? FLEXIR_TYPE_GENERIC : 0) | (type->is_optional ? FLEXIR_TYPE_OPTIONAL : 0) | (type->is_master ? FLEXIR_TYPE_MASTER : 0);
+    record.name = FLEXIR_NONE;
+    record.clas = FLEXIR_NONE;
+    record.return_type = FLEXIR_NONE;
+    uint32_t* args = NULL;
+    size_t arg_count = 0;
+    if (type->type == PROG_TYPE_FUNC) {
+        record.return_type = _flexir_type(w, type->data.func.return_type);
+        arg_count = type->data.func.arg_types == NULL ? 0 : type->data.func.arg_types->entry_count;
+        args = smalloc(sizeof(uint32_t) * (arg_count + 1));
+        for (size_t i = 0; i < arg_count; i++) {
+            args[i] = _flexir_type(w, arraylist_getptr(type->data.func.arg_types, i));
+        }
+    } else {
+        record.name = _flexir_string(w, type->name);
+        if (type->type == PROG_TYPE_PRIMITIVE) {
+            record.prim = type->data.prim.prim_type;
+        } else if (type->type == PROG_TYPE_CLASS) {
+            record.clas = _flexir_lookup(w->indices, type->data.clas.clas);
+        }
+        // generics are keyed by the master's parameter names once resolved, by the type's own argument names before
+        struct prog_type* keyed = type->master_type == NULL ? type : type->master_type;
+        struct arraylist* params = keyed->ast != NULL && keyed->ast->type == AST_NODE_TYPE ? keyed->ast->data.type.generics : NULL;
+        if (type->generics != NULL && params != NULL) {
+            arg_count = params->entry_count;
+            args = smalloc(sizeof(uint32_t) * (arg_count + 1));
+            for (size_t i = 0; i < arg_count; i++) {
+                struct ast_node* param = arraylist_getptr(params, i);
+                args[i] = _flexir_type(w, hashmap_get(type->generics, param->data.type.name));
+            }
+        }
+    }
+    char* key = NULL;
+    size_t key_len = 0;
+    FILE* out = open_memstream(&key, &key_len);
+    fprintf(out, "%u.%u.%u.%u.%u.%u.%u:", record.kind, record.prim, record.array_dims, record.flags, record.name, record.clas, record.return_type);
+    for (size_t i = 0; i < arg_count; i++) {
+        fprintf(out, "%u,", args[i]);
+    }
+    fclose(out);
+    void* interned = hashmap_get(w->types, key);
+    uint32_t index = 0;
+    if (interned != NULL) {
+        index = (uint32_t) ((uintptr_t) interned - 1);
+        free(key);
+    } else {
+        record.args = _flexir_list(w, args, arg_count);
+        index = (uint32_t) w->counts[FLEXIR_SECTION_TYPES];
+        _flexir_record(w, FLEXIR_SECTION_TYPES, &record, sizeof(struct flexir_type));
+        hashmap_put(w->types, key, (void*) (uintptr_t) (index + 1));
+    }
+    free(args);
+    hashmap_putptr(w->type_ptrs, type, (void*) (uintptr_t) (index + 1));
+    return index;
+}
+
+uint32_t _flexir_file(struct flexir_writer* w, struct prog_file* file) {
+    return file == NULL ? FLEXIR_NONE : _flexir_lookup(w->indices, file->rel_path);
+}
+
+struct flexir_node_ctx {
+    struct flexir_writer* w;
+    uint32_t next;
+};
+
+int _flexir_node_type(struct ast_node* node, void* arg) {
+    struct flexir_node_ctx* ctx = arg;
+    uint32_t index = ctx->next++;
+    if (node->output_type != NULL) {
+        struct flexir_node_type record;
+        memset(&record, 0, sizeof(struct flexir_node_type));
+        record.node = index;
+        record.type = _flexir_type(ctx->w, node->output_type);
+        record.kind = _flexir_string(ctx->w, (char*) AST_TYPE_NAMES[node->type]);
+        record.pos = _flexir_pos(node);
+        _flexir_record(ctx->w, FLEXIR_SECTION_NODE_TYPES, &record, sizeof(struct flexir_node_type));
+    }
+    return AST_VISIT_CONTINUE;
+}
+
+void _flexir_write_file(struct flexir_writer* w, struct ast_node* root) {
+    struct flexir_file record;
+    memset(&record, 0, sizeof(struct flexir_file));
+    record.name = _flexir_string(w, root->data.file.filename);
+    record.rel_path = _flexir_string(w, root->data.file.rel_path);
+    record.line_count = root->data.file.lines == NULL ? 0 : (uint32_t) root->data.file.lines->entry_count;
+    record.node_types.first = (uint32_t) w->counts[FLEXIR_SECTION_NODE_TYPES];
+    struct flexir_node_ctx ctx;
+    ctx.w = w;
+    ctx.next = 0;
+    struct ast_visitor visitor = {_flexir_node_type, NULL, &ctx};
+    visit_node(root, &visitor);
+    record.node_count = ctx.next;
+    record.node_types.count = (uint32_t) w->counts[FLEXIR_SECTION_NODE_TYPES] - record.node_types.first;
+    _flexir_record(w, FLEXIR_SECTION_FILES, &record, sizeof(struct flexir_file));
+}
+
+void _flexir_write_module(struct flexir_writer* w, struct prog_module* mod) {
+    struct flexir_module record;
+    memset(&record, 0, sizeof(struct flexir_module));
+    record.name = _flexir_string(w, mod->name);
+    record.parent = _flexir_lookup(w->indices, mod->parent);
+    record.file = _flexir_file(w, mod->file);
+    record.prot = mod->prot;
+    record.flags = (mod->entry ? FLEXIR_MODULE_ENTRY : 0) | (mod->live ? FLEXIR_MODULE_LIVE : 0) | (mod->iface ? FLEXIR_MODULE_IFACE : 0);
+    record.submodules = _flexir_map_list(w, mod->submodules, FLEXIR_DECL_MODULE);
+    record.imports = _flexir_arraylist(w, mod->imported_modules);
+    record.classes = _flexir_map_list(w, mod->classes, FLEXIR_DECL_CLASS);
+    record.funcs = _flexir_map_list(w, mod->funcs, FLEXIR_DECL_FUNC);
+    record.vars = _flexir_map_list(w, mod->vars, FLEXIR_DECL_VAR);
+    _flexir_record(w, FLEXIR_SECTION_MODULES, &record, sizeof(struct flexir_module));
+}
+
+void _flexir_write_class(struct flexir_writer* w, struct prog_class* clas) {
+    struct flexir_class record;
+    memset(&record, 0, sizeof(struct flexir_class));
+    record.name = _flexir_string(w, clas->name);
+    record.module = _flexir_lookup(w->indices, clas->module);
+    record.file = _flexir_file(w, clas->file);
+    record.type = _flexir_type(w, clas->type);
+    record.pos = _flexir_pos(clas->decl);
+    record.prot = clas->prot;
+    record.flags = (clas->synch ? FLEXIR_CLASS_SYNCH : 0) | (clas->virt ? FLEXIR_CLASS_VIRT : 0) | (clas->iface ? FLEXIR_CLASS_IFACE : 0) | (clas->pure ? FLEXIR_CLASS_PURE : 0) | (clas->live ? FLEXIR_CLASS_LIVE : 0);
+    size_t parent_count = clas->parents == NULL ? 0 : clas->parents->entry_count;
+    uint32_t parents[parent_count + 1];
+    for (size_t i = 0; i < parent_count; i++) {
+        parents[i] = _flexir_type(w, arraylist_getptr(clas->parents, i));
+    }
+    record.parents = _flexir_list(w, parents, parent_count);
+    record.funcs = _flexir_map_list(w, clas->funcs, FLEXIR_DECL_FUNC);
+    record.vars = _flexir_map_list(w, clas->vars, FLEXIR_DECL_VAR);
+    _flexir_record(w, FLEXIR_SECTION_CLASSES, &record, sizeof(struct flexir_class));
+}
+
+void _flexir_write_func(struct flexir_writer* w, struct prog_func* func) {
+    struct flexir_func record;
+    memset(&record, 0, sizeof(struct flexir_func));
+    record.name = _flexir_string(w, func->name);
+    record.module = _flexir_lookup(w->indices, func->module);
+    record.clas = _flexir_lookup(w->indices, func->clas);
+    record.closing = _flexir_lookup(w->indices, func->closing);
+    record.file = _flexir_file(w, func->file);
+    record.return_type = _flexir_type(w, func->return_type);
+    record.pos = _flexir_pos(func->proc.root);
+    record.frame_size = func->frame_size;
+    record.prot = func->prot;
+    record.flags = (func->anonymous ? FLEXIR_FUNC_ANONYMOUS : 0) | (func->synch ? FLEXIR_FUNC_SYNCH : 0) | (func->virt ? FLEXIR_FUNC_VIRT : 0) | (func->async ? FLEXIR_FUNC_ASYNC : 0) | (func->csig ? FLEXIR_FUNC_CSIG : 0) | (func->stat ? FLEXIR_FUNC_STAT : 0) | (func->pure ? FLEXIR_FUNC_PURE : 0) | (func->live ? FLEXIR_FUNC_LIVE : 0);
+    record.args = _flexir_arraylist(w, func->arguments_list);
+    record.closures = _flexir_arraylist(w, func->closures);
+    _flexir_record(w, FLEXIR_SECTION_FUNCS, &record, sizeof(struct flexir_func));
+}
+
+void _flexir_write_var(struct flexir_writer* w, struct prog_var* var) {
+    struct flexir_var record;
+    memset(&record, 0, sizeof(struct flexir_var));
+    record.uid = var->uid;
+    record.name = _flexir_string(w, var->name);
+    record.module = _flexir_lookup(w->indices, var->module);
+    record.clas = _flexir_lookup(w->indices, var->clas);
+    record.func = _flexir_lookup(w->indices, var->func);
+    record.file = _flexir_file(w, var->file);
+    record.type = _flexir_type(w, var->type);
+    record.slot = var->slot;
+    record.names_func = _flexir_lookup(w->indices, var->pre_alloc_func);
+    record.pos = _flexir_pos(var->decl != NULL ? var->decl : var->type == NULL ? NULL : var->type->ast);
+    record.prot = var->prot;
+    record.flags = (var->synch ? FLEXIR_VAR_SYNCH : 0) | (var->csig ? FLEXIR_VAR_CSIG : 0) | (var->stat ? FLEXIR_VAR_STAT : 0) | (var->cons ? FLEXIR_VAR_CONS : 0) | (var->live ? FLEXIR_VAR_LIVE : 0);
+    _flexir_record(w, FLEXIR_SECTION_VARS, &record, sizeof(struct flexir_var));
+}
+
+int _flexir_write_out(struct flexir_writer* w, uint64_t error_count, char* path) {
+    struct flexir_header header;
+    memset(&header, 0, sizeof(struct flexir_header));
+    memcpy(header.magic, FLEXIR_MAGIC, 8);
+    header.version = FLEXIR_VERSION;
+    header.byte_order = FLEXIR_BYTE_ORDER;
+    header.error_count = error_count;
+    uint64_t offset = sizeof(struct flexir_header);
+    for (int i = 0; i < FLEXIR_SECTION_COUNT; i++) {
+        offset = (offset + 7) & ~7UL;
+        header.sections[i].offset = offset;
+        header.sections[i].count = w->counts[i];
+        offset += w->section_len[i];
+    }
+    header.size = offset;
+    char* tmp_path = NULL;
+    size_t tmp_len = 0;
+    FILE* tmp = open_memstream(&tmp_path, &tmp_len);
+    fprintf(tmp, "%s.tmp", path);
+    fclose(tmp);
+    FILE* out = fopen(tmp_path, "w");
+    if (out == NULL) {
+        free(tmp_path);
+        return -1;
+    }
+    char padding[8] = {0};
+    fwrite(&header, sizeof(struct flexir_header), 1, out);
+    for (int i = 0; i < FLEXIR_SECTION_COUNT; i++) {
+        if (i > 0) fwrite(padding, 1, header.sections[i].offset - (header.sections[i - 1].offset + w->section_len[i - 1]), out);
+        fwrite(w->section_data[i], 1, w->section_len[i], out);
+    }
+    int failed = ferror(out);
+    failed |= fclose(out) != 0 || rename(tmp_path, path) != 0;
+    if (failed) unlink(tmp_path);
+    free(tmp_path);
+    return failed ? -1 : 0;
+}
+
+int prog_write_flexir(struct prog_state* state, struct arraylist* files, char* path) {
+    struct flexir_writer w;
+    memset(&w, 0, sizeof(struct flexir_writer));
+    for (int i = 0; i < FLEXIR_SECTION_COUNT; i++) {
+        w.sections[i] = open_memstream(&w.section_data[i], &w.section_len[i]);
+    }
+    w.strings = new_hashmap(256);
+    w.types = new_hashmap(64);
+    w.type_ptrs = new_hashmap(256);
+    w.indices = new_hashmap(256);
+    w.files = arraylist_new(files->entry_count + state->iface_files->entry_count + 1, sizeof(struct ast_node*));
+    w.modules = arraylist_new(16, sizeof(struct prog_module*));
+    w.classes = arraylist_new(32, sizeof(struct prog_class*));
+    w.funcs = arraylist_new(64, sizeof(struct prog_func*));
+    w.vars = arraylist_new(64, sizeof(struct prog_var*));
+    // declarations refer to files by their rel_path, shared with the prog_file made from them
+    for (size_t i = 0; i < files->entry_count; i++) {
+        struct ast_node* root = arraylist_getptr(files, i);
+        hashmap_putptr(w.indices, root->data.file.rel_path, (void*) (uintptr_t) (w.files->entry_count + 1));
+        arraylist_addptr(w.files, root);
+    }
+    for (size_t i = 0; i < state->iface_files->entry_count; i++) {
+        struct ast_node* root = arraylist_getptr(state->iface_files, i);
+        hashmap_putptr(w.indices, root->data.file.rel_path, (void*) (uintptr_t) (w.files->entry_count + 1));
+        arraylist_addptr(w.files, root);
+    }
+    struct flexir_decl* decls = _flexir_sorted(state->modules, FLEXIR_DECL_MODULE);
+    for (size_t i = 0; i < state->modules->entry_count; i++) {
+        _flexir_number_module(&w, decls[i].item);
+    }
+    free(decls);
+    for (size_t i = 0; i < w.files->entry_count; i++) {
+        _flexir_write_file(&w, arraylist_getptr(w.files, i));
+    }
+    for (size_t i = 0; i < w.modules->entry_count; i++) {
+        _flexir_write_module(&w, arraylist_getptr(w.modules, i));
+    }
+    for (size_t i = 0; i < w.classes->entry_count; i++) {
+        _flexir_write_class(&w, arraylist_getptr(w.classes, i));
+    }
+    for (size_t i = 0; i < w.funcs->entry_count; i++) {
+        _flexir_write_func(&w, arraylist_getptr(w.funcs, i));
+    }
+    for (size_t i = 0; i < w.vars->entry_count; i++) {
+        _flexir_write_var(&w, arraylist_getptr(w.vars, i));
+    }
+    for (int i = 0; i < FLEXIR_SECTION_COUNT; i++) {
+        fclose(w.sections[i]);
+    }
+    int status = _flexir_write_out(&w, state->errors->entry_count, path);
+    for (int i = 0; i < FLEXIR_SECTION_COUNT; i++) {
+        free(w.section_data[i]);
+    }
+    ITER_MAP(w.types) {
+        // values are indices, only the keys were allocated
+        (void) value;
+        free(str_key);
+    ITER_MAP_END()}
+    free_hashmap(w.strings);
+    free_hashmap(w.types);
+    free_hashmap(w.type_ptrs);
+    free_hashmap(w.indices);
+    arraylist_free(w.files);
+    arraylist_free(w.modules);
+    arraylist_free(w.classes);
+    arraylist_free(w.funcs);
+    arraylist_free(w.vars);
+    return status;
+}
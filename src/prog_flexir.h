@@ -0,0 +1,11 @@
+#ifndef __PROG_FLEXIR_H__
+#define __PROG_FLEXIR_H__
+
+#include "prog_ir.h"
+#include "arraylist.h"
+
+// writes the analysis results of state to path in the format of flexir.h. files are the file ast_nodes given to
+// gen_prog, node types are numbered in the order visit_node enters them. the file is replaced once it is complete.
+int prog_write_flexir(struct prog_state* state, struct arraylist* files, char* path);
+
+#endif
@@ -0,0 +1,304 @@
+#include "prog_iface.h"
+#include "lexer.h"
+#include "streams.h"
+#include "smem.h"
+#include "hash.h"
+#include "arraylist.h"
+#include "xstring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// modifier flags come from the parser as truncated token pointers, so only zero or not is meaningful
+#define IFACE_FLAG(flag, keyword) if (flag) fputs(keyword " ", out);
+
+const char* IFACE_PROT_KEYWORDS[] = {"", "priv ", "prot ", "pub "};
+
+void _iface_indent(FILE* out, int depth) {
+    for (int i = 0; i < depth; i++) fputs("    ", out);
+}
+
+// in the syntax parse_type reads back. top level const is left to the declaration's own modifiers.
+void _iface_write_type(FILE* out, struct ast_node* type, uint8_t with_const) {
+    if (with_const && type->flags.cons) fputs("const ", out);
+    if (type->flags.protofunc) {
+        fputs("protofunc ", out);
+        if (type->data.type.protofunc_return_type != NULL) _iface_write_type(out, type->data.type.protofunc_return_type, 1);
+        fputc('(', out);
+        for (size_t i = 0; type->data.type.protofunc_arguments != NULL && i < type->data.type.protofunc_arguments->entry_count; i++) {
+            if (i > 0) fputs(", ", out);
+            _iface_write_type(out, arraylist_getptr(type->data.type.protofunc_arguments, i), 1);
+        }
+        fputc(')', out);
+        return;
+    }
+    fputs(type->data.type.name, out);
+    if (type->data.type.generics != NULL) {
+        fputc('<', out);
+        for (size_t i = 0; i < type->data.type.generics->entry_count; i++) {
+            if (i > 0) fputs(", ", out);
+            _iface_write_type(out, arraylist_getptr(type->data.type.generics, i), 1);
+        }
+        fputc('>', out);
+    }
+    for (uint8_t i = 0; i < type->flags.array_dimensonality; i++) fputs("[]", out);
+    if (type->flags.is_ref) fputc('&', out);
+    if (type->flags.variadic) fputs("...", out);
+}
+
+void _iface_write_module_path(FILE* out, struct prog_module* mod) {
+    if (mod->parent != NULL) {
+        _iface_write_module_path(out, mod->parent);
+        fputc('.', out);
+    }
+    fputs(mod->name, out);
+}
+
+// the body is replaced by an empty statement, argument defaults are left out
+void _iface_write_func(FILE* out, struct prog_func* func, int depth) {
+    struct ast_node* root = func->proc.root;
+    _iface_indent(out, depth);
+    fputs(IFACE_PROT_KEYWORDS[func->prot], out);
+    IFACE_FLAG(func->synch, "synch");
+    IFACE_FLAG(func->virt, "virt");
+    IFACE_FLAG(func->async, "async");
+    IFACE_FLAG(func->csig, "csig");
+    IFACE_FLAG(func->clas != NULL && func->stat, "static");
+    IFACE_FLAG(func->pure, "pure");
+    fputs("func ", out);
+    _iface_write_type(out, root->data.func.return_type, 1);
+    fprintf(out, " %s(", func->name);
+    for (size_t i = 0; i < func->arguments_list->entry_count; i++) {
+        struct prog_var* arg = arraylist_getptr(func->arguments_list, i);
+        if (i > 0) fputs(", ", out);
+        _iface_write_type(out, arg->type->ast, 1);
+        fprintf(out, " %s", arg->name);
+    }
+    fputs(");\n", out);
+}
+
+void _iface_write_var(FILE* out, struct prog_var* var, int depth) {
+    _iface_indent(out, depth);
+    fputs(IFACE_PROT_KEYWORDS[var->prot], out);
+    IFACE_FLAG(var->synch, "synch");
+    IFACE_FLAG(var->csig, "csig");
+    if (var->clas != NULL) {
+        IFACE_FLAG(var->stat, "static");
+        IFACE_FLAG(var->cons, "const");
+    } else {
+        // module vars read a leading const into stat
+        IFACE_FLAG(var->cons || var->stat, "const");
+    }
+    _iface_write_type(out, var->decl->data.vardecl.type, 0);
+    fprintf(out, " %s;\n", var->name);
+}
+
+// members are written in declaration order, so interfaces read like the source they come from
+void _iface_write_member(FILE* out, struct hashmap* vars, struct hashmap* funcs, struct ast_node* node, int depth) {
+    if (node->type == AST_NODE_VAR_DECL) {
+        struct prog_var* var = hashmap_get(vars, node->data.vardecl.name);
+        if (var == NULL || var->decl != node || var->prot == PROTECTION_PRIV) return;
+        _iface_write_var(out, var, depth);
+    } else if (node->type == AST_NODE_FUNC && node->prog != NULL) {
+        struct prog_func* func = node->prog->data.func;
+        if (func->anonymous || func->prot == PROTECTION_PRIV || hashmap_get(funcs, func->name) != func) return;
+        _iface_write_func(out, func, depth);
+    }
+}
+
+void _iface_write_class(FILE* out, struct prog_class* clas, int depth) {
+    _iface_indent(out, depth);
+    fputs(IFACE_PROT_KEYWORDS[clas->prot], out);
+    IFACE_FLAG(clas->synch, "synch");
+    IFACE_FLAG(clas->virt, "virt");
+    IFACE_FLAG(clas->iface, "iface");
+    IFACE_FLAG(clas->pure, "pure");
+    fputs("class ", out);
+    _iface_write_type(out, clas->decl->data.class.name, 0);
+    for (size_t i = 0; clas->decl->data.class.parents != NULL && i < clas->decl->data.class.parents->entry_count; i++) {
+        fputs(i == 0 ? " : " : ", ", out);
+        _iface_write_type(out, arraylist_getptr(clas->decl->data.class.parents, i), 0);
+    }
+    fputs(" {\n", out);
+    struct arraylist* children = clas->decl->data.class.body->data.body.children;
+    for (size_t i = 0; i < children->entry_count; i++) {
+        _iface_write_member(out, clas->vars, clas->funcs, arraylist_getptr(children, i), depth + 1);
+    }
+    _iface_indent(out, depth);
+    fputs("}\n", out);
+}
+
+void _iface_write_module(FILE* out, struct prog_module* mod, int depth, struct hashset* written);
+
+// a module declared in several places is written whole where it first appears
+void _iface_write_submodule(FILE* out, struct prog_module* sub, int depth, struct hashset* written) {
+    if (sub == NULL || sub->prot == PROTECTION_PRIV || hashset_hasptr(written, sub)) return;
+    hashset_addptr(written, sub);
+    _iface_write_module(out, sub, depth, written);
+}
+
+void _iface_write_module(FILE* out, struct prog_module* mod, int depth, struct hashset* written) {
+    _iface_indent(out, depth);
+    fprintf(out, "%smodule %s {\n", IFACE_PROT_KEYWORDS[mod->prot], mod->name);
+    // signatures can name types from any import, submodules get their parent's implicitly
+    for (size_t i = 0; i < mod->imported_modules->entry_count; i++) {
+        struct prog_module* import = arraylist_getptr(mod->imported_modules, i);
+        if (import == mod->parent) continue;
+        _iface_indent(out, depth + 1);
+        fputs("import ", out);
+        _iface_write_module_path(out, import);
+        fputs(";\n", out);
+    }
+    for (size_t i = 0; i < mod->decls->entry_count; i++) {
+        struct ast_node* decl = arraylist_getptr(mod->decls, i);
+        struct arraylist* children = decl->data.module.body->data.body.children;
+        for (size_t j = 0; j < children->entry_count; j++) {
+            struct ast_node* node = arraylist_getptr(children, j);
+            if (node->type == AST_NODE_CLASS) {
+                struct prog_class* clas = hashmap_get(mod->classes, node->data.class.name->data.type.name);
+                if (clas != NULL && clas->decl == node && clas->prot != PROTECTION_PRIV) _iface_write_class(out, clas, depth + 1);
+            } else if (node->type == AST_NODE_MODULE) {
+                _iface_write_submodule(out, hashmap_get(mod->submodules, arraylist_getptr(node->data.module.name_list, 0)), depth + 1, written);
+            } else {
+                _iface_write_member(out, mod->vars, mod->funcs, node, depth + 1);
+            }
+        }
+    }
+    // parents only named on the way to a nested module have no declaration of their own
+    ITER_MAP(mod->submodules) {
+        _iface_write_submodule(out, value, depth + 1, written);
+    ITER_MAP_END()}
+    _iface_indent(out, depth);
+    fputs("}\n", out);
+}
+
+char* _iface_path(char* dir, char* name) {
+    char* path = NULL;
+    size_t path_len = 0;
+    FILE* out = open_memstream(&path, &path_len);
+    fprintf(out, "%s/%s" PROG_IFACE_EXT, dir, name);
+    fclose(out);
+    return path;
+}
+
+int prog_iface_emit(struct prog_state* state, char* dir) {
+    // interfaces already in dir stay as they were, so this is a failure for the caller to report
+    if (state->errors->entry_count > 0) return -1;
+    if (mkdir(dir, 0775) != 0 && errno != EEXIST) return -1;
+    int failed = 0;
+    ITER_MAP(state->modules) {
+        struct prog_module* mod = value;
+        if (mod->iface) continue;
+        char* path = _iface_path(dir, mod->name);
+        char* tmp_path = NULL;
+        size_t tmp_len = 0;
+        FILE* tmp = open_memstream(&tmp_path, &tmp_len);
+        fprintf(tmp, "%s.tmp", path);
+        fclose(tmp);
+        FILE* out = fopen(tmp_path, "w");
+        if (out == NULL) {
+            failed = 1;
+        } else {
+            fprintf(out, "// interface of module %s, generated by flexc\n", mod->name);
+            struct hashset* written = new_hashset(16);
+            _iface_write_module(out, mod, 0, written);
+            free_hashset(written);
+            failed |= fclose(out) != 0 || rename(tmp_path, path) != 0;
+        }
+        free(tmp_path);
+        free(path);
+    ITER_MAP_END()}
+    return failed ? -1 : 0;
+}
+
+void _iface_mark(struct prog_module* mod) {
+    mod->iface = 1;
+    ITER_MAP(mod->submodules) {
+        _iface_mark(value);
+    ITER_MAP_END()}
+}
+
+// an unusable interface fails the build like any other error, blamed on the import that asked for it
+#define IFACE_ERROR(import, fmt, args) {arraylist_addptr(state->errors, import); fprintf(state->err_out, fmt, args);}
+#define COMMA ,
+
+// lexes and parses an interface file, reporting why it is unusable. the AST and the tokens its strings point into
+// live as long as the state.
+struct ast_node* _iface_parse(struct prog_state* state, char* path, struct arraylist** lines, struct ast_node* import) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) IFACE_ERROR(import, "Error: could not read interface '%s': %s\n", path COMMA strerror(errno));
+        return NULL;
+    }
+    void* content = NULL;
+    ssize_t content_len = readUntilEnd(fd, &content);
+    close(fd);
+    if (content_len < 0) {
+        IFACE_ERROR(import, "Error: could not read interface '%s': %s\n", path COMMA strerror(errno));
+        return NULL;
+    }
+    char* data = content;
+    *lines = arraylist_new(64, sizeof(char*));
+    arraylist_addptr(*lines, data);
+    for (ssize_t i = 0; i < content_len; i++) {
+        if (data[i] == 0 || (unsigned char) data[i] > 0x7F) {
+            IFACE_ERROR(import, "Error: invalid character in interface '%s'\n", path);
+            return NULL;
+        } else if (data[i] == '\n') {
+            data[i] = 0;
+            arraylist_addptr(*lines, data + i + 1);
+        }
+    }
+    struct arraylist* tokens = arraylist_new(128, sizeof(struct token*));
+    tokenize(data, content_len, tokens);
+    for (size_t i = 0; i < tokens->entry_count; i++) {
+        struct token* token = arraylist_getptr(tokens, i);
+        if (token->type == TOKEN_UNKNOWN) {
+            IFACE_ERROR(import, "Error: invalid symbol in interface '%s' @ %lu:%lu: %s\n", path COMMA token->line COMMA token->start_col COMMA token->value);
+            return NULL;
+        }
+    }
+    struct parse_intermediates immed = parse(tokens, *lines, 0);
+    arraylist_free(tokens);
+    if (immed.ctx->parse_errors->entry_count > 0) {
+        struct parse_error* error = arraylist_getptr(immed.ctx->parse_errors, 0);
+        IFACE_ERROR(import, "Error: could not parse interface '%s': %s", path COMMA error->message);
+        return NULL;
+    }
+    return immed.root;
+}
+
+struct prog_module* prog_iface_load(struct prog_state* state, char* name, struct ast_node* import) {
+    if (state->iface_path == NULL) return NULL;
+    char* path = _iface_path(state->iface_path, name);
+    struct arraylist* lines = NULL;
+    struct ast_node* root = _iface_parse(state, path, &lines, import);
+    if (root == NULL) {
+        free(path);
+        return NULL;
+    }
+    struct prog_file* pfile = scalloc(sizeof(struct prog_file));
+    pfile->rel_path = path;
+    pfile->filename = strrchr(path, '/') + 1;
+    pfile->lines = lines;
+    root->data.file.filename = pfile->filename;
+    root->data.file.rel_path = pfile->rel_path;
+    // only the module the file is named for, anything else in it could collide with modules from source
+    for (size_t i = 0; i < root->data.file.body->data.body.children->entry_count; i++) {
+        struct ast_node* module = arraylist_getptr(root->data.file.body->data.body.children, i);
+        if (str_eq(arraylist_getptr(module->data.module.name_list, 0), name)) gen_prog_module(state, pfile, module, NULL);
+    }
+    struct prog_module* mod = hashmap_get(state->modules, name);
+    if (mod == NULL) {
+        IFACE_ERROR(import, "Error: interface '%s' does not declare module %s\n", path COMMA name);
+        return NULL;
+    }
+    _iface_mark(mod);
+    arraylist_addptr(state->iface_files, root);
+    resolve_module_deps(state, mod);
+    return mod;
+}
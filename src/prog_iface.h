@@ -0,0 +1,19 @@
+#ifndef __PROG_IFACE_H__
+#define __PROG_IFACE_H__
+
+#include "prog_ir.h"
+
+#define PROG_IFACE_EXT ".flexi"
+
+// writes <dir>/<module>.flexi for every top level module declared in source. an interface is flex source holding what
+// importers can see: non private classes, function signatures and var types, with bodies and initializers left out.
+// like the incremental store, nothing is written for a build with errors. returns -1 then, as it does on IO errors.
+int prog_iface_emit(struct prog_state* state, char* dir);
+
+// declares the top level module name from <state->iface_path>/name.flexi and resolves its imports. the modules it
+// declares are marked iface, their signatures are visible to importers but no body in them is analyzed.
+// returns NULL if there is no usable interface for name. one that exists but cannot be used is also recorded as an
+// error on import, the node naming the module.
+struct prog_module* prog_iface_load(struct prog_state* state, char* name, struct ast_node* import);
+
+#endif
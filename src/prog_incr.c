@@ -0,0 +1,336 @@
+#include "prog_incr.h"
+#include "smem.h"
+#include "hash.h"
+#include "arraylist.h"
+#include "xstring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INCR_MAGIC "flexc-incremental 1"
+
+struct prog_incr* prog_incr_load(char* path) {
+    struct prog_incr* incr = scalloc(sizeof(struct prog_incr));
+    incr->path = path;
+    incr->prev_files = new_hashmap(64);
+    incr->prev_modules = new_hashmap(64);
+    incr->files = new_hashmap(64);
+    incr->modules = new_hashmap(64);
+    FILE* in = fopen(path, "r");
+    if (in == NULL) return incr;
+    char* line = NULL;
+    size_t line_cap = 0;
+    ssize_t len = getline(&line, &line_cap, in);
+    if (len <= 0 || strncmp(line, INCR_MAGIC "\n", len) != 0) goto corrupt;
+    while ((len = getline(&line, &line_cap, in)) > 0) {
+        if (line[len - 1] == '\n') line[--len] = 0;
+        char* save = NULL;
+        char* kind = strtok_r(line, " ", &save);
+        if (kind == NULL) goto corrupt;
+        if (str_eq(kind, "file")) {
+            char* content = strtok_r(NULL, " ", &save);
+            char* sig = strtok_r(NULL, " ", &save);
+            char* rel_path = strtok_r(NULL, "", &save);
+            if (content == NULL || sig == NULL || rel_path == NULL) goto corrupt;
+            struct prog_incr_file* file = scalloc(sizeof(struct prog_incr_file));
+            file->rel_path = str_dup(rel_path, 0);
+            file->content_hash = strtoull(content, NULL, 16);
+            file->sig_hash = strtoull(sig, NULL, 16);
+            hashmap_put(incr->prev_files, file->rel_path, file);
+        } else if (str_eq(kind, "module")) {
+            char* sig = strtok_r(NULL, " ", &save);
+            char* mod_path = strtok_r(NULL, " ", &save);
+            if (sig == NULL || mod_path == NULL) goto corrupt;
+            struct prog_incr_module* module = scalloc(sizeof(struct prog_incr_module));
+            module->path = str_dup(mod_path, 0);
+            module->sig_hash = strtoull(sig, NULL, 16);
+            module->imports = arraylist_new(4, sizeof(char*));
+            hashmap_put(incr->prev_modules, module->path, module);
+        } else if (str_eq(kind, "import")) {
+            char* mod_path = strtok_r(NULL, " ", &save);
+            char* import = strtok_r(NULL, " ", &save);
+            struct prog_incr_module* module = mod_path == NULL ? NULL : hashmap_get(incr->prev_modules, mod_path);
+            if (module == NULL || import == NULL) goto corrupt;
+            arraylist_addptr(module->imports, str_dup(import, 0));
+        } else {
+            goto corrupt;
+        }
+    }
+    incr->loaded = 1;
+    free(line);
+    fclose(in);
+    return incr;
+    corrupt:;
+    fprintf(stderr, "Warning: ignoring corrupt incremental store '%s'\n", path);
+    free_hashmap(incr->prev_files);
+    free_hashmap(incr->prev_modules);
+    incr->prev_files = new_hashmap(64);
+    incr->prev_modules = new_hashmap(64);
+    free(line);
+    fclose(in);
+    return incr;
+}
+
+void prog_incr_add_file(struct prog_incr* incr, char* rel_path, uint64_t content_hash) {
+    struct prog_incr_file* file = scalloc(sizeof(struct prog_incr_file));
+    file->rel_path = rel_path;
+    file->content_hash = content_hash;
+    struct prog_incr_file* prev = hashmap_get(incr->prev_files, rel_path);
+    file->changed = prev == NULL || prev->content_hash != file->content_hash;
+    hashmap_put(incr->files, rel_path, file);
+}
+
+void _write_sig_type(FILE* out, struct ast_node* type) {
+    if (type == NULL) {
+        fputc('-', out);
+        return;
+    }
+    if (type->type == AST_NODE_FUNC) {
+        // func vars are typed by their declaration
+        _write_sig_type(out, type->data.func.return_type);
+        fputc('(', out);
+        for (size_t i = 0; type->data.func.arguments != NULL && i < type->data.func.arguments->entry_count; i++) {
+            struct ast_node* arg = arraylist_getptr(type->data.func.arguments, i);
+            if (i > 0) fputc(',', out);
+            _write_sig_type(out, arg->data.vardecl.type);
+            if (arg->data.vardecl.init != NULL || arg->data.vardecl.cons_init != NULL) fputc('=', out);
+        }
+        fputc(')', out);
+        return;
+    }
+    if (type->type != AST_NODE_TYPE) {
+        fputc('?', out);
+        return;
+    }
+    fprintf(out, "%s%s%s", type->flags.cons ? "const " : "", type->data.type.name == NULL ? "" : type->data.type.name, type->flags.variadic ? "..." : "");
+    if (type->data.type.generics != NULL) {
+        fputc('<', out);
+        for (size_t i = 0; i < type->data.type.generics->entry_count; i++) {
+            if (i > 0) fputc(',', out);
+            _write_sig_type(out, arraylist_getptr(type->data.type.generics, i));
+        }
+        fputc('>', out);
+    }
+    if (type->flags.protofunc) {
+        fputc('{', out);
+        _write_sig_type(out, type->data.type.protofunc_return_type);
+        for (size_t i = 0; type->data.type.protofunc_arguments != NULL && i < type->data.type.protofunc_arguments->entry_count; i++) {
+            fputc(',', out);
+            _write_sig_type(out, arraylist_getptr(type->data.type.protofunc_arguments, i));
+        }
+        fputc('}', out);
+    }
+    for (uint8_t i = 0; i < type->flags.array_dimensonality; i++) fputs("[]", out);
+    if (type->flags.is_ref) fputc('&', out);
+}
+
+// everything importers can observe of a declaration, bodies and initializers are left out
+void _write_sig_decl(FILE* out, struct ast_node* node) {
+    if (node->type == AST_NODE_FUNC) {
+        struct ast_node_func* func = &node->data.func;
+        fprintf(out, "func %u%u%u%u%u%u%u %s ", node->flags.prot, node->flags.synch, node->flags.virt, node->flags.async, node->flags.csig, node->flags.stat, node->flags.pure, func->name == NULL ? "-" : func->name);
+        _write_sig_type(out, node);
+    } else if (node->type == AST_NODE_VAR_DECL) {
+        struct ast_node_vardecl* var = &node->data.vardecl;
+        fprintf(out, "var %u%u%u%u%u %s ", node->flags.prot, node->flags.synch, node->flags.csig, node->flags.stat, node->flags.cons, var->name);
+        _write_sig_type(out, var->type);
+    } else if (node->type == AST_NODE_CLASS) {
+        struct ast_node_class* clas = &node->data.class;
+        fprintf(out, "class %u%u%u%u%u ", node->flags.prot, node->flags.synch, node->flags.virt, node->flags.iface, node->flags.pure);
+        _write_sig_type(out, clas->name);
+        for (size_t i = 0; clas->parents != NULL && i < clas->parents->entry_count; i++) {
+            fputs(i == 0 ? " : " : ", ", out);
+            _write_sig_type(out, arraylist_getptr(clas->parents, i));
+        }
+        fputs(" {", out);
+        for (size_t i = 0; i < clas->body->data.body.children->entry_count; i++) {
+            struct ast_node* member = arraylist_getptr(clas->body->data.body.children, i);
+            if (member->type != AST_NODE_FUNC && member->type != AST_NODE_VAR_DECL) continue;
+            _write_sig_decl(out, member);
+            fputc(';', out);
+        }
+        fputc('}', out);
+    } else if (node->type == AST_NODE_MODULE) {
+        // only the module's own visibility, its members are hashed one by one
+        fprintf(out, "module %u", node->flags.prot);
+    }
+}
+
+struct prog_incr_module* _incr_module(struct prog_incr* incr, char* parent_path, char* name) {
+    char* path = NULL;
+    size_t path_len = 0;
+    FILE* out = open_memstream(&path, &path_len);
+    if (parent_path != NULL) fprintf(out, "%s.", parent_path);
+    fputs(name, out);
+    fclose(out);
+    struct prog_incr_module* rec = hashmap_get(incr->modules, path);
+    if (rec != NULL) {
+        free(path);
+        return rec;
+    }
+    rec = scalloc(sizeof(struct prog_incr_module));
+    rec->path = path;
+    rec->imports = arraylist_new(4, sizeof(char*));
+    hashmap_put(incr->modules, path, rec);
+    return rec;
+}
+
+void _incr_sig_decl(struct prog_incr_module* rec, struct prog_incr_file* file, struct ast_node* node) {
+    char* sig = NULL;
+    size_t sig_len = 0;
+    FILE* sig_out = open_memstream(&sig, &sig_len);
+    _write_sig_decl(sig_out, node);
+    fclose(sig_out);
+    uint64_t hash = fnv1a_64(sig, sig_len, fnv1a_64(rec->path, strlen(rec->path) + 1, FNV1A_64_INIT));
+    free(sig);
+    // modules can be split over files in any order, so their declarations are summed
+    rec->sig_hash += hash;
+    if (file != NULL) file->sig_hash = fnv1a_64(&hash, sizeof(uint64_t), file->sig_hash);
+}
+
+void _incr_sig_module(struct prog_incr* incr, struct prog_incr_file* file, char* parent_path, struct ast_node* module) {
+    // a dotted module name also declares every module along the way
+    struct prog_incr_module* rec = NULL;
+    for (size_t i = 0; i < module->data.module.name_list->entry_count; i++) {
+        rec = _incr_module(incr, rec == NULL ? parent_path : rec->path, arraylist_getptr(module->data.module.name_list, i));
+        if (file != NULL && file->changed) rec->dirty = 1;
+    }
+    _incr_sig_decl(rec, file, module);
+    for (size_t i = 0; i < module->data.module.body->data.body.children->entry_count; i++) {
+        struct ast_node* node = arraylist_getptr(module->data.module.body->data.body.children, i);
+        if (node->type == AST_NODE_MODULE) {
+            _incr_sig_module(incr, file, rec->path, node);
+            continue;
+        }
+        if (node->type != AST_NODE_FUNC && node->type != AST_NODE_VAR_DECL && node->type != AST_NODE_CLASS) continue;
+        _incr_sig_decl(rec, file, node);
+    }
+}
+
+void _incr_bind_module(struct prog_incr* incr, char* parent_path, struct prog_module* mod) {
+    struct prog_incr_module* rec = _incr_module(incr, parent_path, mod->name);
+    rec->mod = mod;
+    hashmap_putptr(incr->bound, mod, rec);
+    ITER_MAP(mod->submodules) {
+        _incr_bind_module(incr, rec->path, value);
+    ITER_MAP_END()}
+}
+
+int _incr_imports_changed(struct prog_incr_module* rec, struct prog_incr_module* prev) {
+    if (rec->imports->entry_count != prev->imports->entry_count) return 1;
+    for (size_t i = 0; i < rec->imports->entry_count; i++) {
+        if (!str_eq(arraylist_getptr(rec->imports, i), arraylist_getptr(prev->imports, i))) return 1;
+    }
+    return 0;
+}
+
+void prog_incr_mark_clean(struct prog_incr* incr, struct prog_state* state, struct arraylist* files) {
+    for (size_t i = 0; i < files->entry_count; i++) {
+        struct ast_node* root = arraylist_getptr(files, i);
+        struct prog_incr_file* file = hashmap_get(incr->files, root->data.file.rel_path);
+        if (file != NULL) file->sig_hash = FNV1A_64_INIT;
+        for (size_t j = 0; j < root->data.file.body->data.body.children->entry_count; j++) {
+            _incr_sig_module(incr, file, NULL, arraylist_getptr(root->data.file.body->data.body.children, j));
+        }
+        if (file != NULL && file->changed) state->stats.files_changed++;
+    }
+    // interfaces are not tracked as files, but a changed one still has to reach the modules importing it
+    for (size_t i = 0; i < state->iface_files->entry_count; i++) {
+        struct ast_node* root = arraylist_getptr(state->iface_files, i);
+        for (size_t j = 0; j < root->data.file.body->data.body.children->entry_count; j++) {
+            _incr_sig_module(incr, NULL, NULL, arraylist_getptr(root->data.file.body->data.body.children, j));
+        }
+    }
+    incr->bound = new_hashmap(64);
+    ITER_MAP(state->modules) {
+        _incr_bind_module(incr, NULL, value);
+    ITER_MAP_END()}
+    // dependents of a module are the modules importing it, directly or through one of their parents
+    struct hashmap* dependents = new_hashmap(64);
+    ITER_MAP(incr->modules) {
+        struct prog_incr_module* rec = value;
+        if (rec->mod == NULL) continue;
+        for (size_t i = 0; i < rec->mod->imported_modules->entry_count; i++) {
+            struct prog_incr_module* import = hashmap_getptr(incr->bound, arraylist_getptr(rec->mod->imported_modules, i));
+            if (import != NULL) arraylist_addptr(rec->imports, import->path);
+        }
+        for (struct prog_module* cur = rec->mod; cur != NULL; cur = cur->parent) {
+            for (size_t i = 0; i < cur->imported_modules->entry_count; i++) {
+                struct prog_module* import = arraylist_getptr(cur->imported_modules, i);
+                struct arraylist* list = hashmap_getptr(dependents, import);
+                if (list == NULL) {
+                    list = arraylist_new(4, sizeof(struct prog_module*));
+                    hashmap_putptr(dependents, import, list);
+                }
+                arraylist_addptr(list, rec->mod);
+            }
+        }
+    ITER_MAP_END()}
+    // a changed signature dirties every module that can see it, imports are followed transitively
+    // since member types of one import can name types of the next
+    struct arraylist* changed = arraylist_new(16, sizeof(struct prog_module*));
+    ITER_MAP(incr->modules) {
+        struct prog_incr_module* rec = value;
+        struct prog_incr_module* prev = hashmap_get(incr->prev_modules, rec->path);
+        if (!incr->loaded || prev == NULL || _incr_imports_changed(rec, prev)) rec->dirty = 1;
+        if (rec->mod != NULL && (prev == NULL || prev->sig_hash != rec->sig_hash)) arraylist_addptr(changed, rec->mod);
+    ITER_MAP_END()}
+    // modules that disappeared are caught by their importers failing to resolve them
+    for (size_t i = 0; i < changed->entry_count; i++) {
+        struct arraylist* list = hashmap_getptr(dependents, arraylist_getptr(changed, i));
+        if (list == NULL) continue;
+        for (size_t j = 0; j < list->entry_count; j++) {
+            struct prog_module* dependent = arraylist_getptr(list, j);
+            struct prog_incr_module* rec = hashmap_getptr(incr->bound, dependent);
+            if (rec == NULL || rec->dirty == 2) continue;
+            rec->dirty = 2; // reached through a signature, already queued
+            arraylist_addptr(changed, dependent);
+        }
+    }
+    ITER_MAP(incr->modules) {
+        struct prog_incr_module* rec = value;
+        if (rec->mod == NULL) continue;
+        rec->mod->clean = !rec->dirty;
+        if (rec->dirty) {
+            state->stats.modules_dirty++;
+        } else {
+            state->stats.modules_clean++;
+        }
+    ITER_MAP_END()}
+    ITER_MAP(dependents) {
+        arraylist_free(value);
+    ITER_MAP_END()}
+    free_hashmap(dependents);
+    arraylist_free(changed);
+}
+
+int prog_incr_save(struct prog_incr* incr, struct prog_state* state) {
+    // a build with errors leaves the last good store in place, so everything changed since is analyzed again
+    if (state->errors->entry_count > 0) return 0;
+    char* tmp_path = NULL;
+    size_t tmp_len = 0;
+    FILE* tmp = open_memstream(&tmp_path, &tmp_len);
+    fprintf(tmp, "%s.tmp", incr->path);
+    fclose(tmp);
+    FILE* out = fopen(tmp_path, "w");
+    if (out == NULL) {
+        free(tmp_path);
+        return -1;
+    }
+    fputs(INCR_MAGIC "\n", out);
+    ITER_MAP(incr->files) {
+        struct prog_incr_file* file = value;
+        fprintf(out, "file %016lx %016lx %s\n", file->content_hash, file->sig_hash, file->rel_path);
+    ITER_MAP_END()}
+    ITER_MAP(incr->modules) {
+        struct prog_incr_module* rec = value;
+        if (rec->mod == NULL) continue;
+        fprintf(out, "module %016lx %s\n", rec->sig_hash, rec->path);
+        for (size_t i = 0; i < rec->imports->entry_count; i++) {
+            fprintf(out, "import %s %s\n", rec->path, (char*) arraylist_getptr(rec->imports, i));
+        }
+    ITER_MAP_END()}
+    int failed = fclose(out) != 0 || rename(tmp_path, incr->path) != 0;
+    free(tmp_path);
+    return failed ? -1 : 0;
+}
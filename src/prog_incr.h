@@ -0,0 +1,44 @@
+#ifndef __PROG_INCR_H__
+#define __PROG_INCR_H__
+
+#include "prog_ir.h"
+
+struct prog_incr_file {
+    char* rel_path;
+    uint64_t content_hash;
+    uint64_t sig_hash; // declaration signatures in the file, bodies and initializers excluded
+    uint8_t changed; // new, or its content hash differs from the last build
+};
+
+struct prog_incr_module {
+    char* path; // dotted path from the top level module
+    uint64_t sig_hash; // over every file declaring the module, independent of file order
+    struct arraylist* imports; // char* paths of the modules in its imported_modules
+    struct prog_module* mod; // NULL for modules read back from the store
+    uint8_t dirty;
+};
+
+// fingerprints of the last build, compared against the current one to find the modules that need analysis again
+struct prog_incr {
+    char* path;
+    uint8_t loaded; // a store from a build without errors was read from path
+    struct hashmap* prev_files; // rel_path -> prog_incr_file*
+    struct hashmap* prev_modules; // module path -> prog_incr_module*
+    struct hashmap* files; // same as above, for this build
+    struct hashmap* modules;
+    struct hashmap* bound; // prog_module* -> prog_incr_module*
+};
+
+// a missing or unreadable store is not an error, everything is analyzed and the store is written fresh
+struct prog_incr* prog_incr_load(char* path);
+
+// content_hash is fnv1a_64 of the file as read, before the lexer splits it into lines
+void prog_incr_add_file(struct prog_incr* incr, char* rel_path, uint64_t content_hash);
+
+// sets prog_module.clean on modules whose files and imported signatures did not change since the last build.
+// runs after resolve_module_deps.
+void prog_incr_mark_clean(struct prog_incr* incr, struct prog_state* state, struct arraylist* files);
+
+int prog_incr_save(struct prog_incr* incr, struct prog_state* state);
+
+#endif
@@ -4,28 +4,38 @@
 #include "hash.h"
 #include "arraylist.h"
 #include "xstring.h"
+#include "prog_scope.h"
+#include "task_pool.h"
+#include "prog_reach.h"
+#include "prog_incr.h"
+#include "prog_iface.h"
+#include "time_report.h"
+#include "trace.h"
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 // 256 spaces
 const char* whitespace = "                                                                                                                                                                                                                                                                ";
 
 #define COMMA ,
-#define PROG_ERROR(node, fmt, args) {arraylist_addptr(state->errors, node); fprintf(stderr, fmt "\n", args);}
-#define PROG_ERROR_AST(module, node, expecting) PROG_ERROR(node, "Error: %s @ %lu:%lu.\n%s\n%s^", expecting COMMA node->start_line COMMA node->start_col COMMA arraylist_getptr(module->file->lines, node->start_line - 1) COMMA whitespace + ((node->start_col - 1) > 256 ? 0 : (256 - (node->start_col - 1))))
+#define PROG_ERROR(node, fmt, args) {arraylist_addptr(state->errors, node); fprintf(state->err_out, fmt "\n", args);}
+#define PROG_ERROR_AST(module, node, expecting) PROG_ERROR(node, "Error: %s @ %u:%u.\n%s\n%s^", expecting COMMA node->start_line COMMA node->start_col COMMA arraylist_getptr(module->file->lines, node->start_line - 1) COMMA whitespace + ((node->start_col - 1) > 256 ? 0 : (256 - (node->start_col - 1))))
 
 const char* operator_fns[] = {"op_member", "op_sequence", "op_eq_val", "op_neq_val", "op_eq", "op_neq", "op_mul", "op_div", "op_mod", "op_plus", "op_minus", "op_lsh", "op_rsh", "op_lt", "op_lte", "op_gt", "op_gte", "op_inst", "op_and", "op_xor", "op_or", "op_land", "op_lor", "op_assn", "op_mul_assn", "op_div_assn", "op_mod_assn", "op_plus_assn", "op_minus_assn", "op_lsh_assn", "op_rsh_assn", "op_and_assn", "op_xor_assn", "op_or_assn", "op_land_assn", "op_lor_assn", "op_mul_assn_pre", "op_div_assn_pre", "op_mod_assn_pre", "op_plus_assn_pre", "op_minus_assn_pre", "op_lsh_assn_pre", "op_rsh_assn_pre", "op_and_assn_pre", "op_xor_assn_pre", "op_or_assn_pre", "op_land_assn_pre", "op_lor_assn_pre"};
 
 struct prog_type* gen_prog_type(struct prog_state* state, struct ast_node* node, struct prog_file* file, uint8_t is_master, uint8_t is_const, uint8_t is_generic) {
     if (node == NULL) return NULL;
-    struct prog_type* t = scalloc(sizeof(struct prog_type));
+    struct prog_type* t = scallocTag(sizeof(struct prog_type), SMEM_TAG_PROG_TYPE);
     t->type = PROG_TYPE_UNKNOWN;
     t->is_master = is_master;
     t->is_const = is_const;
     t->file = file;
     t->master_type = NULL;
     t->ast = node;
+    __atomic_fetch_add(&state->shared->stats.types_generated, 1, __ATOMIC_RELAXED);
     if (node->type == AST_NODE_TYPE) {
-        if (node->data.type.protofunc) {
+        if (node->flags.protofunc) {
             t->type = PROG_TYPE_FUNC;
             t->data.func.return_type = gen_prog_type(state, node->data.type.protofunc_return_type, file, 0, 0, 0);
             t->data.func.arg_types = node->data.type.protofunc_arguments == NULL ? NULL : arraylist_new(node->data.type.protofunc_arguments->entry_count, sizeof(struct prog_type*));
@@ -35,9 +45,9 @@ struct prog_type* gen_prog_type(struct prog_state* state, struct ast_node* node,
                 }
             }
         } else {
-            t->variadic = node->data.type.variadic;
-            t->array_dimensonality = node->data.type.array_dimensonality;
-            t->is_ref = node->data.type.is_ref;
+            t->variadic = node->flags.variadic;
+            t->array_dimensonality = node->flags.array_dimensonality;
+            t->is_ref = node->flags.is_ref;
             t->name = node->data.type.name;
             if (node->data.type.generics != NULL) {
                 t->generics = new_hashmap(4);
@@ -155,7 +165,7 @@ struct preprocess_ctx {
     struct prog_file* file;
 };
 
-struct ast_node* preprocess_expr(struct ast_node* node, struct preprocess_ctx* ctx);
+void preprocess_node(struct preprocess_ctx* ctx, struct ast_node* node);
 
 struct prog_func* gen_prog_func_func(struct prog_state* state, struct prog_file* file, struct ast_node* func, struct prog_func* parent) {
     struct prog_func* fun = scalloc(sizeof(struct prog_func));
@@ -165,12 +175,12 @@ struct prog_func* gen_prog_func_func(struct prog_state* state, struct prog_file*
     fun->file = file;
     fun->closures = arraylist_new(4, sizeof(struct prog_func*));
     fun->prot = PROTECTION_PRIV;
-    fun->virt = func->data.func.virt;
-    fun->synch = func->data.func.synch;
-    fun->csig = func->data.func.csig;
-    fun->async = func->data.func.async;
-    fun->pure = func->data.func.pure || parent->pure;
-    fun->stat = func->data.func.stat;
+    fun->virt = func->flags.virt;
+    fun->synch = func->flags.synch;
+    fun->csig = func->flags.csig;
+    fun->async = func->flags.async;
+    fun->pure = func->flags.pure || parent->pure;
+    fun->stat = func->flags.stat;
     fun->arguments = new_hashmap(4);
     fun->arguments_list = arraylist_new(16, sizeof(struct prog_var*));
     fun->node_map = new_hashmap(4);
@@ -179,7 +189,7 @@ struct prog_func* gen_prog_func_func(struct prog_state* state, struct prog_file*
     for (size_t i = 0; i < func->data.func.arguments->entry_count; i++) {
         struct ast_node* arg = arraylist_getptr(func->data.func.arguments, i);
         struct prog_var* var = scalloc(sizeof(struct prog_var));
-        var->uid = state->next_var_id++;
+        var->uid = __atomic_fetch_add(&state->shared->next_var_id, 1, __ATOMIC_RELAXED);
         var->name = arg->data.vardecl.name;
         var->func = fun;
         var->file = fun->file;
@@ -187,19 +197,19 @@ struct prog_func* gen_prog_func_func(struct prog_state* state, struct prog_file*
         var->type = gen_prog_type(state, arg->data.vardecl.type, file, 0, 0, 0);
         var->type->is_optional = var->proc.init != NULL || var->proc.cons_init != NULL;
         var->proc.init = arg->data.vardecl.init;
-        if (var->proc.init != NULL) traverse_node(var->proc.init, preprocess_expr, &lctx, 1);
+        if (var->proc.init != NULL) preprocess_node(&lctx, var->proc.init);
         var->proc.cons_init = arg->data.vardecl.cons_init;
         if (var->proc.cons_init != NULL) {
             for (size_t j = 0; j < var->proc.cons_init->entry_count; j++) {
-                if (var->proc.init != NULL) traverse_node(arraylist_getptr(var->proc.cons_init, j), preprocess_expr, &lctx, 1);
+                if (var->proc.init != NULL) preprocess_node(&lctx, arraylist_getptr(var->proc.cons_init, j));
             }
         }
-        hashmap_put(fun->arguments, var->name, var)
+        hashmap_put(fun->arguments, var->name, var);
         arraylist_addptr(fun->arguments_list, var);
     }
     fun->return_type = gen_prog_type(state, func->data.func.return_type, file, 0, 0, 0);
     fun->proc.body = func->data.func.body;
-    traverse_node(fun->proc.body, preprocess_expr, &lctx, 1);
+    preprocess_node(&lctx, fun->proc.body);
     arraylist_addptr(parent->closures, fun);
     return fun;
 }
@@ -207,12 +217,13 @@ struct prog_func* gen_prog_func_func(struct prog_state* state, struct prog_file*
 struct prog_func* gen_prog_clas_func(struct prog_state* state, struct prog_file* file, struct ast_node* func, struct prog_class* parent);
 struct prog_func* gen_prog_mod_func(struct prog_state* state, struct prog_file* file, struct ast_node* func, struct prog_module* parent);
 
-struct ast_node* preprocess_expr(struct ast_node* node, struct preprocess_ctx* ctx) {
+int preprocess_expr(struct ast_node* node, void* arg) {
+    struct preprocess_ctx* ctx = arg;
     if (node->type == AST_NODE_TYPE) {
         node->prog = scalloc(sizeof(struct prog_node));
         node->prog->ast_node = node;
         node->prog->prog_type = PROG_NODE_TYPE;
-        node->prog->data.type = gen_prog_type(ctx->state, node, ctx->file, 0, node->data.type.cons, 1);
+        node->prog->data.type = gen_prog_type(ctx->state, node, ctx->file, 0, node->flags.cons, 1);
         struct hashmap *om = NULL;
         if (ctx->func != NULL) {
             om = ctx->func->node_map;
@@ -224,8 +235,8 @@ struct ast_node* preprocess_expr(struct ast_node* node, struct preprocess_ctx* c
         if (om != NULL) hashmap_putptr(om, node, node->prog);
         hashmap_putptr(ctx->state->node_map, node, node->prog);
     } else if (node->type == AST_NODE_VAR_DECL) {
-        if (node->data.vardecl.cons) {
-            node->data.vardecl.type->data.type.cons = 1;
+        if (node->flags.cons) {
+            node->data.vardecl.type->flags.cons = 1;
         }
     } else if (node->type == AST_NODE_FUNC) {
         node->prog = scalloc(sizeof(struct prog_node));
@@ -241,8 +252,42 @@ struct ast_node* preprocess_expr(struct ast_node* node, struct preprocess_ctx* c
         } else if (ctx->module != NULL) {
             node->prog->data.func = gen_prog_mod_func(ctx->state, ctx->file, node, ctx->module);
         }
+        // the body was preprocessed in the func's own context above, only the signature belongs to this one
+        if (node->data.func.return_type != NULL) preprocess_node(ctx, node->data.func.return_type);
+        if (node->data.func.arguments != NULL) {
+            for (size_t i = 0; i < node->data.func.arguments->entry_count; i++) {
+                preprocess_node(ctx, arraylist_getptr(node->data.func.arguments, i));
+            }
+        }
+        return AST_VISIT_SKIP;
+    }
+    return AST_VISIT_CONTINUE;
+}
+
+void preprocess_node(struct preprocess_ctx* ctx, struct ast_node* node) {
+    struct ast_visitor visitor = {preprocess_expr, NULL, ctx};
+    visit_node(node, &visitor);
+}
+
+struct ast_node* prog_func_body(struct prog_state* state, struct prog_func* func) {
+    struct ast_node* body = func->proc.body;
+    if (body == NULL || body->type != AST_NODE_LAZY_BODY) return body;
+    struct parse_ctx* ctx = body->data.lazy_body.ctx;
+    size_t prior_errors = ctx->parse_errors->entry_count;
+    func->proc.body = ast_func_body(func->proc.root);
+    state->stats.bodies_parsed++;
+    if (ctx->parse_errors->entry_count > prior_errors) {
+        for (size_t i = prior_errors; i < ctx->parse_errors->entry_count; i++) {
+            struct parse_error* error = arraylist_getptr(ctx->parse_errors, i);
+            fprintf(state->err_out, "%s\n", error->message);
+        }
+        state->parse_errors += ctx->parse_errors->entry_count - prior_errors;
+        return NULL;
     }
-    return node;
+    // the same context gen_prog_*_func preprocess a parsed body in
+    struct preprocess_ctx lctx = (struct preprocess_ctx) {state, func, NULL, NULL, func->file};
+    preprocess_node(&lctx, func->proc.body);
+    return func->proc.body;
 }
 
 struct prog_func* gen_prog_clas_func(struct prog_state* state, struct prog_file* file, struct ast_node* func, struct prog_class* parent) {
@@ -252,13 +297,13 @@ struct prog_func* gen_prog_clas_func(struct prog_state* state, struct prog_file*
     fun->clas = parent;
     fun->file = file;
     fun->closures = arraylist_new(4, sizeof(struct prog_func*));
-    fun->prot = parent->prot == PROTECTION_NONE || parent->prot >= func->data.func.prot ? func->data.func.prot : parent->prot;
-    fun->virt = func->data.func.virt || parent->iface;
-    fun->synch = func->data.func.synch;
-    fun->csig = func->data.func.csig;
-    fun->async = func->data.func.async;
-    fun->stat = func->data.func.stat;
-    fun->pure = func->data.func.pure || parent->pure;
+    fun->prot = parent->prot == PROTECTION_NONE || parent->prot >= func->flags.prot ? func->flags.prot : parent->prot;
+    fun->virt = func->flags.virt || parent->iface;
+    fun->synch = func->flags.synch;
+    fun->csig = func->flags.csig;
+    fun->async = func->flags.async;
+    fun->stat = func->flags.stat;
+    fun->pure = func->flags.pure || parent->pure;
     fun->arguments = new_hashmap(4);
     fun->arguments_list = arraylist_new(16, sizeof(struct prog_var*));
     fun->node_map = new_hashmap(4);
@@ -273,7 +318,7 @@ struct prog_func* gen_prog_clas_func(struct prog_state* state, struct prog_file*
         for (size_t i = 0; i < func->data.func.arguments->entry_count; i++) {
             struct ast_node* arg = arraylist_getptr(func->data.func.arguments, i);
             struct prog_var* var = scalloc(sizeof(struct prog_var));
-            var->uid = state->next_var_id++;
+            var->uid = __atomic_fetch_add(&state->shared->next_var_id, 1, __ATOMIC_RELAXED);
             var->name = arg->data.vardecl.name;
             var->func = fun;
             var->file = fun->file;
@@ -281,11 +326,11 @@ struct prog_func* gen_prog_clas_func(struct prog_state* state, struct prog_file*
             var->type = gen_prog_type(state, arg->data.vardecl.type, fun->file, 0, 0, 0);
             var->type->is_optional = var->proc.init != NULL || var->proc.cons_init != NULL;
             var->proc.init = arg->data.vardecl.init;
-            if (var->proc.init != NULL) traverse_node(var->proc.init, preprocess_expr, &lctx, 1);
+            if (var->proc.init != NULL) preprocess_node(&lctx, var->proc.init);
             var->proc.cons_init = arg->data.vardecl.cons_init;
             if (var->proc.cons_init != NULL) {
                 for (size_t j = 0; j < var->proc.cons_init->entry_count; j++) {
-                    if (var->proc.init != NULL) traverse_node(arraylist_getptr(var->proc.cons_init, j), preprocess_expr, &lctx, 1);
+                    if (var->proc.init != NULL) preprocess_node(&lctx, arraylist_getptr(var->proc.cons_init, j));
                 }
             }
             hashmap_put(fun->arguments, var->name, var);
@@ -293,7 +338,7 @@ struct prog_func* gen_prog_clas_func(struct prog_state* state, struct prog_file*
         }
     fun->return_type = gen_prog_type(state, func->data.func.return_type, fun->file, 0, 0, 0);
     fun->proc.body = func->data.func.body;
-    traverse_node(fun->proc.body, preprocess_expr, &lctx, 1);
+    preprocess_node(&lctx, fun->proc.body);
     if (fun->name == NULL) {
         hashmap_putptr(parent->funcs, fun, fun);
     } else {
@@ -301,7 +346,7 @@ struct prog_func* gen_prog_clas_func(struct prog_state* state, struct prog_file*
     }
     if (fun->name != NULL) {
         struct prog_var* var = scalloc(sizeof(struct prog_var));
-        var->uid = state->next_var_id++;
+        var->uid = __atomic_fetch_add(&state->shared->next_var_id, 1, __ATOMIC_RELAXED);
         var->name = fun->name;
         var->clas = parent;
         var->file = parent->file;
@@ -311,6 +356,8 @@ struct prog_func* gen_prog_clas_func(struct prog_state* state, struct prog_file*
         var->cons = 1;
         var->stat = fun->stat;
         var->type = gen_prog_type(state, func, fun->file, 0, 1, 0);
+        var->pre_alloc_func = fun;
+        var->decl = func;
         hashmap_put(parent->vars, var->name, var);
     }
     return fun;
@@ -318,23 +365,24 @@ struct prog_func* gen_prog_clas_func(struct prog_state* state, struct prog_file*
 
 void gen_prog_clas_var(struct prog_state* state, struct prog_file* file, struct ast_node* vard, struct prog_class* parent) {
     struct prog_var* var = scalloc(sizeof(struct prog_var));
-    var->uid = state->next_var_id++;
+    var->uid = __atomic_fetch_add(&state->shared->next_var_id, 1, __ATOMIC_RELAXED);
     var->name = vard->data.vardecl.name;
     var->clas = parent;
     var->file = file;
-    var->prot = parent->prot == PROTECTION_NONE || parent->prot >= vard->data.vardecl.prot ? vard->data.vardecl.prot : parent->prot;
-    var->synch = vard->data.vardecl.synch;
-    var->csig = vard->data.vardecl.csig;
-    var->stat = vard->data.vardecl.stat;
-    var->cons = vard->data.vardecl.cons;
+    var->prot = parent->prot == PROTECTION_NONE || parent->prot >= vard->flags.prot ? vard->flags.prot : parent->prot;
+    var->synch = vard->flags.synch;
+    var->csig = vard->flags.csig;
+    var->stat = vard->flags.stat;
+    var->cons = vard->flags.cons;
     var->type = gen_prog_type(state, vard->data.vardecl.type, file, 0, var->cons, 0);
     var->proc.init = vard->data.vardecl.init;
+    var->decl = vard;
     struct preprocess_ctx lctx = (struct preprocess_ctx) {state, NULL, parent, NULL, file};
-    if (var->proc.init != NULL) traverse_node(var->proc.init, preprocess_expr, &lctx, 1);
+    if (var->proc.init != NULL) preprocess_node(&lctx, var->proc.init);
     var->proc.cons_init = vard->data.vardecl.cons_init;
     if (var->proc.cons_init != NULL) {
         for (size_t j = 0; j < var->proc.cons_init->entry_count; j++) {
-            if (var->proc.init != NULL) traverse_node(arraylist_getptr(var->proc.cons_init, j), preprocess_expr, &lctx, 1);
+            if (var->proc.init != NULL) preprocess_node(&lctx, arraylist_getptr(var->proc.cons_init, j));
         }
     }
     hashmap_put(parent->vars, var->name, var);
@@ -345,13 +393,14 @@ void gen_prog_class(struct prog_state* state, struct prog_file* file, struct ast
     cl->name = clas->data.class.name->data.type.name;
     cl->type = gen_prog_type(state, clas->data.class.name, file, 1, 0, 0);
     cl->file = file;
+    cl->decl = clas;
     cl->type->type = PROG_TYPE_CLASS;
     cl->type->data.clas.clas = cl;
-    cl->prot = parent->prot == PROTECTION_NONE || parent->prot >= clas->data.module.prot ? clas->data.module.prot : parent->prot;
-    cl->virt = clas->data.class.virt;
-    cl->synch = clas->data.class.synch;
-    cl->iface = clas->data.class.iface;
-    cl->pure = clas->data.class.pure;
+    cl->prot = parent->prot == PROTECTION_NONE || parent->prot >= clas->flags.prot ? clas->flags.prot : parent->prot;
+    cl->virt = clas->flags.virt;
+    cl->synch = clas->flags.synch;
+    cl->iface = clas->flags.iface;
+    cl->pure = clas->flags.pure;
     cl->module = parent;
     cl->vars = new_hashmap(4);
     cl->node_map = new_hashmap(4);
@@ -381,13 +430,13 @@ struct prog_func* gen_prog_mod_func(struct prog_state* state, struct prog_file*
     fun->module = parent;
     fun->file = file;
     fun->closures = arraylist_new(4, sizeof(struct prog_func*));
-    fun->prot = parent->prot == PROTECTION_NONE || parent->prot >= func->data.func.prot ? func->data.func.prot : parent->prot;
-    fun->virt = func->data.func.virt;
-    fun->synch = func->data.func.synch;
-    fun->csig = func->data.func.csig;
-    fun->async = func->data.func.async;
-    fun->pure = func->data.func.pure;
-    fun->stat = func->data.func.stat;
+    fun->prot = parent->prot == PROTECTION_NONE || parent->prot >= func->flags.prot ? func->flags.prot : parent->prot;
+    fun->virt = func->flags.virt;
+    fun->synch = func->flags.synch;
+    fun->csig = func->flags.csig;
+    fun->async = func->flags.async;
+    fun->pure = func->flags.pure;
+    fun->stat = func->flags.stat;
     fun->arguments = new_hashmap(4);
     fun->arguments_list = arraylist_new(16, sizeof(struct prog_var*));
     fun->node_map = new_hashmap(4);
@@ -402,7 +451,7 @@ struct prog_func* gen_prog_mod_func(struct prog_state* state, struct prog_file*
         for (size_t i = 0; i < func->data.func.arguments->entry_count; i++) {
             struct ast_node* arg = arraylist_getptr(func->data.func.arguments, i);
             struct prog_var* var = scalloc(sizeof(struct prog_var));
-            var->uid = state->next_var_id++;
+            var->uid = __atomic_fetch_add(&state->shared->next_var_id, 1, __ATOMIC_RELAXED);
             var->name = arg->data.vardecl.name;
             var->func = fun;
             var->file = fun->file;
@@ -410,11 +459,11 @@ struct prog_func* gen_prog_mod_func(struct prog_state* state, struct prog_file*
             var->type = gen_prog_type(state, arg->data.vardecl.type, file, 0, 0, 0);
             var->type->is_optional = var->proc.init != NULL || var->proc.cons_init != NULL;
             var->proc.init = arg->data.vardecl.init;
-            if (var->proc.init != NULL) traverse_node(var->proc.init, preprocess_expr, &lctx, 1);
+            if (var->proc.init != NULL) preprocess_node(&lctx, var->proc.init);
             var->proc.cons_init = arg->data.vardecl.cons_init;
             if (var->proc.cons_init != NULL) {
                 for (size_t j = 0; j < var->proc.cons_init->entry_count; j++) {
-                    if (var->proc.init != NULL) traverse_node(arraylist_getptr(var->proc.cons_init, j), preprocess_expr, &lctx, 1);
+                    if (var->proc.init != NULL) preprocess_node(&lctx, arraylist_getptr(var->proc.cons_init, j));
                 }
             }
             hashmap_put(fun->arguments, var->name, var);
@@ -422,7 +471,7 @@ struct prog_func* gen_prog_mod_func(struct prog_state* state, struct prog_file*
         }
     fun->return_type = gen_prog_type(state, func->data.func.return_type, file, 0, 0, 0);
     fun->proc.body = func->data.func.body;
-    traverse_node(fun->proc.body, preprocess_expr, &lctx, 1);
+    preprocess_node(&lctx, fun->proc.body);
     if (fun->name == NULL) {
         hashmap_putptr(parent->funcs, fun, fun);
     } else {
@@ -430,7 +479,7 @@ struct prog_func* gen_prog_mod_func(struct prog_state* state, struct prog_file*
     }
     if (fun->name != NULL) {
         struct prog_var* var = scalloc(sizeof(struct prog_var));
-        var->uid = state->next_var_id++;
+        var->uid = __atomic_fetch_add(&state->shared->next_var_id, 1, __ATOMIC_RELAXED);
         var->name = fun->name;
         var->file = fun->file;
         var->module = parent;
@@ -440,6 +489,8 @@ struct prog_func* gen_prog_mod_func(struct prog_state* state, struct prog_file*
         var->cons = 1;
         var->stat = fun->stat;
         var->type = gen_prog_type(state, func, fun->file, 0, 1, 0);
+        var->pre_alloc_func = fun;
+        var->decl = func;
         hashmap_put(parent->vars, var->name, var);
     }
     return fun;
@@ -447,23 +498,24 @@ struct prog_func* gen_prog_mod_func(struct prog_state* state, struct prog_file*
 
 void gen_prog_mod_var(struct prog_state* state, struct prog_file* file, struct ast_node* vard, struct prog_module* parent) {
     struct prog_var* var = scalloc(sizeof(struct prog_var));
-    var->uid = state->next_var_id++;
+    var->uid = __atomic_fetch_add(&state->shared->next_var_id, 1, __ATOMIC_RELAXED);
     var->name = vard->data.vardecl.name;
     var->module = parent;
     var->file = file;
-    var->prot = parent->prot == PROTECTION_NONE || parent->prot >= vard->data.vardecl.prot ? vard->data.vardecl.prot : parent->prot;
-    var->synch = vard->data.vardecl.synch;
-    var->csig = vard->data.vardecl.csig;
-    var->stat = vard->data.vardecl.stat;
-    var->cons = vard->data.vardecl.cons;
+    var->prot = parent->prot == PROTECTION_NONE || parent->prot >= vard->flags.prot ? vard->flags.prot : parent->prot;
+    var->synch = vard->flags.synch;
+    var->csig = vard->flags.csig;
+    var->stat = vard->flags.stat;
+    var->cons = vard->flags.cons;
     var->type = gen_prog_type(state, vard->data.vardecl.type, file, 0, var->cons, 0);
     var->proc.init = vard->data.vardecl.init;
+    var->decl = vard;
     struct preprocess_ctx lctx = (struct preprocess_ctx) {state, NULL, NULL, parent, file};
-    if (var->proc.init != NULL) traverse_node(var->proc.init, preprocess_expr, &lctx, 1);
+    if (var->proc.init != NULL) preprocess_node(&lctx, var->proc.init);
     var->proc.cons_init = vard->data.vardecl.cons_init;
     if (var->proc.cons_init != NULL) {
         for (size_t j = 0; j < var->proc.cons_init->entry_count; j++) {
-            if (var->proc.init != NULL) traverse_node(arraylist_getptr(var->proc.cons_init, j), preprocess_expr, &lctx, 1);
+            if (var->proc.init != NULL) preprocess_node(&lctx, arraylist_getptr(var->proc.cons_init, j));
         }
     }
     hashmap_put(parent->vars, var->name, var);
@@ -491,7 +543,7 @@ void gen_prog_module(struct prog_state* state, struct prog_file* file, struct as
             mod = scalloc(sizeof(struct prog_module));
             mod->name = ident;
             if (is_last) {
-                mod->prot = module->data.module.prot;
+                mod->prot = module->flags.prot;
             } else {
                 mod->prot = PROTECTION_NONE;
             }
@@ -503,9 +555,10 @@ void gen_prog_module(struct prog_state* state, struct prog_file* file, struct as
             mod->funcs = new_hashmap(4);
             mod->types = new_hashmap(16);
             mod->imported_modules = arraylist_new(4, sizeof(struct ast_node *));
+            mod->decls = arraylist_new(1, sizeof(struct ast_node*));
             mod->parent = parent;
         } else {
-            if (is_last && mod->prot != module->data.module.prot) {
+            if (is_last && mod->prot != module->flags.prot) {
                 PROG_ERROR_AST((&file_cont), module, "conflicting module properties");
             }
         }
@@ -518,6 +571,7 @@ void gen_prog_module(struct prog_state* state, struct prog_file* file, struct as
     if (mod == NULL) {
         return;
     }
+    arraylist_addptr(mod->decls, module);
     for (size_t i = 0; i < module->data.module.body->data.body.children->entry_count; i++) {
         struct ast_node* node = arraylist_getptr(module->data.module.body->data.body.children, i);
         if (node->type == AST_NODE_MODULE) {
@@ -537,17 +591,22 @@ void gen_prog_module(struct prog_state* state, struct prog_file* file, struct as
     }
 }
 
+// checks the local import additions of mod and all of its parents
+int module_imports(struct prog_module* mod, struct prog_module* import) {
+    for (; mod != NULL; mod = mod->parent) {
+        if (mod->import_set != NULL && hashset_hasptr(mod->import_set, import)) return 1;
+    }
+    return 0;
+}
+
+#define ADD_IMPORT(import) if (!hashset_hasptr(mod->import_set, import) && !module_imports(mod->parent, import)) { hashset_addptr(mod->import_set, import); arraylist_addptr(new_imported_modules, import); }
+
+// a submodule imports everything its parent does, plus the parent itself. only the additions are stored here.
 void resolve_module_deps(struct prog_state* state, struct prog_module* mod) {
-    // if this is slow, make imported_modules a hashset
-    struct arraylist* new_imported_modules = NULL;
+    struct arraylist* new_imported_modules = arraylist_new(mod->imported_modules->entry_count + 1, sizeof(struct prog_module*));
+    mod->import_set = new_hashset(mod->imported_modules->entry_count + 1);
     if (mod->parent != NULL) {
-        new_imported_modules = arraylist_new(mod->imported_modules->entry_count + mod->parent->imported_modules->entry_count + 1, sizeof(struct prog_module*));
-        for (size_t i = 0; i < mod->parent->imported_modules->entry_count; i++) {
-            arraylist_addptr(new_imported_modules, arraylist_getptr(mod->parent->imported_modules, i));
-        }
-        if (arraylist_indexptr(new_imported_modules, mod->parent) == -1) arraylist_addptr(new_imported_modules, mod->parent);
-    } else {
-        new_imported_modules = arraylist_new(mod->imported_modules->entry_count, sizeof(struct prog_module*));
+        ADD_IMPORT(mod->parent);
     }
     for (size_t i = 0; i < mod->imported_modules->entry_count; i++) {
         struct ast_node* node = arraylist_getptr(mod->imported_modules, i);
@@ -570,6 +629,9 @@ void resolve_module_deps(struct prog_state* state, struct prog_module* mod) {
                         resolved_module = hashmap_get(state->modules, ident->data.identifier.identifier);
                         if (resolved_module == NULL) {
                             resolved_module = hashmap_get(mod->submodules, ident->data.identifier.identifier);
+                            if (resolved_module == NULL) {
+                                resolved_module = prog_iface_load(state, ident->data.identifier.identifier, ident);
+                            }
                             if (resolved_module == NULL) {
                                 PROG_ERROR_AST((&(prim->data.import)), node, "module not found");
                                 goto cont_imports;
@@ -613,7 +675,7 @@ void resolve_module_deps(struct prog_state* state, struct prog_module* mod) {
                 PROG_ERROR_AST((&(prim->data.import)), node, "expecting end of statement");
                 goto cont_imports;
             }
-            if (arraylist_indexptr(new_imported_modules, resolved_module) == -1) arraylist_addptr(new_imported_modules, resolved_module);
+            ADD_IMPORT(resolved_module);
         }
         cont_imports:;
     }
@@ -624,19 +686,27 @@ void resolve_module_deps(struct prog_state* state, struct prog_module* mod) {
     ITER_MAP_END()}
 }
 
-void scope_module_types(struct prog_state* state, struct prog_module* mod) {
-    // if this is slow, make imported_modules a hashset
-    for (ssize_t i = mod->imported_modules->entry_count - 1; i >= 0; i--) {
-        struct prog_module* import = arraylist_getptr(mod->imported_modules, i);
-        ITER_MAP(import->types) {
-            if (!hashmap_get(mod->types, str_key)) {
-                hashmap_put(mod->types, str_key, value);
-            }
-        ITER_MAP_END()};
+// marks a cached miss in prog_module.type_cache
+char type_cache_miss;
+
+// own types first, then imports with later imports shadowing earlier ones, then the parent's imports
+struct prog_type* lookup_module_type(struct prog_module* mod, char* name) {
+    struct prog_type* type = hashmap_get(mod->types, name);
+    if (type != NULL) return type;
+    if (mod->type_cache == NULL) mod->type_cache = new_hashmap(16);
+    type = hashmap_get(mod->type_cache, name);
+    if (type != NULL) {
+        return type == (void*) &type_cache_miss ? NULL : type;
     }
-    ITER_MAP(mod->submodules) {
-        scope_module_types(state, value);
-    ITER_MAP_END()}
+    for (struct prog_module* cur = mod; cur != NULL && type == NULL; cur = cur->parent) {
+        for (ssize_t i = cur->imported_modules->entry_count - 1; i >= 0; i--) {
+            struct prog_module* import = arraylist_getptr(cur->imported_modules, i);
+            type = hashmap_get(import->types, name);
+            if (type != NULL) break;
+        }
+    }
+    hashmap_put(mod->type_cache, name, type == NULL ? (void*) &type_cache_miss : type);
+    return type;
 }
 
 void provide_master_types(struct prog_state* state, struct prog_module* mod, struct prog_file* file, struct prog_class* clas, struct prog_func* func, struct prog_type* type, uint8_t no_immed_generics) {
@@ -646,7 +716,7 @@ void provide_master_types(struct prog_state* state, struct prog_module* mod, str
     }
     struct prog_type* master = clas == NULL || no_immed_generics || clas->type->generics == NULL ? NULL : hashmap_get(clas->type->generics, type->name);
     if (master == NULL) {
-        master = hashmap_get(mod->types, type->name);
+        master = lookup_module_type(mod, type->name);
     } else {
         type->is_generic = 1;
     }
@@ -659,116 +729,155 @@ void provide_master_types(struct prog_state* state, struct prog_module* mod, str
         return;
     }
     type->type = PROG_TYPE_CLASS;
+    struct arraylist* args = type->ast->type == AST_NODE_TYPE ? type->ast->data.type.generics : NULL;
+    struct arraylist* params = master->ast->type == AST_NODE_TYPE ? master->ast->data.type.generics : NULL;
+    size_t arg_count = args == NULL ? 0 : args->entry_count;
+    size_t param_count = params == NULL ? 0 : params->entry_count;
     if ((type->generics == NULL) != (master->generics == NULL)) {
         char msg[256];
-        snprintf(msg, 256, "%s %lu found, expected %lu", type->generics == NULL ? "expected generics:" : "illegal generics:", type->generics->entry_count, master->generics->entry_count);
+        snprintf(msg, 256, "%s %lu found, expected %lu", type->generics == NULL ? "expected generics:" : "illegal generics:", arg_count, param_count);
         PROG_ERROR_AST((&file_cont), type->ast, msg);
         return;
     }
-    if (type->generics != NULL && type->generics->entry_count != master->generics->entry_count) {
+    if (arg_count != param_count) {
         char msg[256];
-        snprintf(msg, 256, "found %lu generics, expected %lu", type->generics->entry_count, master->generics->entry_count);
+        snprintf(msg, 256, "found %lu generics, expected %lu", arg_count, param_count);
         PROG_ERROR_AST((&file_cont), type->ast, msg);
         return;
     }
     type->master_type = master;
-    if (type->generics != NULL)
+    type->data.clas.clas = master->data.clas.clas;
+    if (type->generics != NULL) {
+        // generics were keyed by argument name, rekey them by the master's parameter names so apply_generics can substitute
+        struct hashmap* bound = new_hashmap(param_count + 1);
+        for (size_t i = 0; i < param_count; i++) {
+            struct ast_node* param = arraylist_getptr(params, i);
+            struct ast_node* arg = arraylist_getptr(args, i);
+            hashmap_put(bound, param->data.type.name, hashmap_get(type->generics, arg->data.type.name));
+        }
+        free_hashmap(type->generics);
+        type->generics = bound;
         ITER_MAP(type->generics) {
-            provide_master_types(state, mod, func->file, clas, func, value, 0);
+            provide_master_types(state, mod, file, clas, func, value, 0);
         ITER_MAP_END()}
+    }
 }
 
 
-void propagate_mod_types(struct prog_state* state, struct prog_module* mod) {
-    ITER_MAP(mod->classes) {
-        struct prog_class* clas = value;
-        if (clas->parents != NULL)
-            for (size_t j = 0; j < clas->parents->entry_count; j++) {
-                // we don't want generics in our parents, but it's alright in their generics
-                provide_master_types(state, mod, clas->file, clas, NULL, arraylist_getptr(clas->parents, j), 1);
-            }
-        ITER_MAP(clas->vars) {
-            struct prog_var* var = value;
-            provide_master_types(state, mod, clas->file, clas, NULL, var->type, 0);
-        ITER_MAP_END()}
-        ITER_MAP(clas->node_map) {
-            struct ast_node* t_node = ptr_key;
-            struct prog_node* p_node = value;
-            if (p_node->prog_type == PROG_NODE_TYPE) {
-                provide_master_types(state, mod, clas->file, clas, NULL, p_node->data.type, 0);
-            }
-        ITER_MAP_END()}
-        ITER_MAP(clas->funcs) {
-            struct prog_func* func = value;
-            provide_master_types(state, mod, clas->file, clas, func, func->return_type, 0);
-            for(size_t i = 0; i < func->arguments_list->entry_count; i++) {
-                provide_master_types(state, mod, func->file, NULL, func, arraylist_getptr(func->arguments_list, i), 0);
-            }
-            ITER_MAP(func->node_map) {
-                struct ast_node* t_node = ptr_key;
-                struct prog_node* p_node = value;
-                if (p_node->prog_type == PROG_NODE_TYPE) {
-                    provide_master_types(state, mod, func->file, NULL, func, p_node->data.type, 0);
-                }
-            ITER_MAP_END()}
-        ITER_MAP_END()}
-    ITER_MAP_END()}
-    ITER_MAP(mod->node_map) {
-        struct ast_node* t_node = ptr_key;
+void _provide_func_signature(struct prog_state* state, struct prog_module* mod, struct prog_class* clas, struct prog_func* func) {
+    provide_master_types(state, mod, func->file, clas, func, func->return_type, 0);
+    for (size_t i = 0; i < func->arguments_list->entry_count; i++) {
+        struct prog_var* arg = arraylist_getptr(func->arguments_list, i);
+        provide_master_types(state, mod, func->file, clas, func, arg->type, 0);
+    }
+}
+
+void _provide_node_map_types(struct prog_state* state, struct prog_module* mod, struct prog_file* file, struct prog_class* clas, struct prog_func* func, struct hashmap* node_map) {
+    ITER_MAP(node_map) {
         struct prog_node* p_node = value;
         if (p_node->prog_type == PROG_NODE_TYPE) {
-            provide_master_types(state, mod, p_node->data.type->file, NULL, NULL, p_node->data.type, 0);
+            provide_master_types(state, mod, file == NULL ? p_node->data.type->file : file, clas, func, p_node->data.type, 0);
         }
     ITER_MAP_END()}
+}
+
+// query: member, parent and method signature types of a class. parents are queried first, so inheritance cycles are caught here.
+void query_class_members(struct prog_state* state, struct prog_class* clas) {
+    if (clas->members_query == PROG_QUERY_DONE) return;
+    if (clas->members_query == PROG_QUERY_ACTIVE) {
+        struct {
+            struct prog_file* file;
+        } file_cont;
+        file_cont.file = clas->file;
+        PROG_ERROR_AST((&file_cont), clas->type->ast, "cyclic inheritance");
+        return;
+    }
+    clas->members_query = PROG_QUERY_ACTIVE;
+    struct prog_module* mod = clas->module;
+    if (clas->parents != NULL)
+        for (size_t j = 0; j < clas->parents->entry_count; j++) {
+            struct prog_type* parent = arraylist_getptr(clas->parents, j);
+            // we don't want generics in our parents, but it's alright in their generics
+            provide_master_types(state, mod, clas->file, clas, NULL, parent, 1);
+            if (parent->data.clas.clas != NULL) query_class_members(state, parent->data.clas.clas);
+        }
+    ITER_MAP(clas->vars) {
+        struct prog_var* var = value;
+        provide_master_types(state, mod, clas->file, clas, NULL, var->type, 0);
+    ITER_MAP_END()}
+    _provide_node_map_types(state, mod, clas->file, NULL, NULL, clas->node_map);
+    ITER_MAP(clas->funcs) {
+        struct prog_func* func = value;
+        if (func->live) _provide_func_signature(state, mod, clas, func);
+    ITER_MAP_END()}
+    clas->members_query = PROG_QUERY_DONE;
+}
+
+// query: types used inside a function body and its closures, only needed once the body is analyzed
+void query_func_types(struct prog_state* state, struct prog_module* mod, struct prog_func* func) {
+    if (func->types_query != PROG_QUERY_NONE) return;
+    func->types_query = PROG_QUERY_ACTIVE;
+    _provide_node_map_types(state, mod, func->file, NULL, func, func->node_map);
+    for (size_t i = 0; i < func->closures->entry_count; i++) {
+        struct prog_func* closure = arraylist_getptr(func->closures, i);
+        _provide_func_signature(state, mod, NULL, closure);
+        query_func_types(state, mod, closure);
+    }
+    func->types_query = PROG_QUERY_DONE;
+}
+
+// query: declaration level types of a module. import cycles are legal, a module already being queried is skipped.
+// declarations prune_unreachable left dead are never queried.
+void query_module_types(struct prog_state* state, struct prog_module* mod) {
+    if (mod->types_query != PROG_QUERY_NONE) return;
+    mod->types_query = PROG_QUERY_ACTIVE;
+    if (!mod->live) {
+        mod->types_query = PROG_QUERY_DONE;
+        return;
+    }
+    ITER_MAP(mod->classes) {
+        struct prog_class* clas = value;
+        if (clas->live) query_class_members(state, clas);
+    ITER_MAP_END()}
+    _provide_node_map_types(state, mod, NULL, NULL, NULL, mod->node_map);
     ITER_MAP(mod->vars) {
         struct prog_var* var = value;
-        provide_master_types(state, mod, var->file, NULL, NULL, var->type, 0);
+        if (var->live) provide_master_types(state, mod, var->file, NULL, NULL, var->type, 0);
     ITER_MAP_END()}
     ITER_MAP(mod->funcs) {
         struct prog_func* func = value;
-        provide_master_types(state, mod, func->file, NULL, func, func->return_type, 0);
-        for(size_t i = 0; i < func->arguments_list->entry_count; i++) {
-            provide_master_types(state, mod, func->file, NULL, func, arraylist_getptr(func->arguments_list, i), 0);
-        }
-        ITER_MAP(func->node_map) {
-            struct ast_node* t_node = ptr_key;
-            struct prog_node* p_node = value;
-            if (p_node->prog_type == PROG_NODE_TYPE) {
-                provide_master_types(state, mod, func->file, NULL, func, p_node->data.type, 0);
-            }
-        ITER_MAP_END()}
-    ITER_MAP_END()}
-    ITER_MAP(mod->submodules) {
-        propagate_mod_types(state, value);
+        if (func->live) _provide_func_signature(state, mod, NULL, func);
     ITER_MAP_END()}
+    mod->types_query = PROG_QUERY_DONE;
 }
 
-struct prog_scope {
-    struct prog_scope* parent;
-    struct arraylist* children;
-    struct hashmap* vars;
-    uint8_t copied_ref;
-    struct ast_node* ast_node;
-    uint8_t ascending_makes_closure;
-    uint8_t exit_expr_scope;
-    uint8_t is_param_level;
-    uint8_t is_class_level;
-};
+// query: every type code in mod can name, that is its own and everything it imports, transitively
+void query_visible_types(struct prog_state* state, struct prog_module* mod) {
+    if (mod->imports_query != PROG_QUERY_NONE) return;
+    mod->imports_query = PROG_QUERY_ACTIVE;
+    query_module_types(state, mod);
+    for (struct prog_module* cur = mod; cur != NULL; cur = cur->parent) {
+        for (size_t i = 0; i < cur->imported_modules->entry_count; i++) {
+            query_visible_types(state, arraylist_getptr(cur->imported_modules, i));
+        }
+    }
+    mod->imports_query = PROG_QUERY_DONE;
+}
 
-#define ALLOC_REF_SCOPE(name, node, ref) struct prog_scope* name = scalloc(sizeof(struct prog_scope)); name->copied_ref = 1; name->vars = ref; name->parent = stack; name->children = arraylist_new(4, sizeof(struct prog_scope*)); name->ast_node = node; arraylist_addptr(scope->children, name);
-#define ALLOC_SCOPE_PARENT(name, stack, node) struct prog_scope* name = scalloc(sizeof(struct prog_scope)); name->copied_ref = 0; name->vars = new_hashmap(8); name->parent = stack; name->children = arraylist_new(4, sizeof(struct prog_scope*)); name->ast_node = node; arraylist_addptr(scope->children, name);
-#define ALLOC_SCOPE(name, node) ALLOC_SCOPE_PARENT(name, stack, node)
+#define PROG_TASK_FUNC 0
+#define PROG_TASK_CLASS 1
+#define PROG_TASK_MOD_VARS 2
 
+// records that the running task needs the given body analyzed, see gen_prog
+void demand_task(struct prog_state* state, uint8_t type, struct prog_module* mod, struct prog_class* clas, struct prog_func* func);
 
-#define TRAVERSE_NEW_FUNC(item) root->type == AST_NODE_FUNC ? root : nearest_func
-#define TRAVERSE(item) scope_analysis_expr(state, item, file, TRAVERSE_NEW_FUNC(item), mod, clas, stack);
-#define TRAVERSE_SCOPED(item, name) if (item != NULL) { ALLOC_SCOPE(scope, item); name = scope_analysis_expr(state, item, file, TRAVERSE_NEW_FUNC(item), mod, clas, scope); }
-#define TRAVERSE_PRESCOPED_SPEC(item, scope) if (item != NULL) { scope_analysis_expr(state, item, file, TRAVERSE_NEW_FUNC(item), mod, clas, scope); }
-#define TRAVERSE_PRESCOPED(item) TRAVERSE_PRESCOPED_SPEC(item, scope)
-#define TRAVERSE_ARRAYLIST(list, name) if (list != NULL) { for (size_t i = 0; i < list->entry_count; i++) { struct ast_node* item = arraylist_getptr(list, i); name = scope_analysis_expr(state, item, file, TRAVERSE_NEW_FUNC(item), mod, clas, stack); } }
-#define TRAVERSE_ARRAYLIST_SCOPED(list, name) if (list != NULL) { for (size_t i = 0; i < list->entry_count; i++) { struct ast_node* item = arraylist_getptr(list, i); if (item != NULL) { ALLOC_SCOPE(scope, item); name = scope_analysis_expr(state, item, file, TRAVERSE_NEW_FUNC(item), mod, clas, scope); } } }
-#define TRAVERSE_ARRAYLIST_SCOPED_RETALL(list, name) if (list != NULL) { for (size_t i = 0; i < list->entry_count; i++) { struct ast_node* item = arraylist_getptr(list, i); if (item != NULL) { ALLOC_SCOPE(scope, item); arraylist_addptr(name, scope_analysis_expr(state, item, file, TRAVERSE_NEW_FUNC(item), mod, clas, scope)); } } }
-#define TRAVERSE_ARRAYLIST_PRESCOPED(list, name) if (list != NULL) { for (size_t i = 0; i < list->entry_count; i++) { struct ast_node* item = arraylist_getptr(list, i); if (item != NULL) { name = scope_analysis_expr(state, item, file, TRAVERSE_NEW_FUNC(item), mod, clas, scope); } } }
+struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node* root, struct prog_file* file, struct ast_node* nearest_func, struct prog_module* mod, struct prog_class* clas, struct prog_resolver* res);
+
+#define TRAVERSE(item) scope_analysis_expr(state, item, file, nearest_func, mod, clas, res);
+#define TRAVERSE_SCOPED(item, name) if (item != NULL) { prog_scope_enter(res, item); name = scope_analysis_expr(state, item, file, nearest_func, mod, clas, res); prog_scope_leave(res); }
+#define TRAVERSE_ARRAYLIST(list, name) if (list != NULL) { for (size_t i = 0; i < list->entry_count; i++) { struct ast_node* item = arraylist_getptr(list, i); name = scope_analysis_expr(state, item, file, nearest_func, mod, clas, res); } }
+#define TRAVERSE_ARRAYLIST_SCOPED(list, name) if (list != NULL) { for (size_t i = 0; i < list->entry_count; i++) { struct ast_node* item = arraylist_getptr(list, i); if (item != NULL) { prog_scope_enter(res, item); name = scope_analysis_expr(state, item, file, nearest_func, mod, clas, res); prog_scope_leave(res); } } }
+#define TRAVERSE_ARRAYLIST_SCOPED_RETALL(list, name) if (list != NULL) { for (size_t i = 0; i < list->entry_count; i++) { struct ast_node* item = arraylist_getptr(list, i); if (item != NULL) { prog_scope_enter(res, item); arraylist_addptr(name, scope_analysis_expr(state, item, file, nearest_func, mod, clas, res)); prog_scope_leave(res); } } }
 
 // does not support generic classes... very well... so don't make generic primitives?
 struct prog_type* box_primitive(struct prog_state* state, struct prog_type* type, struct ast_node* for_node) {
@@ -1017,7 +1126,7 @@ struct prog_type* type_inf_binary_expr(struct prog_state* state, struct ast_node
                 PROG_ERROR_AST(t1, root, "invalid type for expression");
                 return NULL;
             }
-            if (!hashmap_get(t1->data.clas.clas->funcs, operator_fns[bin_op]) {
+            if (!hashmap_get(t1->data.clas.clas->funcs, operator_fns[bin_op])) {
                 PROG_ERROR_AST(t1, root, "operator not defined for class");
                 return NULL;
             }
@@ -1055,38 +1164,109 @@ struct prog_type* apply_generics(struct hashmap* generics, struct prog_type* typ
     return mapped_type;
 }
 
-struct prog_type* apply_generic_stack(struct prog_scope* stack, struct prog_type* type) {
-    if (!type->is_generic && type->generics == NULL) return type;
-    while (stack != NULL) {
-        if (stack->ast_node->type == AST_NODE_CLASS) {
-            type = apply_generics(stack->ast_node->data.class.name->prog->data.type->generics, type);
-            return type;
-        } else if (stack->ast_node->type == AST_NODE_FUNC) {
-            /*
-            type = apply_generics(stack->ast_node->data.func.->data.type->generics, type);
-            return type;
-             //TODO: func generics
-             */
-        }
-        stack = stack->parent;
+void _write_type_key(FILE* out, struct prog_type* type);
+
+void _write_module_key(FILE* out, struct prog_module* mod) {
+    if (mod->parent != NULL) {
+        _write_module_key(out, mod->parent);
+        fputc('.', out);
     }
-    return type;
+    fputs(mod->name, out);
 }
 
-// also does type inference
-struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node* root, struct prog_file* file, struct ast_node* nearest_func, struct prog_module* mod, struct prog_class* clas, struct prog_scope* stack) {
-    if (root == NULL) return NULL;
-    struct prog_scope* cstack = stack;
-    if (root->scope_override) {
-        stack = scalloc(sizeof(struct prog_scope));
-        stack->copied_ref = 0;
-        stack->vars = new_hashmap(8);
-        stack->parent = cstack;
-        stack->children = arraylist_new(4, sizeof(struct prog_scope*));
-        stack->ast_node = root;
-        stack->exit_expr_scope = 1;
-        arraylist_addptr(cstack->children, stack);
+// masters are named by module path and class name rather than address, so keys mean the same in every run
+void _write_inst_key(FILE* out, struct prog_type* master, struct hashmap* generics) {
+    struct prog_class* clas = master->data.clas.clas;
+    fputc('c', out);
+    if (clas != NULL) {
+        _write_module_key(out, clas->module);
+        fprintf(out, ":%s", clas->name);
+    } else {
+        fputs(master->name == NULL ? "" : master->name, out);
+    }
+    struct arraylist* params = master->ast->type == AST_NODE_TYPE ? master->ast->data.type.generics : NULL;
+    if (params == NULL || generics == NULL) return;
+    fputc('<', out);
+    for (size_t i = 0; i < params->entry_count; i++) {
+        struct ast_node* param = arraylist_getptr(params, i);
+        _write_type_key(out, hashmap_get(generics, param->data.type.name));
+        fputc(',', out);
+    }
+    fputc('>', out);
+}
+
+// structural identity of a resolved type, classes are identified by their master type
+void _write_type_key(FILE* out, struct prog_type* type) {
+    if (type == NULL) {
+        fputc('?', out);
+        return;
+    }
+    fprintf(out, "%u.%u.%u.", type->type, type->array_dimensonality, type->is_ref);
+    if (type->type == PROG_TYPE_PRIMITIVE) {
+        fprintf(out, "p%u", type->data.prim.prim_type);
+    } else if (type->type == PROG_TYPE_FUNC) {
+        fputc('f', out);
+        _write_type_key(out, type->data.func.return_type);
+        fputc('(', out);
+        if (type->data.func.arg_types != NULL)
+            for (size_t i = 0; i < type->data.func.arg_types->entry_count; i++) {
+                _write_type_key(out, arraylist_getptr(type->data.func.arg_types, i));
+                fputc(',', out);
+            }
+        fputc(')', out);
+    } else if (type->type == PROG_TYPE_CLASS && (type->master_type != NULL || type->is_master)) {
+        _write_inst_key(out, type->is_master ? type : type->master_type, type->generics);
+    } else {
+        fprintf(out, "u%s", type->name == NULL ? "" : type->name);
+    }
+}
+
+// the instantiation of master with bindings, made once per key. member_type is substituted once per member, which is
+// any pointer identifying what the type belongs to.
+struct prog_type* _generic_inst_type(struct prog_state* state, struct prog_type* master, struct hashmap* bindings, void* member, struct prog_type* member_type) {
+    struct prog_state* shared = state->shared;
+    char* key = NULL;
+    size_t key_len = 0;
+    FILE* out = open_memstream(&key, &key_len);
+    _write_inst_key(out, master, bindings);
+    fclose(out);
+    pthread_mutex_lock(&shared->generics_lock);
+    struct prog_generic_inst* inst = hashmap_get(shared->generic_insts, key);
+    if (inst == NULL) {
+        shared->stats.generic_inst_misses++;
+        inst = scalloc(sizeof(struct prog_generic_inst));
+        inst->master = master;
+        inst->bindings = bindings;
+        inst->member_types = new_hashmap(8);
+        hashmap_put(shared->generic_insts, key, inst);
+    } else {
+        shared->stats.generic_inst_hits++;
+        free(key);
+    }
+    struct prog_type* type = hashmap_getptr(inst->member_types, member);
+    if (type == NULL) {
+        shared->stats.generic_member_misses++;
+        type = apply_generics(inst->bindings, member_type);
+        hashmap_putptr(inst->member_types, member, type);
+    } else {
+        shared->stats.generic_member_hits++;
     }
+    pthread_mutex_unlock(&shared->generics_lock);
+    return type;
+}
+
+// the type of member (a prog_var or prog_func of owner's class) as seen through owner's generic arguments
+struct prog_type* generic_member_type(struct prog_state* state, struct prog_type* owner, void* member, struct prog_type* member_type) {
+    if (member_type == NULL || owner->generics == NULL || owner->master_type == NULL) return member_type;
+    return _generic_inst_type(state, owner->master_type, owner->generics, member, member_type);
+}
+
+void scope_analysis_func(struct prog_state* state, struct prog_module* mod, struct prog_class* clas, struct prog_func* func, struct prog_resolver* res);
+
+struct prog_type* _scope_analysis_expr(struct prog_state* state, struct ast_node* root, struct prog_file* file, struct ast_node* nearest_func, struct prog_module* mod, struct prog_class* clas, struct prog_resolver* res) {
+    // the TRAVERSE macros store a type, this takes the ones nothing reads
+    struct prog_type* ignored = NULL;
+    (void) ignored;
     struct {
         struct prog_file* file;
     } file_cont;
@@ -1105,18 +1285,23 @@ struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node*
             if (base_expr == NULL) {
                 return NULL;
             }
-            if (base_expr->type == PROG_TYPE_UNKNOWN) {
+            if (base_expr->type == PROG_TYPE_UNKNOWN || base_expr->data.clas.clas == NULL) {
                 PROG_ERROR_AST((&file_cont), root->data.binary.left, "type inference failed: type is unknown");
                 return NULL;
             }
             // now 100% a class
-            struct prog_class* clas = base_expr->data.clas.clas;
-            struct prog_var* sub_var = hashmap_get(clas->vars, root->data.binary.right->data.identifier.identifier);
+            struct prog_class* member_clas = base_expr->data.clas.clas;
+            struct prog_var* sub_var = hashmap_get(member_clas->vars, root->data.binary.right->data.identifier.identifier);
             if (sub_var == NULL) {
                 PROG_ERROR_AST((&file_cont), root->data.binary.right, "not a member of parent class");
                 return NULL;
             }
-            return sub_var->type;
+            if (sub_var->pre_alloc_func != NULL) {
+                demand_task(state, PROG_TASK_FUNC, member_clas->module, member_clas, sub_var->pre_alloc_func);
+            } else {
+                demand_task(state, PROG_TASK_CLASS, member_clas->module, member_clas, NULL);
+            }
+            return generic_member_type(state, base_expr, sub_var, sub_var->type);
         } else {
             btype1 = TRAVERSE(root->data.binary.left);
             btype2 = TRAVERSE(root->data.binary.right);
@@ -1151,7 +1336,7 @@ struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node*
             struct prog_type* retType = duplicate_type(ownerType);
             retType->array_dimensonality--;
             return retType;
-        } else if (ownerType->type == PROG_TYPE_CLASS) {
+        } else if (ownerType->type == PROG_TYPE_CLASS && ownerType->data.clas.clas != NULL) {
             struct prog_func* func = hashmap_get(ownerType->data.clas.clas->funcs, "op_member");
             if (func == NULL) {
                 PROG_ERROR_AST((&file_cont), root->data.calc_member.parent, "class does not define op_member function");
@@ -1166,7 +1351,8 @@ struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node*
                 PROG_ERROR_AST((&file_cont), root->data.calc_member.calc, "type does not match or inherit from argument type of op_member function");
                 return NULL;
             }
-            return func->return_type;
+            demand_task(state, PROG_TASK_FUNC, ownerType->data.clas.clas->module, ownerType->data.clas.clas, func);
+            return generic_member_type(state, ownerType, func, func->return_type);
         } else {
             PROG_ERROR_AST((&file_cont), root->data.calc_member.parent, "illegal calculated member access on type");
             return NULL;
@@ -1178,11 +1364,12 @@ struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node*
             PROG_ERROR_AST((&file_cont), root->data.call.func, "call on non-function is illegal");
             return NULL;
         }
-        struct arraylist* paramTypes = arraylist_new(root->data.call.parameters->entry_count, sizeof(struct prog_type*));
+        struct arraylist* paramTypes = arraylist_new(root->data.call.parameters == NULL ? 1 : root->data.call.parameters->entry_count + 1, sizeof(struct prog_type*));
         TRAVERSE_ARRAYLIST_SCOPED_RETALL(root->data.call.parameters, paramTypes);
+        size_t arg_count = funcType->data.func.arg_types == NULL ? 0 : funcType->data.func.arg_types->entry_count;
         size_t mi = 0;
         for (size_t i = 0; i < paramTypes->entry_count; i++) {
-            if (mi >= funcType->data.func.arg_types->entry_count) {
+            if (mi >= arg_count) {
                 PROG_ERROR_AST((&file_cont), root, "call is missing expected parameters"); // TODO: print expected params?
                 return NULL;
             }
@@ -1206,7 +1393,7 @@ struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node*
                 continue;
             }
         }
-        while (mi < funcType->data.func.arg_types->entry_count) {
+        while (mi < arg_count) {
             struct prog_type* real_type = arraylist_getptr(funcType->data.func.arg_types, mi);
             if (real_type->is_optional || real_type->variadic) {
                 mi++;
@@ -1217,11 +1404,11 @@ struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node*
         }
         //TODO: we probably want to save these
         arraylist_free(paramTypes);
-        break;
+        return funcType->data.func.return_type;
         case AST_NODE_CASE:;
-        struct ast_node* parent = stack->parent->ast_node;
+        struct ast_node* parent = prog_scope_node(res);
         struct prog_type* caseType = TRAVERSE(root->data._case.value);
-        if (caseType == NULL || !type_subtype(caseType, parent->data._switch.switch_on->output_type)) {
+        if (caseType == NULL || parent->data._switch.switch_on->output_type == NULL || !type_subtype(caseType, parent->data._switch.switch_on->output_type)) {
             PROG_ERROR_AST((&file_cont), root, "invalid case expression value");
             return NULL;
         }
@@ -1236,103 +1423,95 @@ struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node*
         return castTarget;
         case AST_NODE_DEFAULT_CASE:
         return TRAVERSE(root->data.default_case.expr);
-        case AST_NODE_FOR: {
-            ALLOC_SCOPE(scope, root);
-            TRAVERSE_PRESCOPED(root->data._for.init);
-            TRAVERSE_PRESCOPED(root->data._for.loop);
-            TRAVERSE_PRESCOPED(root->data._for.final);
-            TRAVERSE_PRESCOPED(root->data._for.expr);
-        }
+        case AST_NODE_FOR:
+        prog_scope_enter(res, root);
+        TRAVERSE(root->data._for.init);
+        TRAVERSE(root->data._for.loop);
+        TRAVERSE(root->data._for.final);
+        TRAVERSE(root->data._for.expr);
+        prog_scope_leave(res);
         break;
-        case AST_NODE_FOR_EACH: {
-            ALLOC_SCOPE(scope, root);
-            TRAVERSE_PRESCOPED(root->data.for_each.init);
-            TRAVERSE_PRESCOPED(root->data.for_each.loop);
-            TRAVERSE_PRESCOPED(root->data.for_each.expr);
-        }
+        case AST_NODE_FOR_EACH:
+        prog_scope_enter(res, root);
+        TRAVERSE(root->data.for_each.init);
+        TRAVERSE(root->data.for_each.loop);
+        TRAVERSE(root->data.for_each.expr);
+        prog_scope_leave(res);
         break;
         case AST_NODE_FUNC: {
-                ALLOC_SCOPE(scope, root);
                 struct prog_func *func = root->prog->data.func;
+                struct prog_type* func_type = gen_prog_type(state, root, file, 0, 1, 0);
                 if (func->name != NULL) {
-                    if (hashmap_get(stack->vars, func->name)) {
+                    if (prog_scope_declared(res, func->name)) {
                         //TODO: type recognition?
                         PROG_ERROR_AST((&file_cont), root, "illegal redeclaration of function");
                     } else {
                         struct prog_var *var = scalloc(sizeof(struct prog_var));
-                        var->uid = state->next_var_id++;
+                        var->uid = __atomic_fetch_add(&state->shared->next_var_id, 1, __ATOMIC_RELAXED);
                         var->name = func->name;
                         var->func = nearest_func == NULL ? NULL : nearest_func->prog->data.func;
                         var->module = mod;
                         var->clas = clas;
-                        var->file = clas->file;
+                        var->file = file;
                         var->prot = PROTECTION_PRIV;
                         var->synch = func->synch;
                         var->csig = func->csig;
                         var->cons = 1;
                         var->stat = func->stat;
-                        var->type = gen_prog_type(state, func, clas->file, 0, 1, 0);
-                        hashmap_put(stack->vars, func->name, var);
+                        var->type = func_type;
+                        prog_scope_declare(res, var, PROG_NODE_LOCAL_REF);
                     }
                 }
-                TRAVERSE(root->data.func.return_type);
-                scope->is_param_level = 1;
-                scope->ascending_makes_closure = 1;
-                TRAVERSE_ARRAYLIST_PRESCOPED(root->data.func.arguments);
-                ALLOC_SCOPE_PARENT(scopeBody, scope, root);
-                TRAVERSE_PRESCOPED_SPEC(root->data.func.body, scopeBody);
+                scope_analysis_func(state, mod, clas, func, res);
+                return func_type;
             }
-        break;
-        case AST_NODE_IF: {
-            ALLOC_SCOPE(scope, root);
-            TRAVERSE_PRESCOPED(root->data._if.condition);
-            ALLOC_SCOPE_PARENT(scopeExpr, scope, root);
-            TRAVERSE_PRESCOPED_SPEC(root->data._if.expr, scopeExpr);
-            if (root->data._if.elseExpr != NULL) {
-                ALLOC_SCOPE_PARENT(scopeElseExpr, scope, root);
-                TRAVERSE(root->data._if.elseExpr);
-            }
-        }
+        case AST_NODE_IF:
+        prog_scope_enter(res, root);
+        TRAVERSE(root->data._if.condition);
+        TRAVERSE_SCOPED(root->data._if.expr, ignored);
+        TRAVERSE_SCOPED(root->data._if.elseExpr, ignored);
+        prog_scope_leave(res);
         break;
         case AST_NODE_RET:
-        TRAVERSE_SCOPED(root->data.ret.expr);
+        TRAVERSE_SCOPED(root->data.ret.expr, ignored);
         break;
-        case AST_NODE_SWITCH: {
-                ALLOC_SCOPE(scope, root);
-                TRAVERSE_PRESCOPED(root->data._switch.switch_on);
-                TRAVERSE_ARRAYLIST_PRESCOPED(root->data._switch.cases);
-            }
+        case AST_NODE_SWITCH:
+        prog_scope_enter(res, root);
+        TRAVERSE(root->data._switch.switch_on);
+        TRAVERSE_ARRAYLIST(root->data._switch.cases, ignored);
+        prog_scope_leave(res);
         break;
-        case AST_NODE_TERNARY: {
-            ALLOC_SCOPE(scope, root);
-            TRAVERSE_PRESCOPED(root->data.ternary.condition);
-            ALLOC_SCOPE_PARENT(scopeTrue, scope, root);
-            TRAVERSE_PRESCOPED_SPEC(root->data.ternary.if_true, scopeTrue);
-            ALLOC_SCOPE_PARENT(scopeFalse, scope, root);
-            TRAVERSE_PRESCOPED_SPEC(root->data.ternary.if_false, scopeFalse);
-        }
+        case AST_NODE_TERNARY:
+        prog_scope_enter(res, root);
+        TRAVERSE(root->data.ternary.condition);
+        TRAVERSE_SCOPED(root->data.ternary.if_true, ignored);
+        TRAVERSE_SCOPED(root->data.ternary.if_false, ignored);
+        prog_scope_leave(res);
         break;
         case AST_NODE_THROW:
-        TRAVERSE_SCOPED(root->data.throw.what);
+        TRAVERSE_SCOPED(root->data.throw.what, ignored);
         break;
-        case AST_NODE_TRY: {
-            TRAVERSE_SCOPED(root->data.try.expr);
-            ALLOC_SCOPE(scope, root);
-            TRAVERSE_PRESCOPED(root->data.try.catch_var_decl);
-            TRAVERSE_PRESCOPED(root->data.try.catch_expr);
-            TRAVERSE_SCOPED(root->data.try.finally_expr);
-        }
+        case AST_NODE_TRY:
+        TRAVERSE_SCOPED(root->data.try.expr, ignored);
+        prog_scope_enter(res, root);
+        TRAVERSE(root->data.try.catch_var_decl);
+        TRAVERSE(root->data.try.catch_expr);
+        TRAVERSE_SCOPED(root->data.try.finally_expr, ignored);
+        prog_scope_leave(res);
         break;
         case AST_NODE_UNARY:
-        TRAVERSE(root->data.unary.child);
-        break;
+        return TRAVERSE(root->data.unary.child);
         case AST_NODE_UNARY_POSTFIX:
-        TRAVERSE(root->data.unary_postfix.child);
-        break;
+        return TRAVERSE(root->data.unary_postfix.child);
+        case AST_NODE_TYPE:
+        return root->prog == NULL ? NULL : root->prog->data.type;
         case AST_NODE_VAR_DECL:
-        TRAVERSE_SCOPED(root->data.vardecl.init);
-        TRAVERSE_ARRAYLIST_SCOPED(root->data.vardecl.cons_init);
-        if (str_eqCase(root->data.vardecl.name, "this") || hashmap_get(stack->vars, root->data.vardecl.name)) {
+        TRAVERSE_SCOPED(root->data.vardecl.init, ignored);
+        TRAVERSE_ARRAYLIST_SCOPED(root->data.vardecl.cons_init, ignored);
+        if (root->data.vardecl.type->prog == NULL) {
+            return NULL;
+        }
+        if (str_eqCase(root->data.vardecl.name, "this") || prog_scope_declared(res, root->data.vardecl.name)) {
             PROG_ERROR_AST((&file_cont), root, "illegal redeclaration of variable");
         } else {
             struct prog_var* var = scalloc(sizeof(struct prog_var));
@@ -1345,18 +1524,18 @@ struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node*
             var->proc.cons_init = root->data.vardecl.cons_init;
             var->prot = PROTECTION_PRIV;
             var->type = root->data.vardecl.type->prog->data.type;
-            var->uid = state->next_var_id++;
-            hashmap_put(stack->vars, root->data.vardecl.name, var);
-        }
-        break;
-        case AST_NODE_WHILE: {
-            ALLOC_SCOPE(scope, root);
-            TRAVERSE_PRESCOPED(root->data._while.loop);
-            TRAVERSE_PRESCOPED(root->data._while.expr);
+            var->uid = __atomic_fetch_add(&state->shared->next_var_id, 1, __ATOMIC_RELAXED);
+            prog_scope_declare(res, var, PROG_NODE_LOCAL_REF);
         }
+        return root->data.vardecl.type->prog->data.type;
+        case AST_NODE_WHILE:
+        prog_scope_enter(res, root);
+        TRAVERSE(root->data._while.loop);
+        TRAVERSE(root->data._while.expr);
+        prog_scope_leave(res);
         break;
         case AST_NODE_IMP_NEW:
-        TRAVERSE_ARRAYLIST(root->data.imp_new.parameters);
+        TRAVERSE_ARRAYLIST(root->data.imp_new.parameters, ignored);
         break;
         case AST_NODE_IDENTIFIER:
         if (str_eqCase(root->data.identifier.identifier, "this")) {
@@ -1367,130 +1546,318 @@ struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node*
             node->data._this = NULL; // TODO? now or later?
             break;
         }
-        struct prog_var* ref_var = NULL;
-        struct prog_scope* cur_stack = stack;
-        uint8_t escaped_func = 0;
-        uint8_t cur_class = 0;
-        uint8_t cur_param = 0;
-        uint8_t in_modules = 0;
-        while (cur_stack != NULL) {
-            ref_var = hashmap_get(cur_stack->vars, root->data.identifier.identifier);
-            if (ref_var == NULL) {
-                if (cur_stack->ascending_makes_closure) {
-                    escaped_func = 1;
-                } else if (cur_stack->is_class_level) {
-                    in_modules = 1;
-                }
-            } else {
-                if (cur_stack->is_class_level) {
-                    cur_class = 1;
-                } else if (cur_stack->is_param_level) {
-                    cur_param = 1;
-                }
-                break;
-            }
-            cur_stack = cur_stack->parent;
-        }
-        if (ref_var == NULL) {
+        struct prog_binding binding;
+        if (!prog_scope_resolve(res, root->data.identifier.identifier, &binding)) {
             PROG_ERROR_AST((&file_cont), root, "unexpected identifier");
-        } else {
-            struct prog_node* node = scalloc(sizeof(struct prog_node));
-            node->ast_node = root;
-            root->prog = node;
-            if (cur_class) {
-                node->prog_type = PROG_NODE_CLASS_REF;
-            } else if (cur_param) {
-                node->prog_type = PROG_NODE_PARAM_REF;
-            } else if (in_modules) {
-                node->prog_type = PROG_NODE_GLOBAL_REF;
-            } else if (escaped_func) {
-                node->prog_type = PROG_NODE_CAPTURED_REF;
-            } else {
-                node->prog_type = PROG_NODE_LOCAL_REF;
-            }
+            return NULL;
+        }
+        struct prog_node* node = scalloc(sizeof(struct prog_node));
+        node->ast_node = root;
+        root->prog = node;
+        node->prog_type = binding.kind;
+        node->depth = binding.depth;
+        node->slot = binding.var->slot;
+        node->data.local = binding.var; // every var ref kind shares this union member
+        if (binding.var->pre_alloc_func != NULL) {
+            struct prog_func* ref_func = binding.var->pre_alloc_func;
+            demand_task(state, PROG_TASK_FUNC, ref_func->clas == NULL ? ref_func->module : ref_func->clas->module, ref_func->clas, ref_func);
+        } else if (binding.kind == PROG_NODE_GLOBAL_REF) {
+            demand_task(state, PROG_TASK_MOD_VARS, binding.var->module, NULL, NULL);
+        } else if (binding.kind == PROG_NODE_CLASS_REF) {
+            demand_task(state, PROG_TASK_CLASS, binding.var->clas->module, binding.var->clas, NULL);
+        }
+        return binding.var->type;
+    }
+    return NULL;
+}
+
+// also does type inference
+struct prog_type* scope_analysis_expr(struct prog_state* state, struct ast_node* root, struct prog_file* file, struct ast_node* nearest_func, struct prog_module* mod, struct prog_class* clas, struct prog_resolver* res) {
+    if (root == NULL) return NULL;
+    if (root->scope_override) {
+        prog_scope_enter(res, root)->exit_expr_scope = 1;
+    }
+    struct prog_type* type = _scope_analysis_expr(state, root, file, nearest_func, mod, clas, res);
+    if (root->scope_override) {
+        prog_scope_leave(res);
+    }
+    root->output_type = type;
+    return type;
+}
+
+void scope_analysis_var_init(struct prog_state* state, struct prog_module* mod, struct prog_class* clas, struct ast_node* nearest_func, struct prog_var* var, struct prog_resolver* res) {
+    if (var->proc.init != NULL) {
+        prog_scope_enter(res, var->proc.init);
+        scope_analysis_expr(state, var->proc.init, var->file, nearest_func, mod, clas, res);
+        prog_scope_leave(res);
+    } else if (var->proc.cons_init != NULL) {
+        for (size_t i = 0; i < var->proc.cons_init->entry_count; i++) {
+            struct ast_node* cons = arraylist_getptr(var->proc.cons_init, i);
+            prog_scope_enter(res, cons);
+            scope_analysis_expr(state, cons, var->file, nearest_func, mod, clas, res);
+            prog_scope_leave(res);
         }
     }
 }
 
-void scope_analysis_func(struct prog_state* state, struct prog_module* mod, struct prog_class* clas, struct prog_func* func, struct prog_scope* stack) {
+void scope_analysis_func(struct prog_state* state, struct prog_module* mod, struct prog_class* clas, struct prog_func* func, struct prog_resolver* res) {
+    prog_frame_enter(res, func);
     for (size_t j = 0; j < func->arguments_list->entry_count; j++) {
         struct prog_var* var = arraylist_getptr(func->arguments_list, j);
-        hashmap_put(stack->vars, var->name, var);
-        if (var->proc.init != NULL) {
-            ALLOC_SCOPE(scope, var->proc.init);
-            scope_analysis_expr(state, var->proc.init, func->file, func->proc.root, mod, clas, scope);
-        } else if (var->proc.cons_init) {
-            for (size_t i = 0; i < var->proc.cons_init; i++) {
-                struct ast_node* cons = arraylist_getptr(var->proc.cons_init, i);
-                ALLOC_SCOPE(scope, cons);
-                scope_analysis_expr(state, var->proc.init, func->file, func->proc.root, mod, clas, scope);
-            }
-        }
+        prog_scope_declare(res, var, PROG_NODE_PARAM_REF);
+        scope_analysis_var_init(state, mod, clas, func->proc.root, var, res);
     }
-    scope_analysis_expr(state, func->proc.body, func->file, func->proc.root, mod, clas, stack);
+    scope_analysis_expr(state, func->proc.body, func->file, func->proc.root, mod, clas, res);
+    prog_frame_leave(res);
 }
 
-void scope_analysis_class(struct prog_state* state, struct prog_module* mod, struct prog_class* clas, struct prog_scope* stack) {
-    ITER_MAP(clas->funcs) {
-        ALLOC_SCOPE(scope, NULL);
-        scope_analysis_func(state, mod, clas, value, scope);
-    ITER_MAP_END()}
+void scope_analysis_class(struct prog_state* state, struct prog_module* mod, struct prog_class* clas, struct prog_resolver* res) {
     ITER_MAP(clas->vars) {
-        struct prog_var* var = value;
-        if (var->proc.init != NULL) {
-            ALLOC_SCOPE(scope, var->proc.init);
-            scope_analysis_expr(state, var->proc.init, clas->file, NULL, mod, clas, scope);
-        } else if (var->proc.cons_init) {
-            for (size_t i = 0; i < var->proc.cons_init->entry_count; i++) {
-                struct ast_node* cons = arraylist_getptr(var->proc.cons_init, i);
-                ALLOC_SCOPE(scope, cons);
-                scope_analysis_expr(state, var->proc.init, clas->file, NULL, mod, clas, scope);
-            }
-        }
+        scope_analysis_var_init(state, mod, clas, NULL, value, res);
     ITER_MAP_END()}
 }
 
-struct prog_scope* scope_analysis_mod(struct prog_state* state, struct prog_module* mod, struct prog_scope* stack) {
-    if (stack == NULL) {
-        stack = scalloc(sizeof(struct prog_scope));
-        stack->vars = mod->vars;
-        stack->copied_ref = 1;
+// a unit of scope analysis that only reads module and class level declarations, see scope_analysis_mod
+struct prog_task {
+    uint8_t type;
+    struct prog_module* mod;
+    struct prog_class* clas;
+    struct prog_func* func;
+    struct prog_scope* scope; // module or class scope the task resolves against
+    struct prog_resolver* res;
+    struct arraylist* errors;
+    char* err_buf;
+    size_t err_len;
+    struct arraylist* demands; // prog_task* for bodies this one referenced, NULL when everything is checked anyway
+};
+
+struct prog_task_set {
+    struct prog_state* state;
+    struct arraylist* tasks;
+};
+
+void demand_task(struct prog_state* state, uint8_t type, struct prog_module* mod, struct prog_class* clas, struct prog_func* func) {
+    if (state->demands == NULL) return;
+    // query states are only written between rounds, so reading them here does not race
+    if (type == PROG_TASK_FUNC && func->body_query != PROG_QUERY_NONE) return;
+    if (type == PROG_TASK_CLASS && clas->body_query != PROG_QUERY_NONE) return;
+    if (type == PROG_TASK_MOD_VARS && mod->vars_query != PROG_QUERY_NONE) return;
+    struct prog_task* task = scalloc(sizeof(struct prog_task));
+    task->type = type;
+    task->mod = mod;
+    task->clas = clas;
+    task->func = func;
+    arraylist_addptr(state->demands, task);
+}
+
+// takes ownership of task. returns 0 and frees it if its body was already queued, is dead, only declared by an interface
+// or was checked by the last incremental build.
+int schedule_task(struct prog_state* state, struct prog_task* task, struct arraylist* tasks) {
+    if (task->mod->clean || task->mod->iface || !task->mod->live || (task->clas != NULL && !task->clas->live) || (task->func != NULL && !task->func->live)) {
+        free(task);
+        return 0;
+    }
+    uint8_t* query = NULL;
+    if (task->type == PROG_TASK_FUNC) {
+        query = &task->func->body_query;
+    } else if (task->type == PROG_TASK_CLASS) {
+        query = &task->clas->body_query;
+    } else {
+        query = &task->mod->vars_query;
+    }
+    if (*query != PROG_QUERY_NONE) {
+        free(task);
+        return 0;
+    }
+    *query = PROG_QUERY_ACTIVE;
+    query_visible_types(state, task->mod);
+    if (task->type == PROG_TASK_FUNC) {
+        query_func_types(state, task->mod, task->func);
+        state->stats.funcs_checked++;
     }
+    task->scope = task->clas == NULL ? task->mod->scope : task->clas->scope;
+    arraylist_addptr(tasks, task);
+    return 1;
+}
+
+#define SCHEDULE(task_type, task_mod, task_clas, task_func) { struct prog_task* task = scalloc(sizeof(struct prog_task)); task->type = task_type; task->mod = task_mod; task->clas = task_clas; task->func = task_func; schedule_task(state, task, tasks); }
+
+// queues every body in mod and its submodules, in serial analysis order
+void schedule_module(struct prog_state* state, struct prog_module* mod, struct arraylist* tasks) {
     ITER_MAP(mod->classes) {
-        ALLOC_REF_SCOPE(scope, NULL, ((struct prog_class*)value)->vars);
-        scope->is_class_level = 1;
-        scope_analysis_class(state, mod, ((struct prog_class*)value), scope);
+        struct prog_class* clas = value;
+        ITER_MAP(clas->funcs) {
+            SCHEDULE(PROG_TASK_FUNC, mod, clas, value);
+        ITER_MAP_END()}
+        SCHEDULE(PROG_TASK_CLASS, mod, clas, NULL);
     ITER_MAP_END()}
     ITER_MAP(mod->funcs) {
-        ALLOC_SCOPE(scope, NULL);
-        scope_analysis_func(state, mod, NULL, value, scope);
+        SCHEDULE(PROG_TASK_FUNC, mod, NULL, value);
     ITER_MAP_END()}
+    SCHEDULE(PROG_TASK_MOD_VARS, mod, NULL, NULL);
+    ITER_MAP(mod->submodules) {
+        schedule_module(state, value, tasks);
+    ITER_MAP_END()}
+}
+
+// declares module and class level vars, bodies are analyzed later as tasks
+struct prog_scope* scope_analysis_mod(struct prog_state* state, struct prog_module* mod, struct prog_resolver* res) {
+    prog_scope_enter(res, NULL);
+    mod->scope = prog_scope_current(res);
     ITER_MAP(mod->vars) {
-        struct prog_var* var = value;
-        if (var->proc.init != NULL) {
-            ALLOC_SCOPE(scope, var->proc.init);
-            scope_analysis_expr(state, var->proc.init, var->file, NULL, mod, NULL, scope);
-        } else if (var->proc.cons_init) {
-            for (size_t i = 0; i < var->proc.cons_init; i++) {
-                struct ast_node* cons = arraylist_getptr(var->proc.cons_init, i);
-                ALLOC_SCOPE(scope, cons);
-                scope_analysis_expr(state, var->proc.init, var->file, NULL, mod, NULL, scope);
-            }
-        }
+        prog_scope_declare(res, value, PROG_NODE_GLOBAL_REF);
+    ITER_MAP_END()}
+    ITER_MAP(mod->classes) {
+        struct prog_class* clas = value;
+        prog_scope_enter(res, NULL)->is_class_level = 1;
+        clas->scope = prog_scope_current(res);
+        ITER_MAP(clas->vars) {
+            prog_scope_declare(res, value, PROG_NODE_CLASS_REF);
+        ITER_MAP_END()}
+        prog_scope_leave(res);
+    ITER_MAP_END()}
+    ITER_MAP(mod->submodules) {
+        scope_analysis_mod(state, value, res);
+    ITER_MAP_END()}
+    prog_scope_leave(res);
+    return mod->scope;
+}
+
+// parses the bodies lazy parsing left that analysis is going to check, reachability already parsed those it scanned
+void _parse_live_bodies(struct prog_state* state, struct prog_func* func) {
+    if (!func->live) return;
+    prog_func_body(state, func);
+    for (size_t i = 0; i < func->closures->entry_count; i++) {
+        _parse_live_bodies(state, arraylist_getptr(func->closures, i));
+    }
+}
+
+void _parse_live_module_bodies(struct prog_state* state, struct prog_module* mod) {
+    if (mod->iface) return;
+    ITER_MAP(mod->classes) {
+        ITER_MAP(((struct prog_class*) value)->funcs) {
+            _parse_live_bodies(state, value);
+        ITER_MAP_END()}
+    ITER_MAP_END()}
+    ITER_MAP(mod->funcs) {
+        _parse_live_bodies(state, value);
+    ITER_MAP_END()}
+    ITER_MAP(mod->submodules) {
+        _parse_live_module_bodies(state, value);
+    ITER_MAP_END()}
+}
+
+uint64_t prog_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct prog_module* _root_module(struct prog_module* mod) {
+    while (mod->parent != NULL) mod = mod->parent;
+    return mod;
+}
+
+void _mark_imported_roots(struct prog_module* root, struct prog_module* mod, struct hashset* imported) {
+    for (size_t i = 0; i < mod->imported_modules->entry_count; i++) {
+        struct prog_module* import_root = _root_module(arraylist_getptr(mod->imported_modules, i));
+        if (import_root != root) hashset_addptr(imported, import_root);
+    }
+    ITER_MAP(mod->submodules) {
+        _mark_imported_roots(root, value, imported);
+    ITER_MAP_END()}
+}
+
+// entry points are the top level modules nothing else imports from, everything else is a library
+// and only has what is reachable from an entry point analyzed
+void mark_entry_modules(struct prog_state* state) {
+    struct hashset* imported = new_hashset(16);
+    ITER_MAP(state->modules) {
+        _mark_imported_roots(value, value, imported);
+    ITER_MAP_END()}
+    ITER_MAP(state->modules) {
+        struct prog_module* mod = value;
+        mod->entry = !hashset_hasptr(imported, mod);
+    ITER_MAP_END()}
+    free_hashset(imported);
+}
+
+void _count_funcs(struct prog_module* mod, uint64_t* count) {
+    if (mod->iface) return;
+    *count += mod->funcs->entry_count;
+    ITER_MAP(mod->classes) {
+        *count += ((struct prog_class*) value)->funcs->entry_count;
     ITER_MAP_END()}
     ITER_MAP(mod->submodules) {
-        ALLOC_REF_SCOPE(scope, NULL, ((struct prog_module*)value)->vars);
-        scope_analysis_mod(state, value, scope);
+        _count_funcs(value, count);
     ITER_MAP_END()}
-    return stack;
 }
 
-struct prog_state* gen_prog(struct arraylist* files) {
+void _run_prog_task(size_t index, void* ctx) {
+    TRACE_BEGIN(trace_start);
+    struct prog_task_set* set = ctx;
+    struct prog_task* task = arraylist_getptr(set->tasks, index);
+    // not a copy of the whole state, other tasks are bumping its counters while this one starts. those and the
+    // generics lock are only reached through shared.
+    struct prog_state* shared = set->state;
+    struct prog_state task_state;
+    memset(&task_state, 0, sizeof(struct prog_state));
+    task_state.imports = shared->imports;
+    task_state.modules = shared->modules;
+    task_state.extracted_funcs = shared->extracted_funcs;
+    task_state.node_map = shared->node_map;
+    task_state.shared = shared;
+    task_state.check_all = shared->check_all;
+    task_state.iface_path = shared->iface_path;
+    task_state.iface_files = shared->iface_files;
+    // errors are buffered per task and replayed in task order by gen_prog
+    task->errors = arraylist_new(4, sizeof(struct ast_node*));
+    task_state.errors = task->errors;
+    task_state.err_out = open_memstream(&task->err_buf, &task->err_len);
+    if (!shared->check_all) task->demands = arraylist_new(8, sizeof(struct prog_task*));
+    task_state.demands = task->demands;
+    struct prog_state* state = &task_state;
+    struct prog_resolver* res = prog_resolver_new();
+    prog_resolver_seed(res, task->scope);
+    if (task->type == PROG_TASK_FUNC) {
+        scope_analysis_func(state, task->mod, task->clas, task->func, res);
+    } else if (task->type == PROG_TASK_CLASS) {
+        scope_analysis_class(state, task->mod, task->clas, res);
+    } else {
+        ITER_MAP(task->mod->vars) {
+            struct prog_var* var = value;
+            if (var->live) scope_analysis_var_init(state, task->mod, NULL, NULL, var, res);
+        ITER_MAP_END()}
+    }
+    fclose(task_state.err_out);
+    task->res = res;
+    if (task->type == PROG_TASK_FUNC) {
+        TRACE_END(trace_start, "analysis", task->func->name, task->mod->name);
+    } else if (task->type == PROG_TASK_CLASS) {
+        TRACE_END(trace_start, "analysis", task->clas->name, task->mod->name);
+    } else {
+        TRACE_END(trace_start, "analysis", "module vars", task->mod->name);
+    }
+}
+
+struct prog_state* gen_prog(struct arraylist* files, uint32_t thread_count, uint8_t check_all, struct prog_incr* incr, char* iface_path) {
+    // a module only stays clean while every body in it has been checked, which demand driven analysis does not guarantee
+    if (incr != NULL) check_all = 1;
     struct prog_state* state = scalloc(sizeof(struct prog_state));
     state->modules = new_hashmap(16);
     state->node_map = new_hashmap(128);
     state->errors = arraylist_new(8, sizeof(struct ast_node*));
+    state->err_out = stderr;
+    state->shared = state;
+    state->check_all = check_all;
+    state->generic_insts = new_hashmap(16);
+    state->iface_path = iface_path;
+    state->iface_files = arraylist_new(4, sizeof(struct ast_node*));
+    pthread_mutex_init(&state->generics_lock, NULL);
+    struct time_mark mark;
+    time_mark_now(&mark);
     for (size_t j = 0; j < files->entry_count; j++) {
+        TRACE_BEGIN(trace_start);
         struct ast_node* file = arraylist_getptr(files, j);
         struct prog_file* pfile = scalloc(sizeof(struct prog_file));
         pfile->filename = file->data.file.filename;
@@ -1500,17 +1867,98 @@ struct prog_state* gen_prog(struct arraylist* files) {
             struct ast_node* module = arraylist_getptr(file->data.file.body->data.body.children, i);
             gen_prog_module(state, pfile, module, NULL);
         }
+        TRACE_END(trace_start, "module gen", pfile->rel_path, NULL);
     }
+    time_phase_end(TIME_PHASE_MODULE_GEN, &mark);
+    // resolving can load interfaces into state->modules, which resolve themselves
+    struct arraylist* source_modules = arraylist_new(state->modules->entry_count + 1, sizeof(struct prog_module*));
     ITER_MAP(state->modules) {
-        resolve_module_deps(state, value);
+        arraylist_addptr(source_modules, value);
     ITER_MAP_END()}
+    for (size_t i = 0; i < source_modules->entry_count; i++) {
+        resolve_module_deps(state, arraylist_getptr(source_modules, i));
+    }
+    arraylist_free(source_modules);
+    time_phase_end(TIME_PHASE_RESOLVE_DEPS, &mark);
+    mark_entry_modules(state);
+    prune_unreachable(state);
     ITER_MAP(state->modules) {
-        scope_module_types(state, value);
-        propagate_mod_types(state, value);
+        _parse_live_module_bodies(state, value);
     ITER_MAP_END()}
+    time_phase_end(TIME_PHASE_REACH, &mark);
+    if (state->parse_errors > 0) return state;
+    if (incr != NULL) {
+        prog_incr_mark_clean(incr, state, files);
+        time_phase_end(TIME_PHASE_INCR_CHECK, &mark);
+    }
+    uint64_t analysis_start = prog_time_ns();
+    struct prog_resolver* res = prog_resolver_new();
     ITER_MAP(state->modules) {
-        scope_analysis_mod(state, value, NULL);
+        TRACE_BEGIN(trace_start);
+        scope_analysis_mod(state, value, res);
+        TRACE_END(trace_start, "module scopes", ((struct prog_module*) value)->name, NULL);
     ITER_MAP_END()}
+    time_phase_end(TIME_PHASE_MODULE_SCOPES, &mark);
+    struct arraylist* tasks = arraylist_new(64, sizeof(struct prog_task*));
+    if (check_all) {
+        ITER_MAP(state->modules) {
+            query_visible_types(state, value);
+        ITER_MAP_END()}
+        time_phase_end(TIME_PHASE_VISIBLE_TYPES, &mark);
+        ITER_MAP(state->modules) {
+            schedule_module(state, value, tasks);
+        ITER_MAP_END()}
+    } else {
+        ITER_MAP(state->modules) {
+            struct prog_module* mod = value;
+            if (mod->entry) schedule_module(state, mod, tasks);
+        ITER_MAP_END()}
+    }
+    state->stats.scopes_entered += res->scopes_entered;
+    state->stats.scopes_allocated += res->scopes_materialized;
+    struct prog_task_set set;
+    set.state = state;
+    while (tasks->entry_count > 0) {
+        set.tasks = tasks;
+        task_pool_run(tasks->entry_count, thread_count, _run_prog_task, &set);
+        struct arraylist* demanded = arraylist_new(16, sizeof(struct prog_task*));
+        for (size_t i = 0; i < tasks->entry_count; i++) {
+            struct prog_task* task = arraylist_getptr(tasks, i);
+            for (size_t j = 0; j < task->errors->entry_count; j++) {
+                arraylist_addptr(state->errors, arraylist_getptr(task->errors, j));
+            }
+            fwrite(task->err_buf, 1, task->err_len, state->err_out);
+            prog_resolver_attach(task->res);
+            state->stats.scopes_entered += task->res->scopes_entered;
+            state->stats.scopes_allocated += task->res->scopes_materialized;
+            if (task->demands != NULL) {
+                for (size_t j = 0; j < task->demands->entry_count; j++) {
+                    schedule_task(state, arraylist_getptr(task->demands, j), demanded);
+                }
+                arraylist_free(task->demands);
+            }
+            prog_resolver_free(task->res);
+            arraylist_free(task->errors);
+            free(task->err_buf);
+            free(task);
+        }
+        arraylist_free(tasks);
+        tasks = demanded;
+    }
+    arraylist_free(tasks);
+    state->stats.analysis_ns = prog_time_ns() - analysis_start;
+    time_phase_end(TIME_PHASE_ANALYSIS, &mark);
+    if (incr != NULL) {
+        if (prog_incr_save(incr, state) != 0) fprintf(stderr, "Warning: could not write incremental store '%s'\n", incr->path);
+        time_phase_end(TIME_PHASE_INCR_SAVE, &mark);
+    }
+    uint64_t func_count = 0;
+    ITER_MAP(state->modules) {
+        _count_funcs(value, &func_count);
+    ITER_MAP_END()}
+    state->stats.funcs_skipped = func_count - state->stats.funcs_checked;
+    state->stats.scope_allocs_avoided = state->stats.scopes_entered - state->stats.scopes_allocated;
+    prog_resolver_free(res);
 
     /*
     plan:
@@ -1526,4 +1974,23 @@ struct prog_state* gen_prog(struct arraylist* files) {
 
     */
     return state;
-}
\ No newline at end of file
+}
+
+void print_prog_stats(struct prog_state* state, int fd) {
+    dprintf(fd, "scopes entered = %lu\n", state->stats.scopes_entered);
+    dprintf(fd, "scopes allocated = %lu\n", state->stats.scopes_allocated);
+    dprintf(fd, "scope allocations avoided = %lu\n", state->stats.scope_allocs_avoided);
+    dprintf(fd, "functions checked = %lu\n", state->stats.funcs_checked);
+    dprintf(fd, "functions skipped = %lu\n", state->stats.funcs_skipped);
+    dprintf(fd, "generic instantiation hits = %lu\n", state->stats.generic_inst_hits);
+    dprintf(fd, "generic instantiation misses = %lu\n", state->stats.generic_inst_misses);
+    dprintf(fd, "generic member type hits = %lu\n", state->stats.generic_member_hits);
+    dprintf(fd, "generic member type misses = %lu\n", state->stats.generic_member_misses);
+    dprintf(fd, "declarations pruned = %lu\n", state->stats.decls_pruned);
+    dprintf(fd, "live bytes = %lu\n", state->stats.bytes_live);
+    dprintf(fd, "pruned bytes = %lu\n", state->stats.bytes_pruned);
+    dprintf(fd, "files changed = %lu\n", state->stats.files_changed);
+    dprintf(fd, "modules reanalyzed = %lu\n", state->stats.modules_dirty);
+    dprintf(fd, "modules unchanged = %lu\n", state->stats.modules_clean);
+    dprintf(fd, "lazy bodies parsed = %lu\n", state->stats.bodies_parsed);
+}
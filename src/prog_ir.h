@@ -3,6 +3,12 @@
 
 #include "ast.h"
 #include "hash.h"
+#include <stdio.h>
+#include <pthread.h>
+
+#define PROG_QUERY_NONE 0
+#define PROG_QUERY_ACTIVE 1
+#define PROG_QUERY_DONE 2
 
 struct prog_file {
     char* filename;
@@ -19,9 +25,20 @@ struct prog_module {
     struct hashmap* classes;
     struct hashmap* funcs;
     struct hashmap* vars;
-    struct hashmap* types;
+    struct arraylist* decls; // MODULE nodes naming this module last, in the order they were read
+    struct hashmap* types; // only types declared in this module, see lookup_module_type
+    struct hashmap* type_cache; // imported type lookups, including misses
     struct hashmap* node_map;
-    struct arraylist* imported_modules;
+    struct arraylist* imported_modules; // import_ast nodes until resolve_module_deps, then the modules imported in addition to the parent's
+    struct hashset* import_set; // prog_module* in imported_modules
+    struct prog_scope* scope;
+    uint8_t types_query; // PROG_QUERY_*, see query_module_types
+    uint8_t imports_query; // query_visible_types
+    uint8_t vars_query; // var initializers analyzed
+    uint8_t entry; // top level module nothing else imports from, see mark_entry_modules
+    uint8_t live; // something in it is reachable from an entry module, see prune_unreachable
+    uint8_t clean; // unchanged along with everything it imports since the last incremental build, see prog_incr_mark_clean
+    uint8_t iface; // declared by an interface file instead of source, see prog_iface_load
 };
 
 #define PROG_NODE_AST_NODE 0
@@ -38,6 +55,8 @@ struct prog_module {
 struct prog_node {
     uint8_t prog_type;
     struct ast_node* ast_node;
+    uint32_t depth; // var refs: function frames up from the reference to the declaring frame
+    uint32_t slot; // var refs: slot of the referenced var, see prog_var
     union {
         struct prog_var* global;
         struct prog_var* param;
@@ -54,16 +73,21 @@ struct prog_class {
     struct prog_module* module;
     struct prog_type* type;
     struct prog_file* file;
+    struct ast_node* decl;
     uint8_t prot;
     uint8_t synch;
     uint8_t virt;
     uint8_t iface;
     uint8_t pure;
+    uint8_t live;
     char* name;
     struct arraylist* parents;
     struct hashmap* funcs;
     struct hashmap* vars;
     struct hashmap* node_map;
+    struct prog_scope* scope;
+    uint8_t members_query; // PROG_QUERY_*, see query_class_members
+    uint8_t body_query; // var initializers analyzed
 };
 
 struct prog_func {
@@ -86,6 +110,10 @@ struct prog_func {
     struct arraylist* arguments_list;
     struct hashmap* node_map;
     struct arraylist* closures;
+    uint32_t frame_size; // param and local slots used by this function's frame
+    uint8_t types_query; // PROG_QUERY_*, see query_func_types
+    uint8_t body_query;
+    uint8_t live;
     struct {
         struct ast_node* body;
         struct ast_node* root;
@@ -105,12 +133,15 @@ struct prog_var { // only interfunc vars
     uint8_t csig;
     uint8_t stat;
     uint8_t cons;
+    uint8_t live; // only tracked for module and class vars
+    uint32_t slot; // params/locals: index in the function frame, module/class vars: index in their layer
     struct prog_type* type;
     struct {
         struct ast_node* init;
         struct arraylist* cons_init;
     } proc;
-    struct prog_func* pre_alloc_func;
+    struct prog_func* pre_alloc_func; // the module or class func this var names
+    struct ast_node* decl; // module and class vars: the declaring VAR_DECL or FUNC node
 };
 
 #define PROG_TYPE_UNKNOWN 0
@@ -186,16 +217,73 @@ struct prog_type {
     } data;
 };
 
+// one canonical substitution of a generic class, shared by every use with the same arguments
+struct prog_generic_inst {
+    struct prog_type* master;
+    struct hashmap* bindings; // generic parameter name -> argument type
+    struct hashmap* member_types; // prog_var*/prog_func* -> its type with bindings applied
+};
+
+struct prog_stats {
+    uint64_t scopes_entered;
+    uint64_t scopes_allocated;
+    uint64_t scope_allocs_avoided; // scopes left without anything declared in them
+    uint64_t funcs_checked;
+    uint64_t funcs_skipped; // never reached from an entry point
+    uint64_t generic_inst_hits;
+    uint64_t generic_inst_misses;
+    uint64_t generic_member_hits;
+    uint64_t generic_member_misses;
+    uint64_t decls_pruned;
+    uint64_t bytes_live; // source bytes of live declarations
+    uint64_t bytes_pruned;
+    uint64_t reach_ns; // time spent in prune_unreachable
+    uint64_t analysis_ns; // time spent on type queries and scope analysis after pruning
+    uint64_t files_changed; // incremental builds only
+    uint64_t modules_dirty;
+    uint64_t modules_clean;
+    uint64_t types_generated; // prog_types built from the AST, counted on shared
+    uint64_t bodies_parsed; // stubs of --lazy-bodies parsed because something needed them
+};
+
 struct prog_state {
     struct hashmap* imports; // external modules of prog_modules
     struct hashmap* modules; // does not include submodules
     struct hashmap* extracted_funcs; // all program funcs
     struct arraylist* errors;
     struct hashmap* node_map;
-    uint64_t next_var_id;
+    uint64_t next_var_id; // only touched atomically through shared
+    struct prog_stats stats;
+    FILE* err_out; // stderr, or a per task buffer during parallel scope analysis
+    struct prog_state* shared; // the state task copies were made from, itself otherwise
+    struct hashmap* generic_insts; // instantiation key -> prog_generic_inst, see generic_member_type
+    pthread_mutex_t generics_lock; // guards generic_insts and the generic stats, only used on shared
+    uint8_t check_all; // analyze every body instead of only what entry points reach
+    struct arraylist* demands; // set on task copies, see demand_task
+    struct arraylist* pruned; // prog_pruned*, see prune_unreachable
+    char* iface_path; // directory searched for .flexi files of imported modules not declared in source
+    struct arraylist* iface_files; // file ast_nodes of the interfaces loaded
+    uint64_t parse_errors; // in bodies parsed lazily, gen_prog stops before analysis when there are any
 };
 
-struct prog_state* gen_prog(struct arraylist* files);
+struct prog_incr;
+
+// incr is NULL unless building incrementally, iface_path NULL unless imports can come from interface files
+struct prog_state* gen_prog(struct arraylist* files, uint32_t thread_count, uint8_t check_all, struct prog_incr* incr, char* iface_path);
+
+void gen_prog_module(struct prog_state* state, struct prog_file* file, struct ast_node* module, struct prog_module* parent);
+
+void resolve_module_deps(struct prog_state* state, struct prog_module* mod);
+
+// the body of func, parsed and preprocessed first if a lazy parse left it as a stub. only called before analysis
+// starts, stubs of a file share its parse_ctx.
+struct ast_node* prog_func_body(struct prog_state* state, struct prog_func* func);
+
+void print_prog_stats(struct prog_state* state, int fd);
+
+struct prog_type* lookup_module_type(struct prog_module* mod, char* name);
+
+uint64_t prog_time_ns();
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,364 @@
+#include "prog_reach.h"
+#include "smem.h"
+#include "hash.h"
+#include "arraylist.h"
+#include "xstring.h"
+#include <stdio.h>
+
+struct reach_ctx {
+    struct prog_state* state;
+    struct arraylist* funcs; // worklists, scanned in order and never shrunk
+    struct arraylist* vars;
+    struct arraylist* classes;
+    size_t funcs_done;
+    size_t vars_done;
+    size_t classes_done;
+    struct hashset* members; // names used on the right of a member access
+    struct prog_module* mod; // declaration being scanned
+    struct prog_class* clas;
+    struct ast_node* member_name; // right side of the member access being visited, not a plain identifier
+};
+
+void _reach_func(struct reach_ctx* ctx, struct prog_func* func) {
+    if (func->live) return;
+    func->live = 1;
+    arraylist_addptr(ctx->funcs, func);
+    for (size_t i = 0; i < func->closures->entry_count; i++) {
+        _reach_func(ctx, arraylist_getptr(func->closures, i));
+    }
+}
+
+void _reach_var(struct reach_ctx* ctx, struct prog_var* var) {
+    if (var->live) return;
+    var->live = 1;
+    if (var->pre_alloc_func != NULL) {
+        _reach_func(ctx, var->pre_alloc_func);
+    } else {
+        arraylist_addptr(ctx->vars, var);
+    }
+}
+
+void _reach_class(struct reach_ctx* ctx, struct prog_class* clas) {
+    if (clas->live) return;
+    clas->live = 1;
+    clas->module->live = 1;
+    arraylist_addptr(ctx->classes, clas);
+    // fields are part of the layout, methods only when named somewhere or called implicitly as operators
+    ITER_MAP(clas->vars) {
+        struct prog_var* var = value;
+        if (var->pre_alloc_func == NULL || str_startsWith(var->name, "op_") || hashset_has(ctx->members, var->name)) {
+            _reach_var(ctx, var);
+        }
+    ITER_MAP_END()}
+}
+
+struct prog_class* _reach_type_class(struct prog_module* mod, struct ast_node* type) {
+    struct prog_type* master = lookup_module_type(mod, type->data.type.name);
+    return master == NULL ? NULL : master->data.clas.clas;
+}
+
+void _reach_class_var(struct reach_ctx* ctx, struct prog_class* clas, char* name, size_t depth) {
+    // parents may form a cycle, query_class_members reports that later
+    if (clas == NULL || depth > 64) return;
+    struct prog_var* var = hashmap_get(clas->vars, name);
+    if (var != NULL) _reach_var(ctx, var);
+    if (clas->decl->data.class.parents == NULL) return;
+    for (size_t i = 0; i < clas->decl->data.class.parents->entry_count; i++) {
+        _reach_class_var(ctx, _reach_type_class(clas->module, arraylist_getptr(clas->decl->data.class.parents, i)), name, depth + 1);
+    }
+}
+
+void _reach_member(struct reach_ctx* ctx, char* name) {
+    if (hashset_has(ctx->members, name)) return;
+    hashset_add(ctx->members, name);
+    for (size_t i = 0; i < ctx->classes->entry_count; i++) {
+        struct prog_class* clas = arraylist_getptr(ctx->classes, i);
+        struct prog_var* var = hashmap_get(clas->vars, name);
+        if (var != NULL) _reach_var(ctx, var);
+    }
+}
+
+// resolves conservatively: every declaration an identifier could name is reached, locals are not tracked
+int _reach_node(struct ast_node* node, void* arg) {
+    struct reach_ctx* ctx = arg;
+    if (node->type == AST_NODE_BINARY && node->data.binary.op == BINARY_OP_MEMBER && node->data.binary.right->type == AST_NODE_IDENTIFIER) {
+        ctx->member_name = node->data.binary.right;
+        _reach_member(ctx, node->data.binary.right->data.identifier.identifier);
+    } else if (node->type == AST_NODE_IDENTIFIER && node != ctx->member_name) {
+        char* name = node->data.identifier.identifier;
+        _reach_class_var(ctx, ctx->clas, name, 0);
+        for (struct prog_module* cur = ctx->mod; cur != NULL; cur = cur->parent) {
+            struct prog_var* var = hashmap_get(cur->vars, name);
+            if (var != NULL) _reach_var(ctx, var);
+        }
+    } else if (node->type == AST_NODE_FUNC && node->prog != NULL) {
+        // children are read after this returns, so a lazily parsed body is scanned like any other
+        prog_func_body(ctx->state, node->prog->data.func);
+        // anonymous funcs in initializers are only reachable through the declaration containing them
+        _reach_func(ctx, node->prog->data.func);
+    } else if (node->type == AST_NODE_TYPE && node->data.type.name != NULL) {
+        struct prog_class* clas = _reach_type_class(ctx->mod, node);
+        if (clas != NULL) _reach_class(ctx, clas);
+    }
+    return AST_VISIT_CONTINUE;
+}
+
+void _reach_scan(struct reach_ctx* ctx, struct prog_module* mod, struct prog_class* clas, struct ast_node* node) {
+    if (node == NULL) return;
+    ctx->mod = clas == NULL ? mod : clas->module;
+    ctx->clas = clas;
+    struct ast_visitor visitor = {_reach_node, NULL, ctx};
+    visit_node(node, &visitor);
+}
+
+void _reach_module(struct reach_ctx* ctx, struct prog_module* mod) {
+    ITER_MAP(mod->classes) {
+        _reach_class(ctx, value);
+    ITER_MAP_END()}
+    ITER_MAP(mod->funcs) {
+        _reach_func(ctx, value);
+    ITER_MAP_END()}
+    ITER_MAP(mod->vars) {
+        _reach_var(ctx, value);
+    ITER_MAP_END()}
+    ITER_MAP(mod->submodules) {
+        _reach_module(ctx, value);
+    ITER_MAP_END()}
+}
+
+void _reach_all(struct prog_module* mod) {
+    mod->live = 1;
+    ITER_MAP(mod->classes) {
+        struct prog_class* clas = value;
+        clas->live = 1;
+        ITER_MAP(clas->vars) {
+            ((struct prog_var*) value)->live = 1;
+        ITER_MAP_END()}
+        ITER_MAP(clas->funcs) {
+            ((struct prog_func*) value)->live = 1;
+        ITER_MAP_END()}
+    ITER_MAP_END()}
+    ITER_MAP(mod->funcs) {
+        ((struct prog_func*) value)->live = 1;
+    ITER_MAP_END()}
+    ITER_MAP(mod->vars) {
+        ((struct prog_var*) value)->live = 1;
+    ITER_MAP_END()}
+    ITER_MAP(mod->submodules) {
+        _reach_all(value);
+    ITER_MAP_END()}
+}
+
+struct prog_func* _outermost_func(struct prog_func* func) {
+    while (func->closing != NULL) func = func->closing;
+    return func;
+}
+
+size_t _node_bytes(struct prog_file* file, struct ast_node* node) {
+    if (node == NULL || node->start_line == 0 || node->end_line > file->lines->entry_count) return 0;
+    char* start = (char*) arraylist_getptr(file->lines, node->start_line - 1) + node->start_col - 1;
+    char* end = (char*) arraylist_getptr(file->lines, node->end_line - 1) + node->end_col;
+    return end > start ? end - start : 0;
+}
+
+void _write_mod_path(FILE* out, struct prog_module* mod) {
+    if (mod->parent != NULL) {
+        _write_mod_path(out, mod->parent);
+        fputc('.', out);
+    }
+    fputs(mod->name, out);
+}
+
+void _add_pruned(struct prog_state* state, const char* kind, struct prog_module* mod, struct prog_class* clas, char* name, struct prog_file* file, struct ast_node* node, size_t bytes) {
+    struct prog_pruned* pruned = scalloc(sizeof(struct prog_pruned));
+    pruned->kind = kind;
+    size_t len = 0;
+    FILE* out = open_memstream(&pruned->name, &len);
+    _write_mod_path(out, mod);
+    if (clas != NULL) fprintf(out, ".%s", clas->name);
+    if (name != NULL) fprintf(out, ".%s", name);
+    fclose(out);
+    pruned->file = file;
+    pruned->line = node == NULL ? 0 : node->start_line;
+    pruned->bytes = bytes;
+    arraylist_addptr(state->pruned, pruned);
+}
+
+// source bytes of the declarations directly in mod, closures are counted as part of their function
+size_t _module_bytes(struct prog_module* mod, uint8_t live) {
+    size_t bytes = 0;
+    ITER_MAP(mod->classes) {
+        struct prog_class* clas = value;
+        if (clas->live == live) bytes += _node_bytes(clas->file, clas->decl);
+    ITER_MAP_END()}
+    ITER_MAP(mod->funcs) {
+        struct prog_func* func = value;
+        if (func->live == live) bytes += _node_bytes(func->file, func->proc.root);
+    ITER_MAP_END()}
+    ITER_MAP(mod->vars) {
+        struct prog_var* var = value;
+        if (var->pre_alloc_func == NULL && var->live == live) bytes += _node_bytes(var->file, var->decl);
+    ITER_MAP_END()}
+    return bytes;
+}
+
+uint8_t _subtree_live(struct prog_module* mod) {
+    if (mod->live) return 1;
+    ITER_MAP(mod->submodules) {
+        if (_subtree_live(value)) return 1;
+    ITER_MAP_END()}
+    return 0;
+}
+
+size_t _subtree_bytes(struct prog_module* mod) {
+    size_t bytes = _module_bytes(mod, 0);
+    ITER_MAP(mod->submodules) {
+        bytes += _subtree_bytes(value);
+    ITER_MAP_END()}
+    return bytes;
+}
+
+uint64_t _subtree_decls(struct prog_module* mod) {
+    uint64_t count = mod->classes->entry_count + mod->funcs->entry_count;
+    ITER_MAP(mod->vars) {
+        if (((struct prog_var*) value)->pre_alloc_func == NULL) count++;
+    ITER_MAP_END()}
+    ITER_MAP(mod->submodules) {
+        count += _subtree_decls(value);
+    ITER_MAP_END()}
+    return count;
+}
+
+// a wholly dead module is reported as one entry, otherwise each dead class and its dead members are
+void _collect_pruned(struct prog_state* state, struct prog_module* mod) {
+    // interfaces have no bodies to save analysis on
+    if (mod->iface) return;
+    if (!_subtree_live(mod)) {
+        size_t bytes = _subtree_bytes(mod);
+        state->stats.decls_pruned += _subtree_decls(mod);
+        state->stats.bytes_pruned += bytes;
+        if (bytes > 0) _add_pruned(state, "module", mod, NULL, NULL, mod->file, NULL, bytes);
+        return;
+    }
+    state->stats.bytes_live += _module_bytes(mod, 1);
+    ITER_MAP(mod->classes) {
+        struct prog_class* clas = value;
+        size_t bytes = _node_bytes(clas->file, clas->decl);
+        if (!clas->live) {
+            state->stats.decls_pruned++;
+            state->stats.bytes_pruned += bytes;
+            _add_pruned(state, "class", mod, NULL, clas->name, clas->file, clas->decl, bytes);
+            continue;
+        }
+        ITER_MAP(clas->funcs) {
+            struct prog_func* func = value;
+            if (func->live) continue;
+            size_t func_bytes = _node_bytes(func->file, func->proc.root);
+            state->stats.decls_pruned++;
+            state->stats.bytes_pruned += func_bytes;
+            // the class itself is live, so its dead methods are moved out of its live byte count
+            state->stats.bytes_live -= func_bytes;
+            _add_pruned(state, "func", mod, clas, func->name == NULL ? "<anonymous>" : func->name, func->file, func->proc.root, func_bytes);
+        ITER_MAP_END()}
+    ITER_MAP_END()}
+    ITER_MAP(mod->funcs) {
+        struct prog_func* func = value;
+        if (func->live) continue;
+        size_t bytes = _node_bytes(func->file, func->proc.root);
+        state->stats.decls_pruned++;
+        state->stats.bytes_pruned += bytes;
+        _add_pruned(state, "func", mod, NULL, func->name == NULL ? "<anonymous>" : func->name, func->file, func->proc.root, bytes);
+    ITER_MAP_END()}
+    ITER_MAP(mod->vars) {
+        struct prog_var* var = value;
+        if (var->live || var->pre_alloc_func != NULL) continue;
+        size_t bytes = _node_bytes(var->file, var->decl);
+        state->stats.decls_pruned++;
+        state->stats.bytes_pruned += bytes;
+        _add_pruned(state, "var", mod, NULL, var->name, var->file, var->decl, bytes);
+    ITER_MAP_END()}
+    ITER_MAP(mod->submodules) {
+        _collect_pruned(state, value);
+    ITER_MAP_END()}
+}
+
+void prune_unreachable(struct prog_state* state) {
+    uint64_t start = prog_time_ns();
+    state->pruned = arraylist_new(16, sizeof(struct prog_pruned*));
+    if (state->check_all) {
+        ITER_MAP(state->modules) {
+            _reach_all(value);
+        ITER_MAP_END()}
+    } else {
+        struct reach_ctx ctx;
+        ctx.state = state;
+        ctx.funcs = arraylist_new(64, sizeof(struct prog_func*));
+        ctx.vars = arraylist_new(64, sizeof(struct prog_var*));
+        ctx.classes = arraylist_new(16, sizeof(struct prog_class*));
+        ctx.funcs_done = 0;
+        ctx.vars_done = 0;
+        ctx.classes_done = 0;
+        ctx.members = new_hashset(64);
+        ctx.member_name = NULL;
+        ITER_MAP(state->modules) {
+            struct prog_module* mod = value;
+            if (mod->entry) _reach_module(&ctx, mod);
+        ITER_MAP_END()}
+        while (ctx.funcs_done < ctx.funcs->entry_count || ctx.vars_done < ctx.vars->entry_count || ctx.classes_done < ctx.classes->entry_count) {
+            while (ctx.funcs_done < ctx.funcs->entry_count) {
+                struct prog_func* func = arraylist_getptr(ctx.funcs, ctx.funcs_done++);
+                struct prog_func* outer = _outermost_func(func);
+                if (func == outer) {
+                    // closures are scanned as part of the function they are declared in
+                    _reach_scan(&ctx, outer->module, outer->clas, func->proc.root);
+                }
+                if (outer->clas == NULL) {
+                    outer->module->live = 1;
+                } else {
+                    _reach_class(&ctx, outer->clas);
+                }
+            }
+            while (ctx.vars_done < ctx.vars->entry_count) {
+                struct prog_var* var = arraylist_getptr(ctx.vars, ctx.vars_done++);
+                if (var->clas == NULL) var->module->live = 1;
+                _reach_scan(&ctx, var->module, var->clas, var->decl);
+            }
+            while (ctx.classes_done < ctx.classes->entry_count) {
+                struct prog_class* clas = arraylist_getptr(ctx.classes, ctx.classes_done++);
+                _reach_scan(&ctx, clas->module, clas, clas->decl->data.class.name);
+                if (clas->decl->data.class.parents != NULL) {
+                    for (size_t i = 0; i < clas->decl->data.class.parents->entry_count; i++) {
+                        _reach_scan(&ctx, clas->module, clas, arraylist_getptr(clas->decl->data.class.parents, i));
+                    }
+                }
+            }
+        }
+        arraylist_free(ctx.funcs);
+        arraylist_free(ctx.vars);
+        arraylist_free(ctx.classes);
+        free_hashset(ctx.members);
+    }
+    ITER_MAP(state->modules) {
+        _collect_pruned(state, value);
+    ITER_MAP_END()}
+    state->stats.reach_ns = prog_time_ns() - start;
+}
+
+void print_prune_report(struct prog_state* state, int fd) {
+    for (size_t i = 0; i < state->pruned->entry_count; i++) {
+        struct prog_pruned* pruned = arraylist_getptr(state->pruned, i);
+        if (pruned->line == 0) {
+            dprintf(fd, "pruned %s %s: %lu bytes (%s)\n", pruned->kind, pruned->name, pruned->bytes, pruned->file->rel_path);
+        } else {
+            dprintf(fd, "pruned %s %s: %lu bytes (%s:%lu)\n", pruned->kind, pruned->name, pruned->bytes, pruned->file->rel_path, pruned->line);
+        }
+    }
+    uint64_t total = state->stats.bytes_live + state->stats.bytes_pruned;
+    dprintf(fd, "%lu declarations pruned, %lu of %lu bytes (%lu%%)\n", state->stats.decls_pruned, state->stats.bytes_pruned, total, total == 0 ? 0 : state->stats.bytes_pruned * 100 / total);
+    dprintf(fd, "reachability pass took %lu us, analysis took %lu us\n", state->stats.reach_ns / 1000, state->stats.analysis_ns / 1000);
+    // assumes analysis time scales with source size, pruned code was never timed
+    if (state->stats.bytes_live > 0) {
+        double saved = (double) state->stats.analysis_ns * state->stats.bytes_pruned / state->stats.bytes_live;
+        dprintf(fd, "estimated analysis time saved: %lu us\n", (uint64_t) (saved / 1000));
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef __PROG_REACH_H__
+#define __PROG_REACH_H__
+
+#include "prog_ir.h"
+
+// a declaration, or a whole module, that nothing reachable from an entry module refers to
+struct prog_pruned {
+    const char* kind; // "module", "class", "func" or "var"
+    char* name; // dotted path from the top level module
+    struct prog_file* file;
+    size_t line;
+    size_t bytes; // source bytes of the declaration
+};
+
+// marks module and class level declarations reachable from the entry modules live, starting from
+// everything declared in them. references are followed by name only, so the live set is a superset
+// of what scope analysis will actually resolve. with check_all set everything is live.
+// runs after mark_entry_modules, dead declarations are recorded in state->pruned.
+void prune_unreachable(struct prog_state* state);
+
+void print_prune_report(struct prog_state* state, int fd);
+
+#endif
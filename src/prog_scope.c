@@ -0,0 +1,191 @@
+#include "prog_scope.h"
+#include "smem.h"
+#include "hash.h"
+#include "arraylist.h"
+
+struct prog_resolver* prog_resolver_new() {
+    struct prog_resolver* res = scallocTag(sizeof(struct prog_resolver), SMEM_TAG_SCOPE);
+    res->visible = new_hashmap(64);
+    res->entry_cap = 64;
+    res->entries = smallocTag(res->entry_cap * sizeof(struct prog_resolver_entry), SMEM_TAG_SCOPE);
+    res->scope_cap = 16;
+    res->scopes = smallocTag(res->scope_cap * sizeof(struct prog_resolver_scope), SMEM_TAG_SCOPE);
+    res->frame_cap = 8;
+    res->frames = smallocTag(res->frame_cap * sizeof(struct prog_resolver_frame), SMEM_TAG_SCOPE);
+    // frame 0 holds module level initializer locals
+    res->frames[0].func = NULL;
+    res->frames[0].next_slot = 0;
+    res->frame_count = 1;
+    res->detached = arraylist_new(4, sizeof(struct prog_scope*));
+    return res;
+}
+
+void prog_resolver_free(struct prog_resolver* res) {
+    if (res == NULL) return;
+    free_hashmap(res->visible);
+    free(res->entries);
+    free(res->scopes);
+    free(res->frames);
+    arraylist_free(res->detached);
+    free(res);
+}
+
+struct prog_resolver_scope* prog_scope_enter(struct prog_resolver* res, struct ast_node* node) {
+    if (res->scope_count == res->scope_cap) {
+        res->scope_cap *= 2;
+        res->scopes = sreallocTag(res->scopes, res->scope_cap * sizeof(struct prog_resolver_scope), SMEM_TAG_SCOPE);
+    }
+    struct prog_resolver_scope* rscope = &res->scopes[res->scope_count++];
+    rscope->mark = res->entry_count;
+    rscope->scope = NULL;
+    rscope->ast_node = node;
+    rscope->exit_expr_scope = 0;
+    rscope->is_param_level = 0;
+    rscope->is_class_level = 0;
+    rscope->borrowed = 0;
+    res->scopes_entered++;
+    return rscope;
+}
+
+void _push_entry(struct prog_resolver* res, struct prog_var* var, uint8_t kind) {
+    if (res->entry_count == res->entry_cap) {
+        res->entry_cap *= 2;
+        res->entries = sreallocTag(res->entries, res->entry_cap * sizeof(struct prog_resolver_entry), SMEM_TAG_SCOPE);
+    }
+    struct prog_resolver_entry* entry = &res->entries[res->entry_count];
+    entry->name = var->name;
+    entry->var = var;
+    entry->kind = kind;
+    entry->frame = res->frame_count - 1;
+    entry->shadowed = (size_t) hashmap_get(res->visible, var->name);
+    res->entry_count++;
+    hashmap_put(res->visible, var->name, (void*) res->entry_count);
+}
+
+void prog_resolver_seed(struct prog_resolver* res, struct prog_scope* scope) {
+    if (scope == NULL) return;
+    prog_resolver_seed(res, scope->parent);
+    if (res->scope_count == res->scope_cap) {
+        res->scope_cap *= 2;
+        res->scopes = sreallocTag(res->scopes, res->scope_cap * sizeof(struct prog_resolver_scope), SMEM_TAG_SCOPE);
+    }
+    struct prog_resolver_scope* rscope = &res->scopes[res->scope_count++];
+    rscope->mark = res->entry_count;
+    rscope->scope = scope;
+    rscope->ast_node = scope->ast_node;
+    rscope->exit_expr_scope = scope->exit_expr_scope;
+    rscope->is_param_level = scope->is_param_level;
+    rscope->is_class_level = scope->is_class_level;
+    rscope->borrowed = 1;
+    for (size_t i = 0; i < scope->vars->entry_count; i++) {
+        _push_entry(res, arraylist_getptr(scope->vars, i), scope->is_class_level ? PROG_NODE_CLASS_REF : PROG_NODE_GLOBAL_REF);
+    }
+}
+
+void prog_resolver_attach(struct prog_resolver* res) {
+    for (size_t i = 0; i < res->detached->entry_count; i++) {
+        struct prog_scope* scope = arraylist_getptr(res->detached, i);
+        arraylist_addptr(scope->parent->children, scope);
+    }
+}
+
+// parent is the nearest materialized enclosing scope, empty scopes in between are never allocated
+struct prog_scope* _materialize_scope(struct prog_resolver* res, size_t index) {
+    struct prog_resolver_scope* rscope = &res->scopes[index];
+    if (rscope->scope != NULL) return rscope->scope;
+    struct prog_resolver_scope* parent_rscope = NULL;
+    for (size_t i = index; i > 0; i--) {
+        if (res->scopes[i - 1].scope != NULL) {
+            parent_rscope = &res->scopes[i - 1];
+            break;
+        }
+    }
+    struct prog_scope* parent = parent_rscope == NULL ? NULL : parent_rscope->scope;
+    struct prog_scope* scope = scallocTag(sizeof(struct prog_scope), SMEM_TAG_SCOPE);
+    scope->parent = parent;
+    scope->ast_node = rscope->ast_node;
+    scope->exit_expr_scope = rscope->exit_expr_scope;
+    scope->is_param_level = rscope->is_param_level;
+    scope->is_class_level = rscope->is_class_level;
+    scope->children = arraylist_new(4, sizeof(struct prog_scope*));
+    scope->vars = arraylist_new(4, sizeof(struct prog_var*));
+    if (parent_rscope != NULL && parent_rscope->borrowed) {
+        arraylist_addptr(res->detached, scope);
+    } else if (parent != NULL) {
+        arraylist_addptr(parent->children, scope);
+    }
+    rscope->scope = scope;
+    res->scopes_materialized++;
+    return scope;
+}
+
+void prog_scope_leave(struct prog_resolver* res) {
+    if (res->scope_count == 0) return;
+    size_t mark = res->scopes[--res->scope_count].mark;
+    while (res->entry_count > mark) {
+        struct prog_resolver_entry* entry = &res->entries[--res->entry_count];
+        hashmap_put(res->visible, entry->name, (void*) entry->shadowed);
+    }
+}
+
+struct prog_scope* prog_scope_current(struct prog_resolver* res) {
+    return res->scope_count == 0 ? NULL : _materialize_scope(res, res->scope_count - 1);
+}
+
+struct ast_node* prog_scope_node(struct prog_resolver* res) {
+    return res->scope_count == 0 ? NULL : res->scopes[res->scope_count - 1].ast_node;
+}
+
+void prog_frame_enter(struct prog_resolver* res, struct prog_func* func) {
+    if (res->frame_count == res->frame_cap) {
+        res->frame_cap *= 2;
+        res->frames = sreallocTag(res->frames, res->frame_cap * sizeof(struct prog_resolver_frame), SMEM_TAG_SCOPE);
+    }
+    res->frames[res->frame_count].func = func;
+    res->frames[res->frame_count].next_slot = 0;
+    res->frame_count++;
+    prog_scope_enter(res, func->proc.root)->is_param_level = 1;
+}
+
+void prog_frame_leave(struct prog_resolver* res) {
+    prog_scope_leave(res);
+    if (res->frame_count <= 1) return;
+    struct prog_resolver_frame* frame = &res->frames[--res->frame_count];
+    frame->func->frame_size = frame->next_slot;
+}
+
+int prog_scope_declared(struct prog_resolver* res, char* name) {
+    size_t index = (size_t) hashmap_get(res->visible, name);
+    if (index == 0) return 0;
+    size_t mark = res->scope_count == 0 ? 0 : res->scopes[res->scope_count - 1].mark;
+    return index - 1 >= mark;
+}
+
+void prog_scope_declare(struct prog_resolver* res, struct prog_var* var, uint8_t kind) {
+    struct prog_scope* scope = prog_scope_current(res);
+    if (kind == PROG_NODE_PARAM_REF || kind == PROG_NODE_LOCAL_REF) {
+        var->slot = res->frames[res->frame_count - 1].next_slot++;
+    } else if (scope != NULL) {
+        // module and class vars are slotted by position in their layer
+        var->slot = scope->vars->entry_count;
+    }
+    if (scope != NULL) arraylist_addptr(scope->vars, var);
+    _push_entry(res, var, kind);
+}
+
+int prog_scope_resolve(struct prog_resolver* res, char* name, struct prog_binding* binding) {
+    size_t index = (size_t) hashmap_get(res->visible, name);
+    if (index == 0) return 0;
+    struct prog_resolver_entry* entry = &res->entries[index - 1];
+    binding->var = entry->var;
+    binding->kind = entry->kind;
+    binding->depth = 0;
+    if (entry->kind == PROG_NODE_PARAM_REF || entry->kind == PROG_NODE_LOCAL_REF) {
+        uint32_t frame = res->frame_count - 1;
+        if (entry->frame < frame) {
+            binding->kind = PROG_NODE_CAPTURED_REF;
+            binding->depth = frame - entry->frame;
+        }
+    }
+    return 1;
+}
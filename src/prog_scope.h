@@ -0,0 +1,94 @@
+#ifndef __PROG_SCOPE_H__
+#define __PROG_SCOPE_H__
+
+#include "prog_ir.h"
+
+struct prog_scope {
+    struct prog_scope* parent;
+    struct arraylist* children;
+    struct arraylist* vars; // prog_var* declared directly in this scope, in declaration order
+    struct ast_node* ast_node;
+    uint8_t exit_expr_scope;
+    uint8_t is_param_level;
+    uint8_t is_class_level;
+};
+
+// result of resolving an identifier, read by later passes through prog_node
+struct prog_binding {
+    struct prog_var* var;
+    uint8_t kind; // one of PROG_NODE_*_REF
+    uint32_t depth; // function frames between the reference and the declaration, only nonzero for captures
+};
+
+struct prog_resolver_entry {
+    char* name;
+    struct prog_var* var;
+    size_t shadowed; // index + 1 of the entry this one hides, 0 if none
+    uint32_t frame;
+    uint8_t kind;
+};
+
+// a lexical scope as seen by the resolver, only backed by a prog_scope once something is declared in it
+struct prog_resolver_scope {
+    size_t mark; // entry count when the scope was entered, the undo log is replayed down to it on leave
+    struct prog_scope* scope; // NULL until materialized
+    struct ast_node* ast_node;
+    uint8_t exit_expr_scope;
+    uint8_t is_param_level;
+    uint8_t is_class_level;
+    uint8_t borrowed; // seeded from another resolver's tree, children are linked by prog_resolver_attach
+};
+
+struct prog_resolver_frame {
+    struct prog_func* func;
+    uint32_t next_slot;
+};
+
+// a single flat scope stack shared by a whole scope analysis pass
+struct prog_resolver {
+    struct hashmap* visible; // name -> index + 1 of the innermost visible entry
+    struct prog_resolver_entry* entries;
+    size_t entry_count;
+    size_t entry_cap;
+    struct prog_resolver_scope* scopes;
+    size_t scope_count;
+    size_t scope_cap;
+    struct prog_resolver_frame* frames;
+    size_t frame_count;
+    size_t frame_cap;
+    struct arraylist* detached; // prog_scope* whose parent is a borrowed scope
+    size_t scopes_entered;
+    size_t scopes_materialized;
+};
+
+struct prog_resolver* prog_resolver_new();
+
+void prog_resolver_free(struct prog_resolver* res);
+
+// makes an already analyzed scope and its ancestors visible, without touching their vars.
+// used to resolve a task against module and class scopes built by another resolver.
+void prog_resolver_seed(struct prog_resolver* res, struct prog_scope* scope);
+
+// links scopes materialized under seeded scopes into their parents, not thread safe.
+void prog_resolver_attach(struct prog_resolver* res);
+
+struct prog_resolver_scope* prog_scope_enter(struct prog_resolver* res, struct ast_node* node);
+
+void prog_scope_leave(struct prog_resolver* res);
+
+// materializes the innermost scope if needed
+struct prog_scope* prog_scope_current(struct prog_resolver* res);
+
+struct ast_node* prog_scope_node(struct prog_resolver* res);
+
+void prog_frame_enter(struct prog_resolver* res, struct prog_func* func);
+
+void prog_frame_leave(struct prog_resolver* res);
+
+int prog_scope_declared(struct prog_resolver* res, char* name);
+
+void prog_scope_declare(struct prog_resolver* res, struct prog_var* var, uint8_t kind);
+
+int prog_scope_resolve(struct prog_resolver* res, char* name, struct prog_binding* binding);
+
+#endif
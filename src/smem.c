@@ -23,6 +23,221 @@ void smem_setOOMCallback(void* (*func)(size_t, void*, int)) {
 
 #ifndef SMEM_DEBUG_OVERLOAD
 
+#ifdef SMEM_TRACK
+
+#undef free
+
+#include <pthread.h>
+#include <string.h>
+
+const char* SMEM_TAG_NAMES[] = {"other", "token", "ast_node", "hashmap", "arraylist", "prog_type", "scope", "string"};
+
+struct smem_record {
+	void* ptr; // NULL for an empty slot, SMEM_TOMBSTONE for a freed one
+	size_t size;
+	uint8_t tag;
+};
+
+#define SMEM_TOMBSTONE ((void*) 1)
+
+struct smem_counts {
+	uint64_t allocs;
+	uint64_t bytes;
+	uint64_t live;
+	uint64_t peak;
+};
+
+// open addressing by pointer, everything below is guarded by smem_lock
+pthread_mutex_t smem_lock = PTHREAD_MUTEX_INITIALIZER;
+struct smem_record* smem_records = NULL;
+size_t smem_recordCap = 0;
+size_t smem_recordUsed = 0; // including tombstones
+size_t smem_recordLive = 0;
+struct smem_counts smem_tags[SMEM_TAG_COUNT];
+struct smem_counts smem_total;
+struct smem_counts smem_phases[SMEM_PHASE_MAX];
+struct smem_counts smem_sincePhase; // live is unused, peak is the highest total live since smem_phaseStart
+
+size_t smem_slot(void* ptr, size_t cap) {
+	return (((uintptr_t) ptr >> 4) * 0x9E3779B97F4A7C15ULL) & (cap - 1);
+}
+
+void smem_grow() {
+	struct smem_record* old = smem_records;
+	size_t oldCap = smem_recordCap;
+	// mostly tombstones only needs a rehash
+	smem_recordCap = oldCap == 0 ? 4096 : smem_recordLive * 4 < oldCap ? oldCap : oldCap * 2;
+	smem_records = calloc(smem_recordCap, sizeof(struct smem_record));
+	if (smem_records == NULL) smem_records = ((void* (*)(size_t size, void* cptr, int type)) __smem_oom_callback)(smem_recordCap * sizeof(struct smem_record), NULL, SMEM_CALLBACK_CALLOC);
+	smem_recordUsed = 0;
+	for (size_t i = 0; i < oldCap; i++) {
+		if (old[i].ptr == NULL || old[i].ptr == SMEM_TOMBSTONE) continue;
+		size_t slot = smem_slot(old[i].ptr, smem_recordCap);
+		while (smem_records[slot].ptr != NULL) slot = (slot + 1) & (smem_recordCap - 1);
+		smem_records[slot] = old[i];
+		smem_recordUsed++;
+	}
+	free(old);
+}
+
+struct smem_record* smem_find(void* ptr) {
+	if (smem_recordCap == 0) return NULL;
+	size_t slot = smem_slot(ptr, smem_recordCap);
+	while (smem_records[slot].ptr != NULL) {
+		if (smem_records[slot].ptr == ptr) return &smem_records[slot];
+		slot = (slot + 1) & (smem_recordCap - 1);
+	}
+	return NULL;
+}
+
+void smem_countAlloc(struct smem_counts* counts, size_t size) {
+	counts->allocs++;
+	counts->bytes += size;
+	counts->live += size;
+	if (counts->live > counts->peak) counts->peak = counts->live;
+}
+
+int smem_forget(void* ptr);
+
+// with smem_lock held
+void smem_record(void* ptr, size_t size, uint8_t tag) {
+	if (tag >= SMEM_TAG_COUNT) tag = SMEM_TAG_OTHER;
+	// a block freed behind smem's back, by libc or a file without smem.h, can come back from malloc
+	smem_forget(ptr);
+	if ((smem_recordUsed + 1) * 2 > smem_recordCap) smem_grow();
+	size_t slot = smem_slot(ptr, smem_recordCap);
+	while (smem_records[slot].ptr != NULL && smem_records[slot].ptr != SMEM_TOMBSTONE) slot = (slot + 1) & (smem_recordCap - 1);
+	if (smem_records[slot].ptr == NULL) smem_recordUsed++;
+	smem_records[slot].ptr = ptr;
+	smem_records[slot].size = size;
+	smem_records[slot].tag = tag;
+	smem_recordLive++;
+	smem_countAlloc(&smem_tags[tag], size);
+	smem_countAlloc(&smem_total, size);
+	smem_sincePhase.allocs++;
+	smem_sincePhase.bytes += size;
+	if (smem_total.live > smem_sincePhase.peak) smem_sincePhase.peak = smem_total.live;
+}
+
+// with smem_lock held, returns the tag ptr was allocated with or -1 if smem did not allocate it
+int smem_forget(void* ptr) {
+	struct smem_record* record = smem_find(ptr);
+	if (record == NULL) return -1;
+	smem_tags[record->tag].live -= record->size;
+	smem_total.live -= record->size;
+	record->ptr = SMEM_TOMBSTONE;
+	smem_recordLive--;
+	return record->tag;
+}
+
+void* smallocTag(size_t size, uint8_t tag) {
+	void* m = malloc(size);
+	if (m == NULL) m = ((void* (*)(size_t size, void* cptr, int type)) __smem_oom_callback)(size, NULL, SMEM_CALLBACK_MALLOC);
+	pthread_mutex_lock(&smem_lock);
+	smem_record(m, size, tag);
+	pthread_mutex_unlock(&smem_lock);
+	return m;
+}
+
+void* sreallocTag(void* ptr, size_t size, uint8_t tag) {
+	// like sfree, ptr is forgotten while it is still allocated. once realloc released it, another thread may get the
+	// same address and record it first.
+	if (ptr != NULL) {
+		pthread_mutex_lock(&smem_lock);
+		int oldTag = smem_forget(ptr);
+		if (oldTag >= 0) tag = oldTag;
+		pthread_mutex_unlock(&smem_lock);
+	}
+	void* m = realloc(ptr, size);
+	if (m == NULL) m = ((void* (*)(size_t size, void* cptr, int type)) __smem_oom_callback)(size, ptr, SMEM_CALLBACK_REALLOC);
+	pthread_mutex_lock(&smem_lock);
+	smem_record(m, size, tag);
+	pthread_mutex_unlock(&smem_lock);
+	return m;
+}
+
+void* scallocTag(size_t size, uint8_t tag) {
+	void* m = calloc(1, size);
+	if (m == NULL) m = ((void* (*)(size_t size, void* cptr, int type)) __smem_oom_callback)(size, NULL, SMEM_CALLBACK_CALLOC);
+	pthread_mutex_lock(&smem_lock);
+	smem_record(m, size, tag);
+	pthread_mutex_unlock(&smem_lock);
+	return m;
+}
+
+void* smalloc(size_t size) {
+	return smallocTag(size, SMEM_TAG_OTHER);
+}
+
+void* srealloc(void* ptr, size_t size) {
+	return sreallocTag(ptr, size, SMEM_TAG_OTHER);
+}
+
+void* scalloc(size_t size) {
+	return scallocTag(size, SMEM_TAG_OTHER);
+}
+
+void sfree(void* ptr) {
+	if (ptr == NULL) return;
+	pthread_mutex_lock(&smem_lock);
+	smem_forget(ptr);
+	pthread_mutex_unlock(&smem_lock);
+	free(ptr);
+}
+
+void smem_phaseStart() {
+	pthread_mutex_lock(&smem_lock);
+	memset(&smem_sincePhase, 0, sizeof(struct smem_counts));
+	smem_sincePhase.peak = smem_total.live;
+	pthread_mutex_unlock(&smem_lock);
+}
+
+void smem_phaseEnd(uint8_t phase) {
+	pthread_mutex_lock(&smem_lock);
+	if (phase < SMEM_PHASE_MAX) {
+		smem_phases[phase].allocs += smem_sincePhase.allocs;
+		smem_phases[phase].bytes += smem_sincePhase.bytes;
+		smem_phases[phase].live = smem_total.live;
+		if (smem_sincePhase.peak > smem_phases[phase].peak) smem_phases[phase].peak = smem_sincePhase.peak;
+	}
+	memset(&smem_sincePhase, 0, sizeof(struct smem_counts));
+	smem_sincePhase.peak = smem_total.live;
+	pthread_mutex_unlock(&smem_lock);
+}
+
+void smem_resetStats() {
+	pthread_mutex_lock(&smem_lock);
+	for (int i = 0; i < SMEM_TAG_COUNT; i++) {
+		smem_tags[i].allocs = 0;
+		smem_tags[i].bytes = 0;
+		smem_tags[i].peak = smem_tags[i].live;
+	}
+	smem_total.allocs = 0;
+	smem_total.bytes = 0;
+	smem_total.peak = smem_total.live;
+	memset(smem_phases, 0, sizeof(smem_phases));
+	memset(&smem_sincePhase, 0, sizeof(struct smem_counts));
+	smem_sincePhase.peak = smem_total.live;
+	pthread_mutex_unlock(&smem_lock);
+}
+
+void smem_printReport(int fd, const char** phase_names, int phase_count) {
+	pthread_mutex_lock(&smem_lock);
+	dprintf(fd, "%-20s %12s %14s %14s %14s\n", "tag", "allocs", "bytes", "live", "peak");
+	for (int i = 0; i < SMEM_TAG_COUNT; i++) {
+		dprintf(fd, "%-20s %12lu %14lu %14lu %14lu\n", SMEM_TAG_NAMES[i], smem_tags[i].allocs, smem_tags[i].bytes, smem_tags[i].live, smem_tags[i].peak);
+	}
+	dprintf(fd, "%-20s %12lu %14lu %14lu %14lu\n", "total", smem_total.allocs, smem_total.bytes, smem_total.live, smem_total.peak);
+	dprintf(fd, "%-20s %12s %14s %14s %14s\n", "phase", "allocs", "bytes", "live after", "peak");
+	for (int i = 0; i < phase_count && i < SMEM_PHASE_MAX; i++) {
+		if (smem_phases[i].allocs == 0 && smem_phases[i].peak == 0) continue;
+		dprintf(fd, "%-20s %12lu %14lu %14lu %14lu\n", phase_names[i], smem_phases[i].allocs, smem_phases[i].bytes, smem_phases[i].live, smem_phases[i].peak);
+	}
+	pthread_mutex_unlock(&smem_lock);
+}
+
+#else
+
 void* smalloc(size_t size) {
 	void* m = malloc(size);
 	if (m == NULL) m = ((void* (*)(size_t size, void* cptr, int type)) __smem_oom_callback)(size, NULL, SMEM_CALLBACK_MALLOC);
@@ -41,4 +256,6 @@ void* scalloc(size_t size) {
 	return m;
 }
 
+#endif
+
 #endif
\ No newline at end of file
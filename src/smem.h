@@ -12,7 +12,21 @@
 #define SMEM_CALLBACK_REALLOC 1
 #define SMEM_CALLBACK_CALLOC 2
 
+// what an allocation is for, only kept when built with SMEM_TRACK
+#define SMEM_TAG_OTHER 0
+#define SMEM_TAG_TOKEN 1
+#define SMEM_TAG_AST_NODE 2
+#define SMEM_TAG_HASHMAP 3 // maps, sets and their buckets
+#define SMEM_TAG_ARRAYLIST 4
+#define SMEM_TAG_PROG_TYPE 5
+#define SMEM_TAG_SCOPE 6 // prog_scopes and resolver stacks
+#define SMEM_TAG_STRING 7
+#define SMEM_TAG_COUNT 8
+
+#define SMEM_PHASE_MAX 32
+
 #include <stdlib.h>
+#include <stdint.h>
 //example: void* __smem_default_oom_callback(size_t size, void* cptr, int type)
 void smem_setOOMCallback(void* (*func)(size_t, void*, int));
 // #define SMEM_DEBUG_OVERLOAD
@@ -32,4 +46,36 @@ void* scalloc(size_t size);
 
 #endif
 
+#if defined(SMEM_TRACK) && !defined(SMEM_DEBUG_OVERLOAD)
+
+// every allocation made through smem is recorded with its size and tag until it is freed, frees of memory
+// smem did not allocate are passed through
+void* smallocTag(size_t size, uint8_t tag);
+
+void* sreallocTag(void* ptr, size_t size, uint8_t tag);
+
+void* scallocTag(size_t size, uint8_t tag);
+
+void sfree(void* ptr);
+
+#define free(ptr) sfree(ptr)
+
+// allocations between smem_phaseStart and smem_phaseEnd are counted towards phase
+void smem_phaseStart();
+
+void smem_phaseEnd(uint8_t phase);
+
+// peaks restart from what is live now, live counts are kept
+void smem_resetStats();
+
+void smem_printReport(int fd, const char** phase_names, int phase_count);
+
+#else
+
+#define smallocTag(size, tag) smalloc(size)
+#define sreallocTag(ptr, size, tag) srealloc(ptr, size)
+#define scallocTag(size, tag) scalloc(size)
+
+#endif
+
 #endif /* SMEM_H_ */
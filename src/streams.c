@@ -8,7 +8,11 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
 #include "smem.h"
+#include "streams.h"
 #include <openssl/ssl.h>
 
 ssize_t readLine(int fd, char* line, size_t len) {
@@ -128,4 +132,136 @@ ssize_t readUntilEnd(int fd, void** buf) {
 	*buf = srealloc(*buf, rd + 1);
 	((char*) *buf)[rd] = 0;
 	return rd;
-}
\ No newline at end of file
+}
+
+struct out_stream* newOutStream(int fd, size_t cap) {
+	struct out_stream* out = scalloc(sizeof(struct out_stream));
+	out->fd = fd;
+	out->cap = cap < 64 ? 64 : cap;
+	out->buf = smalloc(out->cap);
+	return out;
+}
+
+struct out_stream* newMemOutStream(size_t cap) {
+	return newOutStream(-1, cap);
+}
+
+// sends the buffer followed by data, retrying partial writes. memory streams grow instead.
+void _outWritev(struct out_stream* out, const void* data, size_t len) {
+	if (out->fd < 0) {
+		if (len == 0) return;
+		while (out->cap - out->len < len) out->cap *= 2;
+		out->buf = srealloc(out->buf, out->cap);
+		memcpy(out->buf + out->len, data, len);
+		out->len += len;
+		return;
+	}
+	struct iovec iov[2];
+	iov[0].iov_base = out->buf;
+	iov[0].iov_len = out->len;
+	iov[1].iov_base = (void*) data;
+	iov[1].iov_len = len;
+	int first = 0;
+	while (out->error == 0 && first < 2) {
+		while (first < 2 && iov[first].iov_len == 0) first++;
+		if (first == 2) break;
+		ssize_t written = writev(out->fd, iov + first, 2 - first);
+		if (written < 0) {
+			if (errno != EINTR) out->error = errno;
+			continue;
+		}
+		while (first < 2 && (size_t) written >= iov[first].iov_len) {
+			written -= iov[first].iov_len;
+			iov[first++].iov_len = 0;
+		}
+		if (first < 2) {
+			iov[first].iov_base += written;
+			iov[first].iov_len -= written;
+		}
+	}
+	out->len = 0;
+}
+
+void outWrite(struct out_stream* out, const void* data, size_t len) {
+	if (out->cap - out->len >= len) {
+		memcpy(out->buf + out->len, data, len);
+		out->len += len;
+	} else {
+		_outWritev(out, data, len);
+	}
+}
+
+void outPuts(struct out_stream* out, const char* str) {
+	outWrite(out, str, strlen(str));
+}
+
+void outPutc(struct out_stream* out, char c) {
+	if (out->len == out->cap) {
+		outWrite(out, &c, 1);
+	} else {
+		out->buf[out->len++] = c;
+	}
+}
+
+void outU64(struct out_stream* out, uint64_t value) {
+	char digits[20];
+	int i = 20;
+	do {
+		digits[--i] = '0' + (value % 10);
+		value /= 10;
+	} while (value > 0);
+	outWrite(out, digits + i, 20 - i);
+}
+
+void outJsonEscaped(struct out_stream* out, const char* str) {
+	static const char hex[] = "0123456789abcdef";
+	const char* run = str;
+	for (; *str != 0; str++) {
+		unsigned char c = *str;
+		if (c >= 0x20 && c != '"' && c != '\\') continue;
+		outWrite(out, run, str - run);
+		run = str + 1;
+		if (c == '"' || c == '\\') {
+			outPutc(out, '\\');
+			outPutc(out, c);
+		} else if (c == '\n') {
+			outWrite(out, "\\n", 2);
+		} else if (c == '\t') {
+			outWrite(out, "\\t", 2);
+		} else if (c == '\r') {
+			outWrite(out, "\\r", 2);
+		} else {
+			char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+			outWrite(out, escape, 6);
+		}
+	}
+	outWrite(out, run, str - run);
+}
+
+void outJsonString(struct out_stream* out, const char* str) {
+	if (str == NULL) {
+		outWrite(out, "null", 4);
+		return;
+	}
+	outPutc(out, '"');
+	outJsonEscaped(out, str);
+	outPutc(out, '"');
+}
+
+int outFlush(struct out_stream* out) {
+	_outWritev(out, NULL, 0);
+	if (out->error != 0) {
+		errno = out->error;
+		return -1;
+	}
+	return 0;
+}
+
+int freeOutStream(struct out_stream* out) {
+	int status = outFlush(out);
+	int error = errno;
+	free(out->buf);
+	free(out);
+	errno = error;
+	return status;
+}
@@ -8,12 +8,25 @@
 #ifndef STREAMS_H_
 #define STREAMS_H_
 
+#include <stdint.h>
+#include <unistd.h>
 
-size_t readLine(int fd, char* line, size_t len);
+// buffered output to a file descriptor. a write that does not fit is sent along with the buffer in one writev.
+struct out_stream {
+	int fd; // -1 for a stream that only collects into buf
+	char* buf;
+	size_t len;
+	size_t cap;
+	int error; // errno of the first failed write, nothing more is written after one
+};
+
+#define OUT_STREAM_DEFAULT_CAP (256 * 1024)
+
+ssize_t readLine(int fd, char* line, size_t len);
 
 ssize_t readLineDynamic(int fd, char** line);
 
-size_t writeLine(int fd, char* line, size_t len);
+ssize_t writeLine(int fd, char* line, size_t len);
 
 ssize_t writeFully(int fd, void* buf, size_t size);
 
@@ -21,4 +34,29 @@ ssize_t readFully(int fd, void* buf, size_t size);
 
 ssize_t readUntilEnd(int fd, void** buf);
 
+struct out_stream* newOutStream(int fd, size_t cap);
+
+// buf grows to hold everything written, nothing is ever flushed
+struct out_stream* newMemOutStream(size_t cap);
+
+void outWrite(struct out_stream* out, const void* data, size_t len);
+
+void outPuts(struct out_stream* out, const char* str);
+
+void outPutc(struct out_stream* out, char c);
+
+void outU64(struct out_stream* out, uint64_t value);
+
+// a json string literal, or null for NULL
+void outJsonString(struct out_stream* out, const char* str);
+
+// the escaped characters of str, without quotes
+void outJsonEscaped(struct out_stream* out, const char* str);
+
+// returns 0, or -1 with errno set if any write so far failed
+int outFlush(struct out_stream* out);
+
+// flushes and frees the stream, the fd stays open. returns like outFlush.
+int freeOutStream(struct out_stream* out);
+
 #endif /* STREAMS_H_ */
@@ -0,0 +1,110 @@
+#include "task_pool.h"
+#include "smem.h"
+#include <pthread.h>
+
+struct task_deque {
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+};
+
+struct task_pool {
+    struct task_deque* deques;
+    uint32_t deque_count;
+    void (*run)(size_t index, void* ctx);
+    void* ctx;
+};
+
+struct task_worker {
+    struct task_pool* pool;
+    uint32_t id;
+};
+
+int _task_pop(struct task_deque* deque, size_t* index) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *index = deque->head++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+int _task_steal(struct task_deque* deque, size_t* index) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *index = --deque->tail;
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+void* _task_worker(void* arg) {
+    struct task_worker* worker = arg;
+    struct task_pool* pool = worker->pool;
+    size_t index;
+    while (1) {
+        if (_task_pop(&pool->deques[worker->id], &index)) {
+            pool->run(index, pool->ctx);
+            continue;
+        }
+        int stole = 0;
+        for (uint32_t i = 1; i < pool->deque_count; i++) {
+            if (_task_steal(&pool->deques[(worker->id + i) % pool->deque_count], &index)) {
+                stole = 1;
+                break;
+            }
+        }
+        // nothing spawns new tasks, so once every deque is empty we are done
+        if (!stole) break;
+        pool->run(index, pool->ctx);
+    }
+    return NULL;
+}
+
+void task_pool_run(size_t task_count, uint32_t thread_count, void (*run)(size_t index, void* ctx), void* ctx) {
+    if (thread_count > task_count) thread_count = task_count;
+    if (thread_count <= 1) {
+        for (size_t i = 0; i < task_count; i++) {
+            run(i, ctx);
+        }
+        return;
+    }
+    struct task_pool pool;
+    pool.deque_count = thread_count;
+    pool.deques = smalloc(sizeof(struct task_deque) * thread_count);
+    pool.run = run;
+    pool.ctx = ctx;
+    size_t per_deque = task_count / thread_count;
+    size_t extra = task_count % thread_count;
+    size_t next = 0;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].head = next;
+        next += per_deque + (i < extra ? 1 : 0);
+        pool.deques[i].tail = next;
+    }
+    struct task_worker workers[thread_count];
+    pthread_t threads[thread_count];
+    for (uint32_t i = 0; i < thread_count; i++) {
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+    // the caller works as worker 0
+    uint32_t started = 1;
+    for (uint32_t i = 1; i < thread_count; i++) {
+        if (pthread_create(&threads[i], NULL, _task_worker, &workers[i])) break;
+        started++;
+    }
+    _task_worker(&workers[0]);
+    for (uint32_t i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (uint32_t i = 0; i < thread_count; i++) {
+        pthread_mutex_destroy(&pool.deques[i].lock);
+    }
+    free(pool.deques);
+}
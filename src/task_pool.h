@@ -0,0 +1,12 @@
+#ifndef __TASK_POOL_H__
+#define __TASK_POOL_H__
+
+#include <stdint.h>
+#include <unistd.h>
+
+// runs run(index, ctx) for every index in [0, task_count) on up to thread_count threads.
+// tasks are dealt out in contiguous blocks, idle workers steal from the back of other blocks.
+// returns once every task has finished. thread_count <= 1 runs everything in order on the caller.
+void task_pool_run(size_t task_count, uint32_t thread_count, void (*run)(size_t index, void* ctx), void* ctx);
+
+#endif
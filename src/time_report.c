@@ -0,0 +1,252 @@
+#include "time_report.h"
+#include "prog_ir.h"
+#include "ast_cache.h"
+#include "streams.h"
+#include "smem.h"
+#include "xstring.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+const char* TIME_PHASE_NAMES[] = {"read", "validate", "tokenize", "parse", "ast cache load", "ast cache store", "module gen", "resolve deps", "reachability", "incremental check", "module scopes", "visible types", "analysis", "incremental save", "emit interface", "write ir", "dump"};
+
+struct time_report time_report;
+
+void time_report_reset(uint8_t enabled) {
+    if (time_report.files != NULL) {
+        for (size_t i = 0; i < time_report.files->entry_count; i++) {
+            struct time_report_file* file = arraylist_getptr(time_report.files, i);
+            free(file->rel_path);
+            free(file);
+        }
+        arraylist_free(time_report.files);
+    }
+    if (time_report.perf) perf_counters_close();
+    memset(&time_report, 0, sizeof(struct time_report));
+    time_report.enabled = enabled;
+    if (enabled) time_report.files = arraylist_new(16, sizeof(struct time_report_file*));
+}
+
+void time_mark_now(struct time_mark* mark) {
+#ifdef SMEM_TRACK
+    smem_phaseStart();
+#endif
+    if (!time_report.enabled && !trace_enabled) return;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    mark->wall_ns = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    mark->cpu_ns = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    if (time_report.perf) perf_counters_read(mark->perf);
+}
+
+int time_report_perf() {
+    if (!time_report.enabled) return 1;
+    time_report.perf = perf_counters_open() > 0;
+    return !time_report.perf;
+}
+
+uint64_t time_phase_end(uint8_t phase, struct time_mark* mark) {
+#ifdef SMEM_TRACK
+    smem_phaseEnd(phase);
+#endif
+    if (!time_report.enabled && !trace_enabled) return 0;
+    TRACE_END(mark->wall_ns, "phase", TIME_PHASE_NAMES[phase], NULL);
+    struct time_mark now;
+    time_mark_now(&now);
+    if (!time_report.enabled) {
+        *mark = now;
+        return 0;
+    }
+    uint64_t wall = now.wall_ns - mark->wall_ns;
+    time_report.phases[phase].wall_ns += wall;
+    time_report.phases[phase].cpu_ns += now.cpu_ns - mark->cpu_ns;
+    time_report.phases[phase].count++;
+    for (int i = 0; i < PERF_COUNTER_COUNT && time_report.perf; i++) {
+        time_report.phases[phase].perf[i] += now.perf[i] - mark->perf[i];
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0 && (uint64_t) usage.ru_maxrss > time_report.phases[phase].peak_rss_kb) time_report.phases[phase].peak_rss_kb = usage.ru_maxrss;
+    *mark = now;
+    return wall;
+}
+
+struct time_report_file* time_report_add_file(char* rel_path) {
+    if (!time_report.enabled) return NULL;
+    struct time_report_file* file = scalloc(sizeof(struct time_report_file));
+    file->rel_path = str_dup(rel_path, 0);
+    arraylist_addptr(time_report.files, file);
+    return file;
+}
+
+void _time_ms(struct out_stream* out, uint64_t ns) {
+    char ms[32];
+    snprintf(ms, sizeof(ms), "%.3f", ns / 1000000.0);
+    outPuts(out, ms);
+}
+
+void _time_counter(struct out_stream* out, uint8_t json, uint8_t first, char* name, uint64_t value) {
+    if (json) {
+        outPuts(out, first ? "\"" : ",\"");
+        outPuts(out, name);
+        outPuts(out, "\":");
+    } else {
+        outPuts(out, name);
+        outPuts(out, " = ");
+    }
+    outU64(out, value);
+    if (!json) outPutc(out, '\n');
+}
+
+// only the counters that opened
+void _time_perf_json(struct out_stream* out, uint64_t* perf) {
+    uint8_t first = 1;
+    outPuts(out, ",\"perf\":{");
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (!perf_counter_available(i)) continue;
+        _time_counter(out, 1, first, (char*) PERF_COUNTER_NAMES[i], perf[i]);
+        first = 0;
+    }
+    outPutc(out, '}');
+}
+
+void _time_perf_table(struct out_stream* out) {
+    char line[160];
+    char cell[24];
+    snprintf(line, sizeof(line), "%-20s", "phase");
+    outPuts(out, line);
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (!perf_counter_available(i)) continue;
+        snprintf(line, sizeof(line), " %14s", PERF_COUNTER_NAMES[i]);
+        outPuts(out, line);
+    }
+    outPuts(out, perf_counter_available(PERF_COUNTER_CYCLES) && perf_counter_available(PERF_COUNTER_INSTRUCTIONS) ? "    ipc\n" : "\n");
+    for (int i = 0; i < TIME_PHASE_COUNT; i++) {
+        struct time_phase* phase = &time_report.phases[i];
+        if (phase->count == 0) continue;
+        snprintf(line, sizeof(line), "%-20s", TIME_PHASE_NAMES[i]);
+        outPuts(out, line);
+        for (int j = 0; j < PERF_COUNTER_COUNT; j++) {
+            if (!perf_counter_available(j)) continue;
+            snprintf(line, sizeof(line), " %14lu", phase->perf[j]);
+            outPuts(out, line);
+        }
+        if (perf_counter_available(PERF_COUNTER_CYCLES) && perf_counter_available(PERF_COUNTER_INSTRUCTIONS)) {
+            uint64_t cycles = phase->perf[PERF_COUNTER_CYCLES];
+            snprintf(cell, sizeof(cell), " %6.2f", cycles == 0 ? 0.0 : (double) phase->perf[PERF_COUNTER_INSTRUCTIONS] / cycles);
+            outPuts(out, cell);
+        }
+        outPutc(out, '\n');
+    }
+}
+
+void print_time_report(int fd, uint8_t json, struct prog_state* state) {
+    struct out_stream* out = newOutStream(fd, 16 * 1024);
+    uint64_t tokens = 0;
+    uint64_t nodes = 0;
+    uint64_t total_wall = 0;
+    uint64_t total_cpu = 0;
+    for (size_t i = 0; i < time_report.files->entry_count; i++) {
+        struct time_report_file* file = arraylist_getptr(time_report.files, i);
+        tokens += file->tokens;
+        nodes += file->nodes;
+    }
+    for (int i = 0; i < TIME_PHASE_COUNT; i++) {
+        total_wall += time_report.phases[i].wall_ns;
+        total_cpu += time_report.phases[i].cpu_ns;
+    }
+    if (json) {
+        outPuts(out, "{\"phases\":[");
+        for (int i = 0; i < TIME_PHASE_COUNT; i++) {
+            struct time_phase* phase = &time_report.phases[i];
+            outPuts(out, i == 0 ? "{\"name\":\"" : ",{\"name\":\"");
+            outPuts(out, TIME_PHASE_NAMES[i]);
+            outPuts(out, "\",\"wall_ns\":");
+            outU64(out, phase->wall_ns);
+            outPuts(out, ",\"cpu_ns\":");
+            outU64(out, phase->cpu_ns);
+            outPuts(out, ",\"count\":");
+            outU64(out, phase->count);
+            outPuts(out, ",\"peak_rss_kb\":");
+            outU64(out, phase->peak_rss_kb);
+            if (time_report.perf) _time_perf_json(out, phase->perf);
+            outPutc(out, '}');
+        }
+        outPuts(out, "],\"files\":[");
+        for (size_t i = 0; i < time_report.files->entry_count; i++) {
+            struct time_report_file* file = arraylist_getptr(time_report.files, i);
+            outPuts(out, i == 0 ? "{\"path\":" : ",{\"path\":");
+            outJsonString(out, file->rel_path);
+            outPuts(out, file->cached ? ",\"cached\":true" : ",\"cached\":false");
+            _time_counter(out, 1, 0, "bytes", file->bytes);
+            _time_counter(out, 1, 0, "lines", file->lines);
+            _time_counter(out, 1, 0, "tokens", file->tokens);
+            _time_counter(out, 1, 0, "nodes", file->nodes);
+            for (int j = 0; j <= TIME_PHASE_PARSE; j++) {
+                outPuts(out, ",\"");
+                outPuts(out, TIME_PHASE_NAMES[j]);
+                outPuts(out, "_ns\":");
+                outU64(out, file->phase_ns[j]);
+            }
+            outPutc(out, '}');
+        }
+        outPuts(out, "],\"counters\":{");
+    } else {
+        char line[128];
+        snprintf(line, sizeof(line), "%-20s %12s %12s %8s %12s\n", "phase", "wall ms", "cpu ms", "count", "peak rss kb");
+        outPuts(out, line);
+        for (int i = 0; i < TIME_PHASE_COUNT; i++) {
+            struct time_phase* phase = &time_report.phases[i];
+            snprintf(line, sizeof(line), "%-20s %12.3f %12.3f %8lu %12lu\n", TIME_PHASE_NAMES[i], phase->wall_ns / 1000000.0, phase->cpu_ns / 1000000.0, phase->count, phase->peak_rss_kb);
+            outPuts(out, line);
+        }
+        snprintf(line, sizeof(line), "%-20s %12.3f %12.3f\n", "total", total_wall / 1000000.0, total_cpu / 1000000.0);
+        outPuts(out, line);
+        if (time_report.perf) _time_perf_table(out);
+        for (size_t i = 0; i < time_report.files->entry_count; i++) {
+            struct time_report_file* file = arraylist_getptr(time_report.files, i);
+            outPuts(out, "file ");
+            outPuts(out, file->rel_path);
+            outPuts(out, ": ");
+            outU64(out, file->bytes);
+            outPuts(out, " bytes, ");
+            outU64(out, file->lines);
+            outPuts(out, " lines, ");
+            outU64(out, file->tokens);
+            outPuts(out, " tokens, ");
+            outU64(out, file->nodes);
+            outPuts(out, file->cached ? " nodes, cached" : " nodes");
+            for (int j = 0; j <= TIME_PHASE_PARSE; j++) {
+                outPuts(out, ", ");
+                outPuts(out, TIME_PHASE_NAMES[j]);
+                outPutc(out, ' ');
+                _time_ms(out, file->phase_ns[j]);
+                outPuts(out, " ms");
+            }
+            outPutc(out, '\n');
+        }
+    }
+    _time_counter(out, json, 1, "tokens", tokens);
+    _time_counter(out, json, 0, "nodes", nodes);
+    if (state != NULL) {
+        _time_counter(out, json, 0, "types", __atomic_load_n(&state->shared->stats.types_generated, __ATOMIC_RELAXED));
+        _time_counter(out, json, 0, "scopes_entered", state->stats.scopes_entered);
+        _time_counter(out, json, 0, "scopes_allocated", state->stats.scopes_allocated);
+        _time_counter(out, json, 0, "funcs_checked", state->stats.funcs_checked);
+        _time_counter(out, json, 0, "funcs_skipped", state->stats.funcs_skipped);
+    }
+    _time_counter(out, json, 0, "ast_cache_hits", ast_cache_stats.hits);
+    _time_counter(out, json, 0, "ast_cache_misses", ast_cache_stats.misses);
+    _time_counter(out, json, 0, "ast_cache_stores", ast_cache_stats.stores);
+    _time_counter(out, json, 0, "ast_cache_rejected", ast_cache_stats.rejected);
+    if (json) {
+        outPuts(out, "},\"total_wall_ns\":");
+        outU64(out, total_wall);
+        outPuts(out, ",\"total_cpu_ns\":");
+        outU64(out, total_cpu);
+        outPuts(out, "}\n");
+    }
+    freeOutStream(out);
+}
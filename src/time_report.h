@@ -0,0 +1,83 @@
+#ifndef __TIME_REPORT_H__
+#define __TIME_REPORT_H__
+
+#include <stdint.h>
+#include "arraylist.h"
+#include "perf_counters.h"
+
+#define TIME_PHASE_READ 0
+#define TIME_PHASE_VALIDATE 1 // checking characters and splitting lines
+#define TIME_PHASE_TOKENIZE 2
+#define TIME_PHASE_PARSE 3
+#define TIME_PHASE_AST_CACHE_LOAD 4
+#define TIME_PHASE_AST_CACHE_STORE 5
+#define TIME_PHASE_MODULE_GEN 6 // gen_prog_module over every file
+#define TIME_PHASE_RESOLVE_DEPS 7
+#define TIME_PHASE_REACH 8 // mark_entry_modules and prune_unreachable
+#define TIME_PHASE_INCR_CHECK 9
+#define TIME_PHASE_MODULE_SCOPES 10 // scope_analysis_mod
+#define TIME_PHASE_VISIBLE_TYPES 11 // query_visible_types, check_all only
+#define TIME_PHASE_ANALYSIS 12 // scheduled type queries and body analysis, on the task pool
+#define TIME_PHASE_INCR_SAVE 13
+#define TIME_PHASE_EMIT_INTERFACE 14
+#define TIME_PHASE_WRITE_IR 15
+#define TIME_PHASE_DUMP 16 // -olex and -oast
+#define TIME_PHASE_COUNT 17
+
+extern const char* TIME_PHASE_NAMES[];
+
+// cpu time is for the whole process, so it exceeds wall time where phases run on the task pool
+struct time_phase {
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+    uint64_t count;
+    uint64_t peak_rss_kb; // of the process by the end of the phase
+    uint64_t perf[PERF_COUNTER_COUNT]; // hardware counter deltas, see perf_counters.h
+};
+
+struct time_report_file {
+    char* rel_path;
+    uint8_t cached; // parsed by the AST cache, tokenize and parse did not run
+    uint64_t bytes;
+    uint64_t lines;
+    uint64_t tokens;
+    uint64_t nodes;
+    uint64_t phase_ns[TIME_PHASE_PARSE + 1]; // wall time of the per file phases
+};
+
+struct time_report {
+    uint8_t enabled;
+    uint8_t perf; // perf_counters_open succeeded, phases collect hardware counters
+    struct time_phase phases[TIME_PHASE_COUNT];
+    struct arraylist* files; // time_report_file*
+};
+
+extern struct time_report time_report;
+
+struct time_mark {
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+    uint64_t perf[PERF_COUNTER_COUNT];
+};
+
+void time_report_reset(uint8_t enabled);
+
+void time_mark_now(struct time_mark* mark);
+
+// opens hardware counters for the phases of the enabled report. returns nonzero with errno set if none are available,
+// the report then goes on without them.
+int time_report_perf();
+
+// adds the time since mark to phase and moves mark to now. returns the wall time added, 0 while disabled.
+// also records the phase as a trace span while tracing, and its allocations in SMEM_TRACK builds.
+uint64_t time_phase_end(uint8_t phase, struct time_mark* mark);
+
+// NULL while disabled
+struct time_report_file* time_report_add_file(char* rel_path);
+
+struct prog_state;
+
+// state may be NULL if analysis never ran
+void print_time_report(int fd, uint8_t json, struct prog_state* state);
+
+#endif
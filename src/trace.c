@@ -0,0 +1,143 @@
+#include "trace.h"
+#include "arraylist.h"
+#include "streams.h"
+#include "smem.h"
+#include <pthread.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+struct trace_buffer {
+    struct trace_event* events;
+    size_t cap;
+    uint64_t recorded; // events[recorded % cap] is the next slot once cap reached TRACE_BUFFER_MAX
+    uint64_t tid;
+    uint64_t generation;
+};
+
+uint8_t trace_enabled = 0;
+
+// every buffer of the current trace, threads of finished pools leave theirs here
+struct arraylist* trace_buffers = NULL;
+pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+uint64_t trace_generation = 0;
+uint64_t trace_main_tid = 0;
+uint64_t trace_start_ns = 0;
+
+__thread struct trace_buffer* trace_local = NULL;
+
+uint64_t trace_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct trace_buffer* _trace_buffer() {
+    if (trace_local != NULL && trace_local->generation == trace_generation) return trace_local;
+    struct trace_buffer* buffer = scalloc(sizeof(struct trace_buffer));
+    buffer->cap = 256;
+    buffer->events = smalloc(buffer->cap * sizeof(struct trace_event));
+    buffer->tid = syscall(SYS_gettid);
+    pthread_mutex_lock(&trace_lock);
+    buffer->generation = trace_generation;
+    arraylist_addptr(trace_buffers, buffer);
+    pthread_mutex_unlock(&trace_lock);
+    trace_local = buffer;
+    return buffer;
+}
+
+void trace_span(const char* cat, const char* name, const char* detail, uint64_t start_ns) {
+    uint64_t now = trace_now_ns();
+    struct trace_buffer* buffer = _trace_buffer();
+    if (buffer->recorded == buffer->cap && buffer->cap < TRACE_BUFFER_MAX) {
+        buffer->cap *= 2;
+        buffer->events = srealloc(buffer->events, buffer->cap * sizeof(struct trace_event));
+    }
+    struct trace_event* event = &buffer->events[buffer->recorded % buffer->cap];
+    event->cat = cat;
+    event->name = name;
+    event->detail = detail;
+    event->start_ns = start_ns;
+    event->dur_ns = now - start_ns;
+    buffer->recorded++;
+}
+
+void trace_reset(uint8_t enabled) {
+    pthread_mutex_lock(&trace_lock);
+    if (trace_buffers != NULL) {
+        for (size_t i = 0; i < trace_buffers->entry_count; i++) {
+            struct trace_buffer* buffer = arraylist_getptr(trace_buffers, i);
+            free(buffer->events);
+            free(buffer);
+        }
+        arraylist_free(trace_buffers);
+    }
+    trace_buffers = arraylist_new(8, sizeof(struct trace_buffer*));
+    trace_generation++;
+    trace_local = NULL;
+    trace_main_tid = syscall(SYS_gettid);
+    trace_start_ns = trace_now_ns();
+    trace_enabled = enabled;
+    pthread_mutex_unlock(&trace_lock);
+}
+
+// microseconds with the nanoseconds as a fraction
+void _trace_us(struct out_stream* out, uint64_t ns) {
+    outU64(out, ns / 1000);
+    char frac[5] = {'.', '0' + (ns / 100) % 10, '0' + (ns / 10) % 10, '0' + ns % 10, 0};
+    outPuts(out, frac);
+}
+
+void _trace_event_head(struct out_stream* out, uint8_t* first, char* ph, uint64_t tid) {
+    outPuts(out, *first ? "\n{\"ph\":\"" : ",\n{\"ph\":\"");
+    *first = 0;
+    outPuts(out, ph);
+    outPuts(out, "\",\"pid\":");
+    outU64(out, getpid());
+    outPuts(out, ",\"tid\":");
+    outU64(out, tid);
+}
+
+int trace_write(char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 1;
+    struct out_stream* out = newOutStream(fd, OUT_STREAM_DEFAULT_CAP);
+    uint64_t dropped = 0;
+    uint8_t first = 1;
+    outPuts(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    pthread_mutex_lock(&trace_lock);
+    for (size_t i = 0; i < trace_buffers->entry_count; i++) {
+        struct trace_buffer* buffer = arraylist_getptr(trace_buffers, i);
+        _trace_event_head(out, &first, "M", buffer->tid);
+        outPuts(out, buffer->tid == trace_main_tid ? ",\"name\":\"thread_name\",\"args\":{\"name\":\"main\"}}" : ",\"name\":\"thread_name\",\"args\":{\"name\":\"worker\"}}");
+        uint64_t count = buffer->recorded < buffer->cap ? buffer->recorded : buffer->cap;
+        dropped += buffer->recorded - count;
+        for (uint64_t j = buffer->recorded - count; j < buffer->recorded; j++) {
+            struct trace_event* event = &buffer->events[j % buffer->cap];
+            _trace_event_head(out, &first, "X", buffer->tid);
+            outPuts(out, ",\"cat\":");
+            outJsonString(out, event->cat);
+            outPuts(out, ",\"name\":");
+            outJsonString(out, event->name);
+            outPuts(out, ",\"ts\":");
+            _trace_us(out, event->start_ns - trace_start_ns);
+            outPuts(out, ",\"dur\":");
+            _trace_us(out, event->dur_ns);
+            if (event->detail != NULL) {
+                outPuts(out, ",\"args\":{\"detail\":");
+                outJsonString(out, event->detail);
+                outPutc(out, '}');
+            }
+            outPutc(out, '}');
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    outPuts(out, "\n],\"otherData\":{\"dropped_events\":");
+    outU64(out, dropped);
+    outPuts(out, "}}\n");
+    int status = freeOutStream(out);
+    if (close(fd) != 0) status = 1;
+    return status;
+}
@@ -0,0 +1,40 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+// spans recorded per thread into a ring buffer and written as chrome trace events, which chrome://tracing and
+// perfetto open. building with -DFLEXC_NO_TRACE compiles every TRACE_ macro to nothing.
+
+#define TRACE_BUFFER_MAX 65536 // events kept per thread, the oldest are overwritten past this
+
+// names and details are not copied, they have to live until trace_write
+struct trace_event {
+    const char* cat;
+    const char* name;
+    const char* detail; // NULL or shown as args.detail
+    uint64_t start_ns;
+    uint64_t dur_ns;
+};
+
+extern uint8_t trace_enabled;
+
+uint64_t trace_now_ns();
+
+void trace_span(const char* cat, const char* name, const char* detail, uint64_t start_ns);
+
+#ifdef FLEXC_NO_TRACE
+#define TRACE_BEGIN(var)
+#define TRACE_END(var, cat, name, detail)
+#else
+#define TRACE_BEGIN(var) uint64_t var = trace_enabled ? trace_now_ns() : 0
+#define TRACE_END(var, cat, name, detail) if (trace_enabled) trace_span(cat, name, detail, var)
+#endif
+
+// drops everything recorded so far. the calling thread is named main in the trace.
+void trace_reset(uint8_t enabled);
+
+// returns nonzero on IO errors, with errno set
+int trace_write(char* path);
+
+#endif
@@ -204,7 +204,7 @@ char* str_dup(char* str, ssize_t expand) {
 	if (str == NULL) return NULL;
 	ssize_t s = strlen(str);
 	if (-expand > s) return NULL;
-	char* ns = smalloc(s + expand + 1);
+	char* ns = smallocTag(s + expand + 1, SMEM_TAG_STRING);
 	if (expand < 0) s += expand;
 	memcpy(ns, str, s);
 	ns[s] = 0;
@@ -0,0 +1,91 @@
+#!/bin/sh
+# regression checks against a built flexc, each prints its name and fails the run on the first wrong result.
+# usage: check.sh <flexc> <scratch dir>
+
+FLEXC=$1
+OUT=$2
+
+if [ -z "$FLEXC" ] || [ -z "$OUT" ]; then
+    echo "usage: check.sh <flexc> <scratch dir>" >&2
+    exit 1
+fi
+rm -rf "$OUT"
+mkdir -p "$OUT" || exit 1
+FAILED=0
+
+fail() {
+    echo "FAIL: $1" >&2
+    FAILED=1
+}
+
+# malformed files are lexed and parsed in the daemon process itself, so they must come back as errors and leave the
+# daemon serving later requests
+check_daemon_malformed() {
+    echo "daemon: malformed input"
+    sock="$OUT/daemon.sock"
+    printf 'pub module a { func uint32 f(<> x) { x } }\n' > "$OUT/bad_vardecl.flex"
+    printf 'pub module a { func uint32 f(protofunc (<>) x) { x[)] } }\n' > "$OUT/bad_type.flex"
+    printf 'pub module a {\n    func uint32 f() {\n        ret' > "$OUT/bad_eof.flex"
+    printf 'pub module a { pub func uint32 f(uint32 x) { x } }\n' > "$OUT/good.flex"
+    "$FLEXC" --daemon "$sock" > "$OUT/daemon.log" 2>&1 &
+    daemon=$!
+    tries=0
+    while [ ! -S "$sock" ] && [ $tries -lt 50 ]; do
+        sleep 0.1
+        tries=$((tries + 1))
+    done
+    for bad in bad_vardecl bad_type bad_eof; do
+        "$FLEXC" --connect "$sock" --check-all -oir "$OUT/out.ir" "$OUT/$bad.flex" > "$OUT/$bad.log" 2>&1
+        if grep -q "Lost connection" "$OUT/$bad.log" || ! kill -0 $daemon 2> /dev/null; then
+            fail "daemon died on $bad.flex"
+            return
+        fi
+        if ! grep -q "errors found in file" "$OUT/$bad.log"; then
+            fail "daemon did not report errors in $bad.flex, see $OUT/$bad.log"
+        fi
+    done
+    if ! "$FLEXC" --connect "$sock" --check-all -oir "$OUT/out.ir" "$OUT/good.flex" > "$OUT/good.log" 2>&1; then
+        fail "daemon rejected good.flex after malformed input, see $OUT/good.log"
+    fi
+    kill $daemon
+    wait $daemon 2> /dev/null
+}
+
+# two uses of Box<Foo> share one instantiation, the first builds it and the second finds it
+check_generic_cache() {
+    echo "generics: instantiation cache"
+    cat > "$OUT/generic.flex" << EOF
+pub module g {
+    pub class Box<A> {
+        A val;
+        pub func A get(uint32 x) {
+            ret val;
+        }
+    }
+    pub class Foo {
+        uint32 x = 0;
+    }
+    Box<Foo> b;
+    Box<Foo> c;
+    pub func uint32 main(uint32 arg) {
+        Foo f = b.get(arg);
+        Foo f2 = c.get(arg);
+        arg
+    }
+}
+EOF
+    if ! "$FLEXC" --check-all --stats -j 1 -oir "$OUT/generic.ir" "$OUT/generic.flex" > "$OUT/generic.log" 2>&1; then
+        fail "generic.flex did not compile, see $OUT/generic.log"
+        return
+    fi
+    misses=$(grep "generic instantiation misses" "$OUT/generic.log" | awk '{ print $NF }')
+    hits=$(grep "generic instantiation hits" "$OUT/generic.log" | awk '{ print $NF }')
+    if [ "$misses" != 1 ] || [ -z "$hits" ] || [ "$hits" -lt 1 ]; then
+        fail "expected 1 generic instantiation miss and at least 1 hit, got $misses and $hits"
+    fi
+}
+
+check_daemon_malformed
+check_generic_cache
+
+exit $FAILED